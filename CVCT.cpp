@@ -20,6 +20,9 @@
 #include "VulkanCore.h"
 #include "VKTools.h"
 #include "AssetManager.h"
+#include "CompiledScene.h"
+#include "BlockCompression.h"
+#include "FileWatcher.h"
 #include "Camera.h"
 #include "VCTPipelineDefines.h"
 #include "PipelineStates.h"
@@ -43,7 +46,14 @@
 #define ASSETPATH "Assets/"
 // Texture defines
 #define MAXTEXTURES 256
+#define MAX_MIPS 16						// Mip limit of a texture
+#define TEXTURESLOT_EMPTY 0xFFFFFFFF	// Texture reference without a texture
 #define MAXMESHES 512
+#define UPLOADRING_SIZE (64ull << 20)		// Staging memory of the upload ring, grows for larger uploads
+// Texture streaming defines
+#define TEXTURESTREAM_RESIDENT_SIZE 64			// Mips up to this size are resident from the start
+#define TEXTURESTREAM_BUDGET 512				// Default texture memory budget in MB
+#define TEXTURESTREAM_BATCH_SIZE (16ull << 20)	// Pixel data uploaded per streaming batch
 // Cascade voxel grid defines
 #define GRIDSIZE 128			// number of voxels per cascade
 #define GRIDMIPMAP 3			// Number of mipmap per cascade
@@ -62,15 +72,18 @@ class CVCT;
 // Members
 CVCT* m_cvct;
 AssetManager					m_assetManager;				// Asset manager
+FileWatcher						m_assetWatcher;				// Reports changed asset files for hot reloading
 scene_s*						m_scene = NULL;				// Scene
 vk_mesh_s						m_meshes[MAXMESHES];		// Vulkan mesh list
 vk_texture_s					m_textures[MAXTEXTURES];	// Vulkan texture list
+uint32_t						m_textureSlots[MAXTEXTURES];	// Texture of every texture reference, references to identical images share one
 uint32_t						m_meshCount = 0;			// Mesh Counter
 uint32_t						m_textureCount = 0;			// Texture Counter
 AnisotropicVoxelTexture			m_avt;						// Grid instance containing the voxels in 3D texture
 uint32_t						m_renderFlags = 0;			// Render flags
 CVCTSettings					m_cvctSettings = {};		// Cascade settings
 RenderStatesTimeStamps			m_timeStamps = {};			// state timestamps
+char							m_scenePath[512] = {};		// Compiled scene, imported from SPONZAPATH
 
 // todo clean later
 bool hideGUi = false;
@@ -101,9 +114,17 @@ asset_s* GetAssetStaticManager(char* path)
 		printf("asset not loaded");
 	return asset;
 }
+// Converts the text scene again, the importer writes the compiled scene the application loads
+void ImportSceneStaticManager(const char* path, uint32_t pathLength)
+{
+	m_assetManager.InvalidateCacheEntry(path, pathLength);	// a cached conversion does not write the compiled scene
+	if (m_assetManager.ReloadAsset(path, pathLength) == -1)
+		m_assetManager.LoadAsset(path, pathLength);
+}
 
 // predefine
 extern void resize(GLFWwindow* window, int w, int h);
+extern void AssetChanged(const char* path, uint32_t pathLength, void* userData);
 
 class CVCT : public VulkanCore
 {
@@ -124,6 +145,8 @@ public:
 		m_cvctSettings.deferredScale = DEFERRED_SCALE;
 		m_cvctSettings.conecount = CONECOUNT;
 		m_cvctSettings.deferredRender = DEFERRED_DEFAULT;
+		m_cvctSettings.textureBudget = TEXTURESTREAM_BUDGET;
+		QueryPerformanceCounter(&m_startTime);
 	}
 
 private:
@@ -142,6 +165,30 @@ private:
 	glm::vec2 m_prevMousePosition;
 	uint32_t m_currentBuffer = 0;
 	Camera* m_camera;
+	// Staging buffers of the pending upload, released once it finished
+	// Upload ring, persistently mapped staging memory of the copies recorded into m_uploadCommandBuffer. When it is
+	// full the recorded copies are submitted and it starts over once they are done
+	VkBuffer m_uploadRingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_uploadRingMemory = VK_NULL_HANDLE;
+	uint8_t* m_uploadRingData = NULL;
+	uint64_t m_uploadRingSize = 0;
+	uint64_t m_uploadRingHead = 0;
+	VkFence m_uploadFence = VK_NULL_HANDLE;
+	uint64_t m_uploadBytes = 0;						// Staged since the last UploadData
+	uint32_t m_uploadSubmitCount = 0;
+	LARGE_INTEGER m_uploadStart;
+	// Texture streaming, one batch of textures changing their resident mips is copied on the transfer queue at a time
+	vk_texture_s m_streamTextures[MAXTEXTURES];		// Images replacing the textures at m_streamIndices once the batch is copied
+	uint32_t m_streamIndices[MAXTEXTURES];
+	uint32_t m_streamCount = 0;
+	VkCommandBuffer m_streamCommandBuffer = VK_NULL_HANDLE;
+	VkFence m_streamFence = VK_NULL_HANDLE;
+	VkBuffer m_streamStagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_streamStagingMemory = VK_NULL_HANDLE;
+	uint8_t* m_streamStagingData = NULL;				// Persistently mapped
+	uint64_t m_streamStagingSize = 0;
+	LARGE_INTEGER m_startTime;
+	bool m_firstFrame = true;
 
 public:
 	// Cascade helper funcitons
@@ -299,14 +346,10 @@ public:
 		CreateFrameBuffer();
 		VKTools::FlushCommandBuffer(m_setupCommandBuffer, m_deviceQueues.graphics, m_viewDevice, m_devicePools.graphics, false);
 
-		// Destroy the command buffers
-		DestroyCommandBuffer(ForwardRendererState, (VulkanCore*)this, GetGraphicsCommandPool());	// Forward
-		DestroyCommandBuffer(VoxelDebugState, (VulkanCore*)this, GetGraphicsCommandPool());			// Voxeldebug
-		DestroyCommandBuffer(ForwardMainRenderState, (VulkanCore*)this, GetGraphicsCommandPool());	// Forward main forward renderer
 		// whole state got influened. Destroy and rebuild
 		DestroyRenderStates(ConeTraceState, (VulkanCore*)this, GetComputeCommandPool());			// Cone Tracer
 		DestroyRenderStates(DeferredMainRenderState, (VulkanCore*)this, GetGraphicsCommandPool());	// Deferred main forward renderer
-		//Rebuild the command buffers
+		//Rebuild the command buffers, they are re-recorded in place
 		BuildCommandBuffer(ForwardRendererState, GetGraphicsCommandPool(), (VulkanCore*)this, (uint32_t)m_frameBuffers.size(), m_frameBuffers.data());
 		BuildCommandBuffer(VoxelDebugState, GetGraphicsCommandPool(), (VulkanCore*)this, (uint32_t)m_frameBuffers.size(), m_frameBuffers.data());
 		BuildCommandBuffer(ForwardMainRenderState, GetGraphicsCommandPool(), (VulkanCore*)this, (uint32_t)m_frameBuffers.size(), m_frameBuffers.data());
@@ -530,11 +573,24 @@ public:
 			cascadeChange = m_cvctSettings.cascadeCount;
 			ChangeVoxelGridSizeAndCascade(m_cvctSettings.gridSize, m_cvctSettings.cascadeCount);
 		}
-			
+		// Reload the assets changed on disk
+		m_assetWatcher.Poll(AssetChanged, this);
+		// Swap in the streamed textures, the next batch is copied next to this frame
+		StreamTextures();
+
 
 		//UpdateUniformBuffers();
 		Draw();
 		vkDeviceWaitIdle(m_viewDevice);
+
+		if (m_firstFrame)
+		{
+			LARGE_INTEGER end, frequency;
+			QueryPerformanceCounter(&end);
+			QueryPerformanceFrequency(&frequency);
+			printf("Time to first frame %.02f ms\n", 1000.0 * (end.QuadPart - m_startTime.QuadPart) / frequency.QuadPart);
+			m_firstFrame = false;
+		}
 	}
 
 	void RenderLoop()
@@ -841,7 +897,7 @@ public:
 	inline void SetScene(scene_s* scene){m_scene = scene;}
 	inline void SetScene(asset_s* asset)
 	{
-		scene_s* scene = (scene_s*)asset->data;
+		scene_s* scene = (scene_s*)asset->data.Get();
 		SetScene(scene);
 	}
 
@@ -853,35 +909,28 @@ public:
 		///////////////////////////////////////////////////////
 		/////Create Vulkan specific buffers
 		/////////////////////////////////////////////////////// 
-		// Create the device specific and staging buffer
+		// Create the device specific buffer, it is staged through the upload ring
 		VkBufferCreateInfo bufferInfo = {};
-		VkBuffer sceneBuffer, sceneStageBuffer;
-		VkMemoryRequirements bufferMemoryRequirements, stagingMemoryRequirements;
+		VkBuffer sceneBuffer;
+		VkMemoryRequirements bufferMemoryRequirements;
 
-		// Create the stagingd
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.pNext = NULL;
 		bufferInfo.size = totalBufferSize;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 		bufferInfo.flags = 0;
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		result = vkCreateBuffer(m_viewDevice, &bufferInfo, NULL, &sceneStageBuffer);
-
-		// Create the device buffer
 		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 		result = vkCreateBuffer(m_viewDevice, &bufferInfo, NULL, &sceneBuffer);
 
 		// Set memory requirements
 		vkGetBufferMemoryRequirements(m_viewDevice, sceneBuffer, &bufferMemoryRequirements);
-		vkGetBufferMemoryRequirements(m_viewDevice, sceneStageBuffer, &stagingMemoryRequirements);
 		uint32_t bufferTypeIndex = GetMemoryType(bufferMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		uint32_t stagingTypeIndex = GetMemoryType(stagingMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-		if (!bufferTypeIndex || !stagingTypeIndex)
+		if (!bufferTypeIndex)
 			RETURN_ERROR(-1, "No compatible memory type");
 
 		// Creating the memory
-		VkDeviceMemory bufferDeviceMemory, stagingDeviceMemory;
+		VkDeviceMemory bufferDeviceMemory;
 		VkMemoryAllocateInfo allocInfo;
 
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -892,32 +941,16 @@ public:
 		if (result != VkResult::VK_SUCCESS)
 			RETURN_ERROR(-1, "not able to allocate buffer device memory");
 
-		allocInfo.allocationSize = stagingMemoryRequirements.size;
-		allocInfo.memoryTypeIndex = stagingTypeIndex;
-		result = vkAllocateMemory(m_viewDevice,&allocInfo,NULL,&stagingDeviceMemory);
-		if (result != VkResult::VK_SUCCESS)
-			RETURN_ERROR(-1, "not able to allocate staging device memory");
-
 		// Bind all the memory
 		result = vkBindBufferMemory(m_viewDevice, sceneBuffer, bufferDeviceMemory,0);
 		if (result != VkResult::VK_SUCCESS)
 			RETURN_ERROR(-1, "Not able to bind buffer with device memory");
 
-		result = vkBindBufferMemory(m_viewDevice, sceneStageBuffer, stagingDeviceMemory, 0);
-		if (result != VkResult::VK_SUCCESS)
-			RETURN_ERROR(-1, "Not able to bind staging with device memory");
-
-		// Map memory dest to pointer
-		uint8_t* dst = NULL;
-		result = vkMapMemory(m_viewDevice, stagingDeviceMemory, 0, totalBufferSize, 0, (void**)&dst);
-
-		if (result != VK_SUCCESS)
-			RETURN_ERROR(-1, "unable to map destination pointer");
-
-		//copy the vertex and indices data to the destination
+		//copy the vertex and indices data to the staging memory
+		VkDeviceSize stagingOffset;
+		uint8_t* dst = AllocateUpload(totalBufferSize, &stagingOffset);
 		memcpy(dst, m_scene->vertexData, m_scene->vertexDataSizeInBytes);
 		memcpy(dst + m_scene->vertexDataSizeInBytes, m_scene->indexData, m_scene->indexDataSizeInBytes);
-		vkUnmapMemory(m_viewDevice, stagingDeviceMemory);
 
 		///////////////////////////////////////////////////////
 		/////create the vulkan meshes
@@ -967,7 +1000,7 @@ public:
 				for (uint32_t j = 0; j < mesh->vertexBufferCount; j++)
 				{
 					vertex_buffer_s* vb = &m_scene->vertexBuffers[mesh->vertexBufferStartIndex + j];
-					uint32_t idx = 0xFFFFFFF;
+					uint32_t idx = 0xFFFFFFFF;
 					const char* attrib = m_scene->stringData + vb->attribStringOffset;
 
 					if (strcmp(attrib, "position") == 0)
@@ -976,11 +1009,22 @@ public:
 						idx = ATTRIBUTE_TEXCOORD;
 					else if (strcmp(attrib, "tangent") == 0)
 						idx = ATTRIBUTE_TANGENT;
-					else if (strcmp(attrib, "bitangent") == 0)
-						idx = ATTRIBUTE_BITANGENT;
 					else if (strcmp(attrib, "normal") == 0)
 						idx = ATTRIBUTE_NORMAL;
 
+					// the importer packs every mesh of a scene, see the vertex input state below
+					uint32_t packed = 0;
+					if (idx == ATTRIBUTE_POSITION)
+						packed = (m_scene->vertexFlags & SCENE_VERTEX_QUANTIZED_POSITIONS) ?
+							vb->elementType == VERTEX_BUFFER_ELEMENT_TYPE_UNORM16 && vb->elementCount == 4 :
+							vb->elementType == VERTEX_BUFFER_ELEMENT_TYPE_FLOAT && vb->elementCount == 3;
+					else if (idx == ATTRIBUTE_TEXCOORD)
+						packed = vb->elementType == VERTEX_BUFFER_ELEMENT_TYPE_HALF && vb->elementCount == 2;
+					else if (idx != 0xFFFFFFFF)
+						packed = vb->elementType == VERTEX_BUFFER_ELEMENT_TYPE_SNORM16 && vb->elementCount == 2;
+
+					if (idx != 0xFFFFFFFF && !packed)
+						RETURN_ERROR(-1, "Vertex buffer format does not match the pipeline");
 					if (idx != 0xFFFFFFFF)
 					{
 						meshData.vertexResources[idx] = sceneBuffer;
@@ -1013,63 +1057,59 @@ public:
 		/////stage buffer to the GPU
 		/////////////////////////////////////////////////////// 
 		// Vertex buffer+Indices buffer
-		VkBufferCopy bufferCopy = {0,0, totalBufferSize };
-		vkCmdCopyBuffer(m_uploadCommandBuffer,sceneStageBuffer,sceneBuffer,1,&bufferCopy);
+		VkBufferCopy bufferCopy = { stagingOffset, 0, totalBufferSize };
+		vkCmdCopyBuffer(m_uploadCommandBuffer, m_uploadRingBuffer, sceneBuffer, 1, &bufferCopy);
 
 		///////////////////////////////////////////////////////
 		/////Set bindings
 		/////////////////////////////////////////////////////// 
 		// Set binding description
+		// The importer packs the attributes, the shaders decode the normal and tangent and rebuild the bitangent
+		uint32_t quantizedPositions = (m_scene->vertexFlags & SCENE_VERTEX_QUANTIZED_POSITIONS) != 0;
 		m_vertices.bindingDescriptions.resize(ATTRIBUTE_COUNT);
 		// Location 0 : Position
 		m_vertices.bindingDescriptions[0].binding = (uint32_t)ATTRIBUTE_POSITION;
-		m_vertices.bindingDescriptions[0].stride = 3 * sizeof(float);
+		m_vertices.bindingDescriptions[0].stride = quantizedPositions ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
 		m_vertices.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// Location 1 : Position
+		// Location 1 : Texcoord
 		m_vertices.bindingDescriptions[1].binding = (uint32_t)ATTRIBUTE_TEXCOORD;
-		m_vertices.bindingDescriptions[1].stride = 2 * sizeof(float);
+		m_vertices.bindingDescriptions[1].stride = 2 * sizeof(uint16_t);
 		m_vertices.bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// Location 2 : Position
+		// Location 2 : Normal
 		m_vertices.bindingDescriptions[2].binding = (uint32_t)ATTRIBUTE_NORMAL;
-		m_vertices.bindingDescriptions[2].stride = 3 * sizeof(float);
+		m_vertices.bindingDescriptions[2].stride = 2 * sizeof(uint16_t);
 		m_vertices.bindingDescriptions[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// Location 3 : Position
+		// Location 3 : Tangent
 		m_vertices.bindingDescriptions[3].binding = (uint32_t)ATTRIBUTE_TANGENT;
-		m_vertices.bindingDescriptions[3].stride = 3 * sizeof(float);
+		m_vertices.bindingDescriptions[3].stride = 2 * sizeof(uint16_t);
 		m_vertices.bindingDescriptions[3].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		// Location 4 : Position
-		m_vertices.bindingDescriptions[4].binding = (uint32_t)ATTRIBUTE_BITANGENT;
-		m_vertices.bindingDescriptions[4].stride = 3 * sizeof(float);
-		m_vertices.bindingDescriptions[4].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		// Attribute descriptions
 		// Describes memory layout and shader attribute locations
 		m_vertices.attributeDescriptions.resize(ATTRIBUTE_COUNT);
-		// Location 0 : Position
+		// Location 0 : Position, floats or unorm16 quantized to the scene bounds
 		m_vertices.attributeDescriptions[0].binding = (uint32_t)ATTRIBUTE_POSITION;
 		m_vertices.attributeDescriptions[0].location = ATTRIBUTE_POSITION;
-		m_vertices.attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		m_vertices.attributeDescriptions[0].format = quantizedPositions ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
 		m_vertices.attributeDescriptions[0].offset = 0;
-		// Location 1 : Texcoord
+		// Location 1 : Texcoord, halfs
 		m_vertices.attributeDescriptions[1].binding = (uint32_t)ATTRIBUTE_TEXCOORD;
 		m_vertices.attributeDescriptions[1].location = ATTRIBUTE_TEXCOORD;
-		m_vertices.attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+		m_vertices.attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
 		m_vertices.attributeDescriptions[1].offset = 0;
-		//location 2 : Normal
+		//location 2 : Normal, octahedral
 		m_vertices.attributeDescriptions[2].binding = (uint32_t)ATTRIBUTE_NORMAL;
 		m_vertices.attributeDescriptions[2].location = ATTRIBUTE_NORMAL;
-		m_vertices.attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+		m_vertices.attributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;
 		m_vertices.attributeDescriptions[2].offset = 0;
-		//location 3 : Tangent
+		//location 3 : Tangent, octahedral with the handedness in the sign of y
 		m_vertices.attributeDescriptions[3].binding = (uint32_t)ATTRIBUTE_TANGENT;
 		m_vertices.attributeDescriptions[3].location = ATTRIBUTE_TANGENT;
-		m_vertices.attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
+		m_vertices.attributeDescriptions[3].format = VK_FORMAT_R16G16_SNORM;
 		m_vertices.attributeDescriptions[3].offset = 0;
-		//location 4 : Bitangent
-		m_vertices.attributeDescriptions[4].binding = (uint32_t)ATTRIBUTE_BITANGENT;
-		m_vertices.attributeDescriptions[4].location = ATTRIBUTE_BITANGENT;
-		m_vertices.attributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-		m_vertices.attributeDescriptions[4].offset = 0;
+
+		// Positions are decoded with the static uniform buffer
+		SetScenePositionDecode();
 
 		// Assign to vertex input state
 		m_vertices.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -1086,154 +1126,235 @@ public:
 		m_indices.buf = sceneBuffer;
 		m_indices.mem = bufferDeviceMemory;
 
-		// Destroy staging buffers
-		//TODO: Delete the staging buffer
-		//vkDestroyBuffer(m_viewDevice, sceneStageBuffer, nullptr);
-		//vkFreeMemory(m_viewDevice, stagingDeviceMemory, nullptr);
-
 		return 0;	//everything is uploaded
 	}
 
-	uint32_t CreateTexture(uint32_t index, const char* path)
+	// Creates the image of a texture holding the mips of the image asset from baseMip on, its memory and a view per mip.
+	// Streamed images are read by the transfer queue as well
+	// Releases what CreateTextureImage created, when it fails part way
+	void ReleaseTextureImage(vk_texture_s* vktexture)
 	{
-		if (index >= MAXTEXTURES)
-			RETURN_ERROR(-1, "Number of textures exceed limit");
-		
-		VkResult result;
-		asset_s* image;
-		image = GetAssetStaticManager((char*)path);
-
-		image_desc_s* imageDesc = (image_desc_s*)image->data;
-		if (!imageDesc)
-			RETURN_ERROR(-1, "Image could not find between the descriptors");
-
-		uint8_t* pixelData = (uint8_t*)(imageDesc->mips + imageDesc->mipCount);
-
-		uint64_t pixelSize = 0;
-		for (uint32_t i = 0; i < imageDesc->mipCount; i++)
-			pixelSize += imageDesc->mips[i].width * imageDesc->mips[i].height * sizeof(uint32_t);	//size of one pixel is 4 bytes
+		for (uint32_t i = 0; i < vktexture->mipCount; i++)
+			vkDestroyImageView(m_viewDevice, vktexture->view[i], NULL);
+		vkDestroyImage(m_viewDevice, vktexture->image, NULL);
+		vkFreeMemory(m_viewDevice, vktexture->deviceMemory, NULL);
+		free(vktexture->view);
+		free(vktexture->descriptor);
+		vktexture->mipCount = 0;
+		vktexture->image = VK_NULL_HANDLE;
+		vktexture->deviceMemory = VK_NULL_HANDLE;
+		vktexture->view = NULL;
+		vktexture->descriptor = NULL;
+	}
 
-		//////////////////////////////////////////////////
-		//// Set the VK Texture
-		///////////////////////////////////////////////// 
-		vk_texture_s* vktexture = &m_textures[index];
-		vktexture->width = imageDesc->width;
-		vktexture->height = imageDesc->height;
-		vktexture->mipCount = (uint32_t)floor(log2(std::max(imageDesc->width, imageDesc->height))) + 1;
-		vktexture->descriptorSetCount = (uint32_t)ceil((float)(vktexture->mipCount-1)/4);
+	uint32_t CreateTextureImage(vk_texture_s* vktexture, const image_desc_s* imageDesc, uint32_t baseMip, VkFormat format, VkImageUsageFlags usage, uint32_t streamed)
+	{
+		VkResult result;
+		vktexture->width = imageDesc->mips[baseMip].width;
+		vktexture->height = imageDesc->mips[baseMip].height;
+		vktexture->mipCount = (uint32_t)floor(log2(std::max(vktexture->width, vktexture->height))) + 1;
+		vktexture->format = format;
+		vktexture->baseMip = baseMip;
+		vktexture->streamed = streamed;
 		vktexture->sampler = m_sampler;
 		// TODO: THIS MIGHT ERROR
 		vktexture->imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		vktexture->view = (VkImageView*)malloc(sizeof(VkImageView) * vktexture->mipCount);
+		vktexture->view = (VkImageView*)calloc(vktexture->mipCount, sizeof(VkImageView));	//null views are skipped by a release on failure
 		vktexture->descriptor = (VkDescriptorImageInfo*)malloc(sizeof(VkDescriptorImageInfo) * vktexture->mipCount);
-
-		//////////////////////////////////////////////////
-		////Create buffer resources
-		/////////////////////////////////////////////////
-		VkBuffer stagingBuffer;
-
-		VkBufferCreateInfo bufferInfo = {};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.pNext = NULL;
-		bufferInfo.flags = 0;
-		bufferInfo.size = pixelSize;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		// create the staging buffer
-		result = vkCreateBuffer(m_viewDevice, &bufferInfo, NULL, &stagingBuffer);
+		vktexture->image = VK_NULL_HANDLE;
+		vktexture->deviceMemory = VK_NULL_HANDLE;
 
 		VkImageCreateInfo imageInfo = {};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.pNext = NULL;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-		//imageInfo.mipLevels = imageDesc->mipCount;
+		imageInfo.format = format;
 		imageInfo.mipLevels = vktexture->mipCount;
 		imageInfo.flags = 0;
 		imageInfo.arrayLayers = 1;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		VkExtent3D extent;
-		extent.width = imageDesc->width;
-		extent.height = imageDesc->height;
-		extent.depth = 1;
-		imageInfo.extent = extent;
+		imageInfo.usage = usage;
+		imageInfo.extent = { vktexture->width, vktexture->height, 1 };
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+		// The transfer queue copies the resident mips to the image replacing it
+		uint32_t queueFamilies[2] = { m_deviceQueueIndices.graphics, m_deviceQueueIndices.transfer };
+		if (streamed && queueFamilies[0] != queueFamilies[1])
+		{
+			imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			imageInfo.queueFamilyIndexCount = 2;
+			imageInfo.pQueueFamilyIndices = queueFamilies;
+		}
 		//create the image
 		result = vkCreateImage(m_viewDevice, &imageInfo, NULL, &vktexture->image);
 		if (result != VkResult::VK_SUCCESS)
+		{
+			ReleaseTextureImage(vktexture);
 			RETURN_ERROR(-1, "vkCreateImage failed (0x%08X)", (uint32_t)result);
+		}
 
-		VkMemoryRequirements imageMemoryRequirements, stagingMemoryRequirements;
+		VkMemoryRequirements imageMemoryRequirements;
 		vkGetImageMemoryRequirements(m_viewDevice, vktexture->image, &imageMemoryRequirements);
-		vkGetBufferMemoryRequirements(m_viewDevice, stagingBuffer, &stagingMemoryRequirements);
-		uint32_t imageTypeIndex = GetMemoryType(imageMemoryRequirements.memoryTypeBits,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		uint32_t stagingTypeIndex = GetMemoryType(stagingMemoryRequirements.memoryTypeBits,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-		if(!imageTypeIndex || !stagingTypeIndex)
+		uint32_t imageTypeIndex = GetMemoryType(imageMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (!imageTypeIndex)
+		{
+			ReleaseTextureImage(vktexture);
 			RETURN_ERROR(-1, "No compatible memory type found for image");
+		}
 
-		//////////////////////////////////////////////////
-		//// Allocate memory
-		/////////////////////////////////////////////////
-		VkDeviceMemory imageDeviceMemory, stagingDeviceMemory;
 		VkMemoryAllocateInfo allocateInfo = {};
-
 		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		allocateInfo.pNext = NULL;
 		allocateInfo.allocationSize = imageMemoryRequirements.size;
 		allocateInfo.memoryTypeIndex = imageTypeIndex;
-		result = vkAllocateMemory(m_viewDevice, &allocateInfo,NULL,&imageDeviceMemory);
+		result = vkAllocateMemory(m_viewDevice, &allocateInfo, NULL, &vktexture->deviceMemory);
 		if (result != VK_SUCCESS)
+		{
+			ReleaseTextureImage(vktexture);
 			RETURN_ERROR(-1, "vkAllocateMemory failed (0x%08X)", (uint32_t)result);
+		}
+		result = vkBindImageMemory(m_viewDevice, vktexture->image, vktexture->deviceMemory, 0);
+		if (result != VK_SUCCESS)
+		{
+			ReleaseTextureImage(vktexture);
+			RETURN_ERROR(-1, "vkBindMemory failed(0x%08X)", (uint32_t)result);
+		}
 
-		allocateInfo.allocationSize = stagingMemoryRequirements.size;
-		allocateInfo.memoryTypeIndex = stagingTypeIndex;
-		result = vkAllocateMemory(m_viewDevice, &allocateInfo, NULL, &stagingDeviceMemory);
-		if(result != VK_SUCCESS)
-			RETURN_ERROR(-1, "vkAllocateMemory failed (0x%08X)", (uint32_t)result);
+		// Pixel data of the mips the image holds, counted against the texture budget
+		vktexture->residentBytes = 0;
+		for (uint32_t i = baseMip; i < imageDesc->mipCount; i++)
+			vktexture->residentBytes += GetImageLevelSize(imageDesc->format, imageDesc->mips[i].width, imageDesc->mips[i].height);
 
 		//////////////////////////////////////////////////
-		//// Bind memory
+		//// Create Image View
 		/////////////////////////////////////////////////
-		result = vkBindImageMemory(m_viewDevice, vktexture->image, imageDeviceMemory, 0);
-		if (result != VK_SUCCESS)	RETURN_ERROR(-1, "vkBindMemory failed(0x%08X)", (uint32_t)result);
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.pNext = NULL;
+		viewCreateInfo.flags = 0;
+		viewCreateInfo.image = vktexture->image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+		viewCreateInfo.subresourceRange.layerCount = 1;
+		// create the imageview
+		for (uint32_t i = 0; i < vktexture->mipCount; i++)
+		{
+			viewCreateInfo.subresourceRange.baseMipLevel = i;
+			viewCreateInfo.subresourceRange.levelCount = vktexture->mipCount - i;
+			result = vkCreateImageView(m_viewDevice, &viewCreateInfo, NULL, &vktexture->view[i]);
+			if (result != VK_SUCCESS)
+			{
+				ReleaseTextureImage(vktexture);
+				RETURN_ERROR(-1, "vkcreateImageView Failed (0x%08X)", (uint32_t)result);
+			}
+
+			//////////////////////////////////////////////////
+			//// Update the descriptorset. bind image
+			/////////////////////////////////////////////////
+			vktexture->descriptor[i].sampler = vktexture->sampler;
+			vktexture->descriptor[i].imageView = vktexture->view[i];
+			vktexture->descriptor[i].imageLayout = vktexture->imageLayout;
+		}
 
-		result = vkBindBufferMemory(m_viewDevice, stagingBuffer, stagingDeviceMemory, 0);
-		if(result != VK_SUCCESS)	RETURN_ERROR(-1, "vkBindMemory failed(0x%08X)", (uint32_t)result);
+		return 0;
+	}
+
+	uint32_t CreateTexture(uint32_t index, const char* path)
+	{
+		if (index >= MAXTEXTURES)
+			RETURN_ERROR(-1, "Number of textures exceed limit");
+		
+		VkResult result;
+		asset_s* image;
+		image = GetAssetStaticManager((char*)path);
+
+		image_desc_s* imageDesc = (image_desc_s*)image->data.Get();
+		if (!imageDesc)
+			RETURN_ERROR(-1, "Image could not find between the descriptors");
+
+		uint8_t* pixelData = (uint8_t*)(imageDesc->mips + imageDesc->mipCount);
+
+		if (imageDesc->mipCount >= MAX_MIPS)
+			RETURN_ERROR(-1, "Number of mips is too high");
+
+		// Block compressed images are decoded to rgba8 when the device can't sample them
+		static const VkFormat imageFormats[IMAGE_FORMAT_COUNT] = { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK };
+		if (imageDesc->format >= IMAGE_FORMAT_COUNT)
+			RETURN_ERROR(-1, "Unknown image format %u", imageDesc->format);
+		uint32_t uploadFormat = imageDesc->format;
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(m_physicalGPU, imageFormats[uploadFormat], &formatProperties);
+		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+			uploadFormat = IMAGE_FORMAT_RGBA8;
+
+		// Images with their whole mip chain in the stored format start with the small mips only, the rest is streamed in
+		uint32_t fullMipCount = (uint32_t)floor(log2(std::max(imageDesc->width, imageDesc->height))) + 1;
+		uint32_t streamed = (imageDesc->mipCount == fullMipCount && uploadFormat == imageDesc->format);
+		uint32_t baseMip = streamed ? GetResidentBaseMip(imageDesc) : 0;
+
+		uint64_t pixelSize = 0;
+		uint64_t mipOffsets[MAX_MIPS];
+		for (uint32_t i = baseMip; i < imageDesc->mipCount; i++)
+		{
+			mipOffsets[i] = pixelSize;
+			pixelSize += GetImageLevelSize(uploadFormat, imageDesc->mips[i].width, imageDesc->mips[i].height);
+		}
 
 		//////////////////////////////////////////////////
-		//// Map memory/copy memory
+		//// Set the VK Texture
+		///////////////////////////////////////////////// 
+		vk_texture_s* vktexture = &m_textures[index];
+		// The converter stores the whole mip chain, the GPU mip pass only fills in the mips of images without it
+		if (imageDesc->mipCount == fullMipCount)
+			vktexture->descriptorSetCount = 0;
+		else
+			vktexture->descriptorSetCount = (uint32_t)ceil((float)(fullMipCount-1)/4);
+
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		// Only the GPU mip pass writes to the image, block compressed formats can't be storage images
+		if (vktexture->descriptorSetCount)
+			usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		// Streaming copies the resident mips to the next image of the texture
+		if (streamed)
+			usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		if (CreateTextureImage(vktexture, imageDesc, baseMip, imageFormats[uploadFormat], usage, streamed) != 0)
+			return -1;
+
+		//////////////////////////////////////////////////
+		//// Copy the pixel data to the staging memory
 		/////////////////////////////////////////////////
-		uint8_t* dst = NULL;
-		result = vkMapMemory(m_viewDevice,stagingDeviceMemory,0,pixelSize,0,(void**)&dst);
-		memcpy(dst, pixelData, pixelSize);
-		vkUnmapMemory(m_viewDevice, stagingDeviceMemory);
+		VkDeviceSize stagingOffset;
+		uint8_t* dst = AllocateUpload(pixelSize, &stagingOffset);
+		if (uploadFormat == imageDesc->format)
+			memcpy(dst, pixelData + imageDesc->mips[baseMip].offset, pixelSize);
+		else
+		{
+			for (uint32_t i = 0; i < imageDesc->mipCount; i++)
+				DecompressImageLevel(imageDesc->format, pixelData + imageDesc->mips[i].offset, imageDesc->mips[i].width, imageDesc->mips[i].height, (uint32_t*)(dst + mipOffsets[i]));
+		}
 
 		//////////////////////////////////////////////////
 		//// copy buffer to image
 		/////////////////////////////////////////////////
-#define MAX_MIPS 16
 		VkBufferImageCopy mipCopies[MAX_MIPS];
-		if (imageDesc->mipCount >= MAX_MIPS)
-			RETURN_ERROR(-1, "Number of mips is too high");
-#undef MAX_MIPS
 		// Set the mip maps
-		for (uint32_t i = 0; i < imageDesc->mipCount; i++)
+		for (uint32_t i = baseMip; i < imageDesc->mipCount; i++)
 		{
 			VkImageSubresourceLayers imgSubResource = {};
 			imgSubResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imgSubResource.mipLevel = i;
+			imgSubResource.mipLevel = i - baseMip;
 			imgSubResource.layerCount = 1;
 
 			VkBufferImageCopy imgCopy;
-			imgCopy.bufferOffset = imageDesc->mips[i].offset;
-			imgCopy.bufferRowLength = imageDesc->mips[i].width;
-			imgCopy.bufferImageHeight = imageDesc->mips[i].height;
+			imgCopy.bufferOffset = stagingOffset + mipOffsets[i];
+			imgCopy.bufferRowLength = 0;	// Tightly packed, rows of blocks for compressed formats
+			imgCopy.bufferImageHeight = 0;
 			imgCopy.imageOffset = { 0,0,0 };
 			imgCopy.imageSubresource = imgSubResource;
 			imgCopy.imageExtent = { imageDesc->mips[i].width, imageDesc->mips[i].height, 1 };
-			mipCopies[i] = imgCopy;
+			mipCopies[i - baseMip] = imgCopy;
 		}
 
 		//////////////////////////////////////////////////
@@ -1242,7 +1363,7 @@ public:
 		// Optimal image will be used as destination for the copy
 		VkImageSubresourceRange srRange = {};
 		srRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		srRange.levelCount = imageDesc->mipCount;
+		srRange.levelCount = imageDesc->mipCount - baseMip;
 		srRange.layerCount = 1;
 
 		VKTools::SetImageLayout(
@@ -1252,7 +1373,7 @@ public:
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			srRange);
 
-		vkCmdCopyBufferToImage(m_uploadCommandBuffer, stagingBuffer, vktexture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageDesc->mipCount, mipCopies);
+		vkCmdCopyBufferToImage(m_uploadCommandBuffer, m_uploadRingBuffer, vktexture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageDesc->mipCount - baseMip, mipCopies);
 
 		// Change texture image layout to shader read after all mip levels have been copied
 		VKTools::SetImageLayout(
@@ -1262,37 +1383,6 @@ public:
 			VK_IMAGE_LAYOUT_GENERAL,
 			srRange);
 
-		//////////////////////////////////////////////////
-		//// Create Image View
-		/////////////////////////////////////////////////
-		VkImageView imageView = {};
-		VkImageViewCreateInfo viewCreateInfo = {};
-		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewCreateInfo.pNext = NULL;
-		viewCreateInfo.flags = 0;
-		viewCreateInfo.image = vktexture->image;
-		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-		viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewCreateInfo.subresourceRange.baseArrayLayer = 0;
-		viewCreateInfo.subresourceRange.layerCount = 1;
-		// create the imageview
-		for (uint32_t i = 0; i < vktexture->mipCount; i++)
-		{
-			viewCreateInfo.subresourceRange.baseMipLevel = i;
-			viewCreateInfo.subresourceRange.levelCount = vktexture->mipCount - i;
-			result = vkCreateImageView(m_viewDevice, &viewCreateInfo, NULL, &vktexture->view[i]);
-			if (result != VK_SUCCESS)
-				RETURN_ERROR(-1, "vkcreateImageView Failed (0x%08X)", (uint32_t)result);
-
-			//////////////////////////////////////////////////
-			//// Update the descriptorset. bind image
-			/////////////////////////////////////////////////
-			vktexture->descriptor[i].sampler = vktexture->sampler;
-			vktexture->descriptor[i].imageView = vktexture->view[i];
-			vktexture->descriptor[i].imageLayout = vktexture->imageLayout;
-		}
-
 		// Create the uniform buffers per descriptorsetCount
 		vktexture->ubo = (TextureMipMapperUBOComp*)malloc(sizeof(TextureMipMapperUBOComp) * vktexture->descriptorSetCount);
 		vktexture->uboDescriptor = (UniformData*)malloc(sizeof(UniformData) * vktexture->descriptorSetCount);
@@ -1329,6 +1419,52 @@ public:
 			vkUnmapMemory(m_viewDevice, vktexture->uboDescriptor[i].m_memory);
 		}
 
+		// The converter shares the data of identical images, so the data identifies the texture
+		vktexture->content = imageDesc;
+		vktexture->referenceCount = 0;
+
+		return 0;
+	}
+
+	// Points the texture reference slot to the texture of the image at path, the texture is created when no slot uses it yet.
+	// Returns the texture index, -1 when it could not be created
+	int32_t AcquireTextureSlot(uint32_t slot, const char* path, uint32_t* outCreated)
+	{
+		*outCreated = 0;
+		asset_s* image = GetAssetStaticManager((char*)path);
+		if (!image || !image->data.Get())
+			RETURN_ERROR(-1, "Image %s is not loaded", path);
+
+		uint32_t index = MAXTEXTURES, freeIndex = MAXTEXTURES;
+		for (uint32_t i = 0; i < MAXTEXTURES; i++)
+		{
+			if (m_textures[i].content == image->data.Get())
+			{
+				index = i;
+				break;
+			}
+			if (freeIndex == MAXTEXTURES && m_textures[i].image == VK_NULL_HANDLE)
+				freeIndex = i;
+		}
+		if (index == MAXTEXTURES)
+		{
+			if (CreateTexture(freeIndex, path) != 0)
+				return -1;
+			index = freeIndex;
+			*outCreated = 1;
+		}
+
+		m_textures[index].referenceCount++;
+		m_textureSlots[slot] = index;
+		m_textureCount = std::max(m_textureCount, index + 1);
+		WriteTextureSlot(slot);
+
+		return (int32_t)index;
+	}
+
+	// The states sample the textures through the slots
+	void WriteTextureSlot(uint32_t slot)
+	{
 		VkWriteDescriptorSet wds = {};
 		wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		wds.pNext = NULL;
@@ -1336,14 +1472,284 @@ public:
 		wds.dstBinding = STATIC_DESCRIPTOR_IMAGE;
 		wds.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
 		wds.descriptorCount = 1;
-		wds.dstArrayElement = index;
-		wds.pImageInfo = &vktexture->descriptor[0];
+		wds.dstArrayElement = slot;
+		wds.pImageInfo = &m_textures[m_textureSlots[slot]].descriptor[0];
 		//update the descriptorset
 		vkUpdateDescriptorSets(m_viewDevice, 1, &wds, 0, NULL);
+	}
+
+	// The texture is destroyed with its last slot
+	void ReleaseTextureSlot(uint32_t slot)
+	{
+		uint32_t index = m_textureSlots[slot];
+		if (index == TEXTURESLOT_EMPTY)
+			return;
+		m_textureSlots[slot] = TEXTURESLOT_EMPTY;
+		if (--m_textures[index].referenceCount == 0)
+			DestroyTexture(&m_textures[index]);
+	}
+
+	// The shaders index the whole texture array, slots without a texture point at the first texture
+	void WriteEmptyTextureSlots()
+	{
+		uint32_t fallback = 0;
+		while (fallback < MAXTEXTURES && m_textureSlots[fallback] == TEXTURESLOT_EMPTY)
+			fallback++;
+		if (fallback == MAXTEXTURES)
+			return;
+
+		VkWriteDescriptorSet wds[MAXTEXTURES];
+		uint32_t writeCount = 0;
+		for (uint32_t slot = 0; slot < MAXTEXTURES; slot++)
+		{
+			if (m_textureSlots[slot] != TEXTURESLOT_EMPTY)
+				continue;
+			wds[writeCount] = {};
+			wds[writeCount].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			wds[writeCount].pNext = NULL;
+			wds[writeCount].dstSet = m_staticDescriptorSet;
+			wds[writeCount].dstBinding = STATIC_DESCRIPTOR_IMAGE;
+			wds[writeCount].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			wds[writeCount].descriptorCount = 1;
+			wds[writeCount].dstArrayElement = slot;
+			wds[writeCount].pImageInfo = &m_textures[m_textureSlots[fallback]].descriptor[0];
+			writeCount++;
+		}
+		if (writeCount)
+			vkUpdateDescriptorSets(m_viewDevice, writeCount, wds, 0, NULL);
+	}
+
+	// Mips up to TEXTURESTREAM_RESIDENT_SIZE are resident from the start, and stay resident
+	static uint32_t GetResidentBaseMip(const image_desc_s* imageDesc)
+	{
+		uint32_t baseMip = 0;
+		while (baseMip + 1 < imageDesc->mipCount && std::max(imageDesc->mips[baseMip].width, imageDesc->mips[baseMip].height) > TEXTURESTREAM_RESIDENT_SIZE)
+			baseMip++;
+		return baseMip;
+	}
 
+	// Pixel data of the resident mips of all textures
+	uint64_t GetTextureMemory()
+	{
+		uint64_t bytes = 0;
+		for (uint32_t i = 0; i < MAXTEXTURES; i++)
+			bytes += m_textures[i].residentBytes;
+		return bytes;
+	}
+
+	uint32_t CreateTextureStreaming()
+	{
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VK_CHECK_RESULT(vkCreateFence(m_viewDevice, &fenceInfo, NULL, &m_streamFence));
+		return ReserveStreamStaging(TEXTURESTREAM_BATCH_SIZE);
+	}
+
+	// Grows the staging buffer of the streaming, only while no batch is in flight
+	uint32_t ReserveStreamStaging(uint64_t size)
+	{
+		if (size <= m_streamStagingSize)
+			return 0;
+		if (m_streamStagingBuffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(m_viewDevice, m_streamStagingMemory);
+			vkDestroyBuffer(m_viewDevice, m_streamStagingBuffer, NULL);
+			vkFreeMemory(m_viewDevice, m_streamStagingMemory, NULL);
+		}
+		VKTools::CreateBuffer((VulkanCore*)this, m_viewDevice,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			size,
+			NULL,
+			&m_streamStagingBuffer,
+			&m_streamStagingMemory);
+		VK_CHECK_RESULT(vkMapMemory(m_viewDevice, m_streamStagingMemory, 0, size, 0, (void**)&m_streamStagingData));
+		m_streamStagingSize = size;
 		return 0;
 	}
 
+	// Records the copies into a new image of the texture holding the mips from baseMip on. The mips both images hold
+	// are copied from the current image, the mips it gains from the image asset through the staging buffer
+	uint32_t RecordTextureStream(uint32_t index, uint32_t baseMip, uint64_t* stagingOffset)
+	{
+		const vk_texture_s* current = &m_textures[index];
+		const image_desc_s* imageDesc = (const image_desc_s*)current->content;
+		vk_texture_s* next = &m_streamTextures[m_streamCount];
+		memset(next, 0, sizeof(vk_texture_s));
+		if (CreateTextureImage(next, imageDesc, baseMip, current->format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 1) != 0)
+		{
+			DestroyTexture(next);	// Nothing of the failed image is left for the next attempt to overwrite
+			return -1;
+		}
+		next->content = current->content;
+		next->referenceCount = current->referenceCount;
+
+		VkImageSubresourceRange srRange = {};
+		srRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		srRange.levelCount = next->mipCount;
+		srRange.layerCount = 1;
+		VKTools::SetImageLayout(m_streamCommandBuffer, next->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, srRange);
+
+		const uint8_t* pixelData = (const uint8_t*)(imageDesc->mips + imageDesc->mipCount);
+		VkBufferImageCopy bufferCopies[MAX_MIPS];
+		uint32_t bufferCopyCount = 0;
+		for (uint32_t i = baseMip; i < current->baseMip; i++)
+		{
+			const mip_desc_s* mip = &imageDesc->mips[i];
+			uint64_t size = GetImageLevelSize(imageDesc->format, mip->width, mip->height);
+			memcpy(m_streamStagingData + *stagingOffset, pixelData + mip->offset, size);
+
+			VkBufferImageCopy copy = {};
+			copy.bufferOffset = *stagingOffset;
+			copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - baseMip, 0, 1 };
+			copy.imageExtent = { mip->width, mip->height, 1 };
+			bufferCopies[bufferCopyCount++] = copy;
+			*stagingOffset += (size + 15) & ~15ull;		// Offsets are a multiple of the block size
+		}
+		VkImageCopy imageCopies[MAX_MIPS];
+		uint32_t imageCopyCount = 0;
+		for (uint32_t i = std::max(baseMip, current->baseMip); i < imageDesc->mipCount; i++)
+		{
+			VkImageCopy copy = {};
+			copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - current->baseMip, 0, 1 };
+			copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - baseMip, 0, 1 };
+			copy.extent = { imageDesc->mips[i].width, imageDesc->mips[i].height, 1 };
+			imageCopies[imageCopyCount++] = copy;
+		}
+		if (bufferCopyCount)
+			vkCmdCopyBufferToImage(m_streamCommandBuffer, m_streamStagingBuffer, next->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferCopyCount, bufferCopies);
+		vkCmdCopyImage(m_streamCommandBuffer, current->image, current->imageLayout, next->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageCopyCount, imageCopies);
+		VKTools::SetImageLayout(m_streamCommandBuffer, next->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, srRange);
+
+		m_streamIndices[m_streamCount++] = index;
+		return 0;
+	}
+
+	// Called at the start of a frame, while the device is idle. The textures of the finished batch switch to their new
+	// images, then the next batch is recorded: over the budget the largest textures drop their top mip, under it the
+	// smallest textures gain a mip, so the resolution rises evenly over the scene
+	void StreamTextures()
+	{
+		if (m_streamCount)
+		{
+			if (vkGetFenceStatus(m_viewDevice, m_streamFence) != VK_SUCCESS)
+				return;		// Still copying
+			FinishTextureStream();
+		}
+
+		uint64_t budget = (uint64_t)m_cvctSettings.textureBudget << 20;
+		uint64_t textureMemory = GetTextureMemory();
+		m_cvctSettings.textureMemory = (uint32_t)(textureMemory >> 20);
+		const bool shrink = textureMemory > budget;
+
+		uint8_t inBatch[MAXTEXTURES] = {};
+		uint64_t stagingOffset = 0;
+		for (;;)
+		{
+			uint32_t best = MAXTEXTURES;
+			uint32_t bestSize = 0;
+			for (uint32_t i = 0; i < MAXTEXTURES; i++)
+			{
+				const vk_texture_s* texture = &m_textures[i];
+				if (!texture->streamed || inBatch[i])
+					continue;
+				const image_desc_s* imageDesc = (const image_desc_s*)texture->content;
+				if (shrink)
+				{
+					if (texture->baseMip >= GetResidentBaseMip(imageDesc))
+						continue;
+					uint32_t size = std::max(texture->width, texture->height);
+					if (best == MAXTEXTURES || size > bestSize)
+						best = i, bestSize = size;
+				}
+				else
+				{
+					if (texture->baseMip == 0)
+						continue;
+					uint32_t size = std::max(imageDesc->mips[texture->baseMip - 1].width, imageDesc->mips[texture->baseMip - 1].height);
+					if (best == MAXTEXTURES || size < bestSize)
+						best = i, bestSize = size;
+				}
+			}
+			if (best == MAXTEXTURES)
+				break;
+
+			const vk_texture_s* texture = &m_textures[best];
+			const image_desc_s* imageDesc = (const image_desc_s*)texture->content;
+			uint32_t baseMip = shrink ? texture->baseMip + 1 : texture->baseMip - 1;
+			uint64_t levelSize = GetImageLevelSize(imageDesc->format, imageDesc->mips[baseMip].width, imageDesc->mips[baseMip].height);
+			if (!shrink && textureMemory + levelSize > budget)
+				break;
+			if (!shrink && m_streamCount && stagingOffset + levelSize > TEXTURESTREAM_BATCH_SIZE)
+				break;
+
+			if (!m_streamCount)
+			{
+				// A mip larger than a batch is uploaded on its own
+				ReserveStreamStaging(levelSize);
+				// A failed first record leaves the command buffer begun, the next texture records into it
+				if (m_streamCommandBuffer == VK_NULL_HANDLE)
+					m_streamCommandBuffer = VKTools::Initializers::CreateCommandBuffer(m_devicePools.transfer, m_viewDevice, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			}
+			inBatch[best] = 1;
+			if (RecordTextureStream(best, baseMip, &stagingOffset) != 0)
+				continue;
+			textureMemory = shrink ? textureMemory - texture->residentBytes + m_streamTextures[m_streamCount - 1].residentBytes : textureMemory + levelSize;
+			if (shrink && textureMemory <= budget)
+				break;
+		}
+		if (!m_streamCount)
+		{
+			if (m_streamCommandBuffer != VK_NULL_HANDLE)
+				vkFreeCommandBuffers(m_viewDevice, m_devicePools.transfer, 1, &m_streamCommandBuffer);
+			m_streamCommandBuffer = VK_NULL_HANDLE;
+			return;
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(m_streamCommandBuffer));
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_streamCommandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(m_deviceQueues.transfer, 1, &submitInfo, m_streamFence));
+	}
+
+	// The batch is copied, the textures switch to their new images and the states copy the new descriptors
+	void FinishTextureStream()
+	{
+		for (uint32_t i = 0; i < m_streamCount; i++)
+		{
+			uint32_t index = m_streamIndices[i];
+			DestroyTexture(&m_textures[index]);
+			m_textures[index] = m_streamTextures[i];
+			for (uint32_t slot = 0; slot < MAXTEXTURES; slot++)
+			{
+				if (m_textureSlots[slot] == index)
+					WriteTextureSlot(slot);
+			}
+		}
+		vkFreeCommandBuffers(m_viewDevice, m_devicePools.transfer, 1, &m_streamCommandBuffer);
+		m_streamCommandBuffer = VK_NULL_HANDLE;
+		vkResetFences(m_viewDevice, 1, &m_streamFence);
+		m_streamCount = 0;
+		WriteEmptyTextureSlots();
+		RebuildStaticCommandBuffers();
+	}
+
+	// Drops the batch in flight, the textures keep their current images
+	void DiscardTextureStream()
+	{
+		if (!m_streamCount)
+			return;
+		vkWaitForFences(m_viewDevice, 1, &m_streamFence, VK_TRUE, UINT64_MAX);
+		for (uint32_t i = 0; i < m_streamCount; i++)
+			DestroyTexture(&m_streamTextures[i]);
+		vkFreeCommandBuffers(m_viewDevice, m_devicePools.transfer, 1, &m_streamCommandBuffer);
+		m_streamCommandBuffer = VK_NULL_HANDLE;
+		vkResetFences(m_viewDevice, 1, &m_streamFence);
+		m_streamCount = 0;
+	}
+
 	uint32_t CreateSamplers()
 	{
 		//create the texture sampler
@@ -1392,10 +1798,67 @@ public:
 	{
 		m_uploadCommandBuffer = VKTools::Initializers::CreateCommandBuffer(m_devicePools.graphics, m_viewDevice, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		m_clearCommandBuffer = VKTools::Initializers::CreateCommandBuffer(m_devicePools.graphics, m_viewDevice, VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VK_CHECK_RESULT(vkCreateFence(m_viewDevice, &fenceInfo, NULL, &m_uploadFence));
+		return CreateUploadRing(UPLOADRING_SIZE);
+	}
+
+	uint32_t CreateUploadRing(uint64_t size)
+	{
+		VKTools::CreateBuffer((VulkanCore*)this, m_viewDevice,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			size,
+			NULL,
+			&m_uploadRingBuffer,
+			&m_uploadRingMemory);
+		VK_CHECK_RESULT(vkMapMemory(m_viewDevice, m_uploadRingMemory, 0, size, 0, (void**)&m_uploadRingData));
+		m_uploadRingSize = size;
+		m_uploadRingHead = 0;
 		return 0;
 	}
 
-	uint32_t UploadData()
+	void DestroyUploadRing()
+	{
+		vkUnmapMemory(m_viewDevice, m_uploadRingMemory);
+		vkDestroyBuffer(m_viewDevice, m_uploadRingBuffer, NULL);
+		vkFreeMemory(m_viewDevice, m_uploadRingMemory, NULL);
+		m_uploadRingData = NULL;
+		m_uploadRingSize = 0;
+	}
+
+	// Staging memory of a copy recorded into m_uploadCommandBuffer, valid until the copies are submitted
+	uint8_t* AllocateUpload(uint64_t size, VkDeviceSize* outOffset)
+	{
+		if (!m_uploadBytes)
+			QueryPerformanceCounter(&m_uploadStart);
+
+		uint64_t offset = (m_uploadRingHead + 15) & ~15ull;		// Offsets are a multiple of the texel block size
+		if (offset + size > m_uploadRingSize)
+		{
+			// The ring is full, it is free again once the copies recorded so far are done
+			if (m_uploadRingHead)
+			{
+				SubmitUploads();
+				m_uploadCommandBuffer = VKTools::Initializers::CreateCommandBuffer(m_devicePools.graphics, m_viewDevice, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			}
+			if (size > m_uploadRingSize)
+			{
+				DestroyUploadRing();
+				CreateUploadRing(size);
+			}
+			offset = 0;
+		}
+		m_uploadRingHead = offset + size;
+		m_uploadBytes += size;
+		*outOffset = offset;
+		return m_uploadRingData + offset;
+	}
+
+	// Submits the recorded copies in one batch and waits for them, the ring starts over
+	void SubmitUploads()
 	{
 		VK_CHECK_RESULT(vkEndCommandBuffer(m_uploadCommandBuffer));
 
@@ -1410,10 +1873,29 @@ public:
 		copySubmitInfo.signalSemaphoreCount = 0;
 		copySubmitInfo.pSignalSemaphores = NULL;
 
-		VK_CHECK_RESULT(vkQueueSubmit(m_deviceQueues.graphics, 1, &copySubmitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(m_deviceQueues.graphics));
+		VK_CHECK_RESULT(vkQueueSubmit(m_deviceQueues.graphics, 1, &copySubmitInfo, m_uploadFence));
+		VK_CHECK_RESULT(vkWaitForFences(m_viewDevice, 1, &m_uploadFence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(m_viewDevice, 1, &m_uploadFence));
 
 		vkFreeCommandBuffers(m_viewDevice, m_devicePools.graphics, 1, &m_uploadCommandBuffer);
+		m_uploadRingHead = 0;
+		m_uploadSubmitCount++;
+	}
+
+	uint32_t UploadData()
+	{
+		SubmitUploads();
+		if (m_uploadBytes)
+		{
+			LARGE_INTEGER end, frequency;
+			QueryPerformanceCounter(&end);
+			QueryPerformanceFrequency(&frequency);
+			double seconds = (double)(end.QuadPart - m_uploadStart.QuadPart) / frequency.QuadPart;
+			double megabytes = m_uploadBytes / (1024.0 * 1024.0);
+			printf("Uploaded %.02f MB in %u submissions, %.02f ms (%.02f MB/s)\n", megabytes, m_uploadSubmitCount, seconds * 1000.0, megabytes / seconds);
+		}
+		m_uploadBytes = 0;
+		m_uploadSubmitCount = 0;
 		return 0;
 	}
 
@@ -1421,8 +1903,9 @@ public:
 	{
 		if (!m_scene)	RETURN_ERROR(-1, "Textures trying to load before scene is assigned");
 
-		m_textureCount = m_scene->textureCount;
-		int32_t high = -1;		//TODO: UGLY, FIX LATER
+		memset(m_textureSlots, 0xFF, sizeof(m_textureSlots));
+		m_textureCount = 0;
+		uint32_t slotCount = 0, textureCount = 0;
 		// Calculate/assign texture ID to meshes
 		for (uint32_t r = 0; r < m_scene->modelReferenceCount; r++)
 		{
@@ -1432,7 +1915,13 @@ public:
 				material_s* material = &m_scene->materials[modelRef->materialIndices[k]];
 				for (uint32_t t = 0; t < material->textureReferenceCount; t++)
 				{
-					texture_ref_s* textureRef = &m_scene->textureRefs[material->textureReferenceStart + t];
+					uint32_t slot = material->textureReferenceStart + t;
+					if (slot >= MAXTEXTURES)
+						RETURN_ERROR(-1, "Number of texture references exceed limit");
+					if (m_textureSlots[slot] != TEXTURESLOT_EMPTY)
+						continue;	// Materials are shared between model references
+
+					texture_ref_s* textureRef = &m_scene->textureRefs[slot];
 					texture_s* texture = &m_scene->textures[textureRef->textureIndex];
 					
 					char totallPath[512];
@@ -1440,23 +1929,27 @@ public:
 					strncpy(totallPath, ASSETPATH, sizeof(totallPath));
 					strncat(totallPath, path, sizeof(totallPath));
 					
-					if (int32_t(material->textureReferenceStart + t) > high)
-					{
-						high = material->textureReferenceStart + t;
-						CreateTexture(material->textureReferenceStart + t, totallPath);
-					}
+					uint32_t created;
+					if (AcquireTextureSlot(slot, totallPath, &created) >= 0)
+						slotCount++, textureCount += created;
 				}
 			}
 		}
+		printf("%u texture references use %u textures\n", slotCount, textureCount);
+		WriteEmptyTextureSlots();
 
 		return 0;
 	}
 
-	uint32_t BuildCommandMip()
+	// Generates the mip chain of the given textures, all textures when no indices are passed
+	uint32_t BuildCommandMip(const uint32_t* textureIndices = NULL, uint32_t textureIndexCount = 0)
 	{
+		uint32_t textureCount = textureIndices ? textureIndexCount : m_textureCount;
 		uint32_t totalDescriptorSetCount = 0;
-		for (uint32_t i = 0; i < m_textureCount; i++)
-			totalDescriptorSetCount += m_textures[i].descriptorSetCount;
+		for (uint32_t n = 0; n < textureCount; n++)
+			totalDescriptorSetCount += m_textures[textureIndices ? textureIndices[n] : n].descriptorSetCount;
+		if (!totalDescriptorSetCount)
+			return 0;	// Every mip chain came from the converter
 
 		////////////////////////////////////////////////////////////////////////////////
 		// Create commandbuffers and semaphores
@@ -1550,9 +2043,9 @@ public:
 		vkCmdBindPipeline(mipCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mipPipeline);
 
 		uint32_t desCount = 0;
-		for (uint32_t i = 0; i < m_textureCount; i++)
+		for (uint32_t n = 0; n < textureCount; n++)
 		{
-			vk_texture_s* tex = &m_textures[i];
+			vk_texture_s* tex = &m_textures[textureIndices ? textureIndices[n] : n];
 			uint32_t mipcount = tex->mipCount - 1;
 			int32_t mipRemainder = mipcount;
 			for (uint32_t j = 0; j < tex->descriptorSetCount; j++)
@@ -1624,9 +2117,328 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(m_deviceQueues.compute, 1, &submit, VK_NULL_HANDLE));
 		vkDeviceWaitIdle(m_viewDevice);
 
+		// Only used once per call, hot reloading calls it again
+		vkFreeCommandBuffers(m_viewDevice, GetComputeCommandPool(), 1, &mipCommandBuffer);
+		vkDestroyPipeline(m_viewDevice, mipPipeline, NULL);
+		vkDestroyShaderModule(m_viewDevice, shaderStage.m_shaderStage.module, NULL);
+		vkDestroyPipelineLayout(m_viewDevice, pipelineLayout, NULL);
+		vkDestroyDescriptorPool(m_viewDevice, descriptorPool, NULL);
+		vkDestroyDescriptorSetLayout(m_viewDevice, layout, NULL);
+		vkDestroySemaphore(m_viewDevice, mipSemaphore, NULL);
+		vkDestroyBuffer(m_viewDevice, uniformData.m_buffer, NULL);
+		vkFreeMemory(m_viewDevice, uniformData.m_memory, NULL);
+
 		return 0;
 	}
 
+	void DestroyTexture(vk_texture_s* vktexture)
+	{
+		for (uint32_t i = 0; i < vktexture->descriptorSetCount; i++)
+		{
+			vkDestroyBuffer(m_viewDevice, vktexture->uboDescriptor[i].m_buffer, NULL);
+			vkFreeMemory(m_viewDevice, vktexture->uboDescriptor[i].m_memory, NULL);
+		}
+		for (uint32_t i = 0; i < vktexture->mipCount; i++)
+			vkDestroyImageView(m_viewDevice, vktexture->view[i], NULL);
+		vkDestroyImage(m_viewDevice, vktexture->image, NULL);
+		vkFreeMemory(m_viewDevice, vktexture->deviceMemory, NULL);
+		free(vktexture->view);
+		free(vktexture->descriptor);
+		free(vktexture->ubo);
+		free(vktexture->uboDescriptor);
+		memset(vktexture, 0, sizeof(vk_texture_s));
+	}
+
+	// Texture slots created from the image at path, a slot is the index of the texture reference (see LoadTextures)
+	uint32_t FindTextureSlots(const char* path, uint32_t* outSlots, uint32_t maxSlots)
+	{
+		uint32_t slotCount = 0;
+		for (uint32_t r = 0; r < m_scene->modelReferenceCount; r++)
+		{
+			model_ref_s* modelRef = &m_scene->modelRefs[r];
+			for (uint32_t k = 0; k < modelRef->materialIndexCount; k++)
+			{
+				material_s* material = &m_scene->materials[modelRef->materialIndices[k]];
+				for (uint32_t t = 0; t < material->textureReferenceCount; t++)
+				{
+					uint32_t slot = material->textureReferenceStart + t;
+					texture_ref_s* textureRef = &m_scene->textureRefs[slot];
+					texture_s* texture = &m_scene->textures[textureRef->textureIndex];
+
+					char totallPath[512];
+					snprintf(totallPath, sizeof(totallPath), "%s%s", ASSETPATH, m_scene->stringData + texture->pathOffset);
+					if (strcmp(totallPath, path) != 0)
+						continue;
+
+					// materials are shared between model references
+					uint32_t known = 0;
+					for (uint32_t i = 0; i < slotCount; i++)
+						known |= (outSlots[i] == slot);
+					if (!known && slotCount < maxSlots)
+						outSlots[slotCount++] = slot;
+				}
+			}
+		}
+		return slotCount;
+	}
+
+	// Points the texture references of the image at path to its new data, returns the number of references
+	uint32_t ReloadTextures(const char* path)
+	{
+		uint32_t slots[MAXTEXTURES];
+		uint32_t slotCount = FindTextureSlots(path, slots, MAXTEXTURES);
+		if (!slotCount)
+			return 0;
+
+		// Release every slot first, a texture only used by these slots is destroyed instead of shared with the new image
+		for (uint32_t i = 0; i < slotCount; i++)
+			ReleaseTextureSlot(slots[i]);
+
+		uint32_t createdTextures[MAXTEXTURES];
+		uint32_t createdCount = 0;
+		m_uploadCommandBuffer = VKTools::Initializers::CreateCommandBuffer(m_devicePools.graphics, m_viewDevice, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			uint32_t created;
+			int32_t index = AcquireTextureSlot(slots[i], path, &created);
+			if (created)
+				createdTextures[createdCount++] = (uint32_t)index;
+		}
+		WriteEmptyTextureSlots();
+		UploadData();
+		BuildCommandMip(createdTextures, createdCount);
+
+		return slotCount;
+	}
+
+	// Scale and bias the shaders decode the positions of the scene with
+	void SetScenePositionDecode()
+	{
+		m_uboVS.positionScale = glm::vec4(m_scene->positionScale[0], m_scene->positionScale[1], m_scene->positionScale[2], 0.0f);
+		m_uboVS.positionBias = glm::vec4(m_scene->positionBias[0], m_scene->positionBias[1], m_scene->positionBias[2], 0.0f);
+	}
+
+	// The vulkan meshes and textures only depend on these, the geometry itself may differ
+	static bool SceneLayoutMatches(const scene_s* a, const scene_s* b)
+	{
+		if (a->modelCount != b->modelCount || a->meshCount != b->meshCount || a->materialCount != b->materialCount ||
+			a->vertexBufferCount != b->vertexBufferCount || a->indexBufferCount != b->indexBufferCount ||
+			a->modelReferenceCount != b->modelReferenceCount || a->materialIndexCount != b->materialIndexCount ||
+			a->textureCount != b->textureCount || a->textureReferenceCount != b->textureReferenceCount ||
+			a->vertexDataSizeInBytes != b->vertexDataSizeInBytes || a->indexDataSizeInBytes != b->indexDataSizeInBytes ||
+			a->stringDataSizeInBytes != b->stringDataSizeInBytes || a->vertexFlags != b->vertexFlags)
+			return false;
+
+		for (uint32_t r = 0; r < a->modelReferenceCount; r++)
+		{
+			if (a->modelRefs[r].modelIndex != b->modelRefs[r].modelIndex || a->modelRefs[r].materialIndexCount != b->modelRefs[r].materialIndexCount)
+				return false;
+		}
+
+		return memcmp(a->models, b->models, a->modelCount * sizeof(model_s)) == 0 &&
+			memcmp(a->meshes, b->meshes, a->meshCount * sizeof(mesh_s)) == 0 &&
+			memcmp(a->materials, b->materials, a->materialCount * sizeof(material_s)) == 0 &&
+			memcmp(a->vertexBuffers, b->vertexBuffers, a->vertexBufferCount * sizeof(vertex_buffer_s)) == 0 &&
+			memcmp(a->indexBuffers, b->indexBuffers, a->indexBufferCount * sizeof(index_buffer_s)) == 0 &&
+			memcmp(a->materialIndices, b->materialIndices, a->materialIndexCount * sizeof(uint32_t)) == 0 &&
+			memcmp(a->textures, b->textures, a->textureCount * sizeof(texture_s)) == 0 &&
+			memcmp(a->textureRefs, b->textureRefs, a->textureReferenceCount * sizeof(texture_ref_s)) == 0 &&
+			memcmp(a->stringData, b->stringData, a->stringDataSizeInBytes) == 0;
+	}
+
+	// Copies the vertex and index buffers that changed into the scene buffer, returns the number of copied buffers
+	uint32_t UploadChangedSceneRanges(const scene_s* oldScene)
+	{
+		std::vector<VkBufferCopy> regions;
+		uint64_t stagingSize = 0;
+		for (uint32_t i = 0; i < m_scene->vertexBufferCount; i++)
+		{
+			vertex_buffer_s* vb = &m_scene->vertexBuffers[i];
+			if (memcmp(oldScene->vertexData + vb->vertexOffset, m_scene->vertexData + vb->vertexOffset, vb->totalSize) == 0)
+				continue;
+			regions.push_back({ stagingSize, vb->vertexOffset, vb->totalSize });
+			stagingSize += vb->totalSize;
+		}
+		for (uint32_t i = 0; i < m_scene->indexBufferCount; i++)
+		{
+			index_buffer_s* ib = &m_scene->indexBuffers[i];
+			if (memcmp(oldScene->indexData + ib->indexOffset, m_scene->indexData + ib->indexOffset, ib->totalSize) == 0)
+				continue;
+			regions.push_back({ stagingSize, m_scene->vertexDataSizeInBytes + ib->indexOffset, ib->totalSize });
+			stagingSize += ib->totalSize;
+		}
+		if (regions.empty())
+			return 0;
+
+		m_uploadCommandBuffer = VKTools::Initializers::CreateCommandBuffer(m_devicePools.graphics, m_viewDevice, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkDeviceSize stagingOffset;
+		uint8_t* dst = AllocateUpload(stagingSize, &stagingOffset);
+
+		// The scene buffer holds the vertex data followed by the index data
+		for (size_t i = 0; i < regions.size(); i++)
+		{
+			const uint8_t* src = (regions[i].dstOffset < m_scene->vertexDataSizeInBytes) ?
+				m_scene->vertexData + regions[i].dstOffset :
+				m_scene->indexData + (regions[i].dstOffset - m_scene->vertexDataSizeInBytes);
+			memcpy(dst + regions[i].srcOffset, src, regions[i].size);
+			regions[i].srcOffset += stagingOffset;
+		}
+		vkCmdCopyBuffer(m_uploadCommandBuffer, m_uploadRingBuffer, m_vertices.buf, (uint32_t)regions.size(), regions.data());
+		UploadData();
+
+		return (uint32_t)regions.size();
+	}
+
+	// The meshes are baked into the states drawing the scene, they are created again
+	void RecreateMeshRenderStates()
+	{
+		DestroyRenderStates(ForwardRendererState, (VulkanCore*)this, GetGraphicsCommandPool());		// Forward
+		DestroyRenderStates(VoxelizerState, (VulkanCore*)this, GetGraphicsCommandPool());			// Voxelizer
+		DestroyRenderStates(ForwardMainRenderState, (VulkanCore*)this, GetGraphicsCommandPool());	// Forward main render
+		DestroyRenderStates(DeferredMainRenderState, (VulkanCore*)this, GetGraphicsCommandPool());	// Deferred main render
+		// Forward renderer pipeline state
+		CreateForwardRenderState(
+			ForwardRendererState,
+			m_frameBuffers.data(),
+			m_swapChain.m_imageCount,
+			(VulkanCore*)this,
+			m_devicePools.graphics,
+			&m_swapChain,
+			m_staticDescriptorSet,
+			&m_vertices,
+			m_meshes,
+			m_meshCount,
+			m_renderPass,
+			m_staticDescriptorSetLayout);
+		// Voxelizer pipeline state
+		CreateVoxelizerState(
+			VoxelizerState,
+			(VulkanCore*)this,
+			m_devicePools.graphics,
+			&m_swapChain,
+			m_staticDescriptorSet,
+			&m_vertices,
+			m_meshes,
+			m_meshCount,
+			m_staticDescriptorSetLayout,
+			m_camera,
+			&m_avt);
+		// Forward main renderer pipeline state
+		CreateForwardMainRendererState(
+			ForwardMainRenderState,
+			m_frameBuffers.data(),
+			m_swapChain.m_imageCount,
+			(VulkanCore*)this,
+			m_devicePools.graphics,
+			m_viewDevice,
+			&m_swapChain,
+			m_staticDescriptorSet,
+			&m_vertices,
+			m_meshes,
+			m_meshCount,
+			m_renderPass,
+			m_staticDescriptorSetLayout,
+			&m_avt);
+		// Deferred main renderer pipeline state
+		CreateDeferredMainRenderState(
+			DeferredMainRenderState,
+			m_swapChain.m_imageCount,
+			(VulkanCore*)this,
+			GetGraphicsCommandPool(),
+			&m_swapChain,
+			m_staticDescriptorSet,
+			&m_vertices,
+			m_meshes,
+			m_meshCount,
+			&m_avt,
+			m_staticDescriptorSetLayout,
+			m_cvctSettings.deferredScale);
+	}
+
+	// Uploads the geometry of the reconverted scene. Returns 1 when its layout changed and the scene resources were created again
+	uint32_t ReloadScene(const scene_s* oldScene)
+	{
+		SetScene(GetAssetStaticManager(m_scenePath));
+		if (SceneLayoutMatches(oldScene, m_scene))
+		{
+			SetScenePositionDecode();
+			uint32_t copyCount = UploadChangedSceneRanges(oldScene);
+			printf(" - Uploaded %u of %u scene buffers\n", copyCount, m_scene->vertexBufferCount + m_scene->indexBufferCount);
+			return 0;
+		}
+
+		// Different meshes or materials, the scene buffer, textures and states drawing it are created again
+		printf(" - Scene layout changed, recreating the scene resources\n");
+		vkDestroyBuffer(m_viewDevice, m_vertices.buf, NULL);
+		vkFreeMemory(m_viewDevice, m_vertices.mem, NULL);
+		for (uint32_t i = 0; i < MAXTEXTURES; i++)
+		{
+			if (m_textures[i].image != VK_NULL_HANDLE)
+				DestroyTexture(&m_textures[i]);
+		}
+		m_uploadCommandBuffer = VKTools::Initializers::CreateCommandBuffer(m_devicePools.graphics, m_viewDevice, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		CreateScene();
+		LoadTextures();
+		UploadData();
+		BuildCommandMip();
+		RecreateMeshRenderStates();
+		return 1;
+	}
+
+	// Re-records the states binding the static descriptor set, they copy the texture descriptors while recording
+	void RebuildStaticCommandBuffers()
+	{
+		BuildCommandBuffer(ForwardRendererState, GetGraphicsCommandPool(), (VulkanCore*)this, (uint32_t)m_frameBuffers.size(), m_frameBuffers.data());
+		BuildCommandBuffer(VoxelizerState, GetGraphicsCommandPool(), (VulkanCore*)this, VoxelizerState.m_framebufferCount, VoxelizerState.m_framebuffers);
+		BuildCommandBuffer(VoxelDebugState, GetGraphicsCommandPool(), (VulkanCore*)this, (uint32_t)m_frameBuffers.size(), m_frameBuffers.data());
+		BuildCommandBuffer(ForwardMainRenderState, GetGraphicsCommandPool(), (VulkanCore*)this, (uint32_t)m_frameBuffers.size(), m_frameBuffers.data());
+		BuildCommandBuffer(DeferredMainRenderState, GetGraphicsCommandPool(), (VulkanCore*)this, m_swapChain.m_imageCount, DeferredMainRenderState.m_framebuffers);
+	}
+
+	// Hot reload. Converts the changed asset again and replaces the GPU resources created from it in place,
+	// the pipelines stay as they are
+	void ReloadChangedAsset(const char* path, uint32_t pathLength)
+	{
+		LARGE_INTEGER start, end, frequency;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&start);
+
+		// The text scene is only imported, the compiled scene it writes is reported next and reloaded then
+		if (strcmp(path, SPONZAPATH) == 0)
+		{
+			ImportSceneStaticManager(path, pathLength);
+			return;
+		}
+
+		const scene_s* oldScene = m_scene;
+		if (m_assetManager.ReloadAsset(path, pathLength) != 0)
+			return;		// Not used by the application, unchanged, or the conversion failed and the old asset stays in use
+
+		// Nothing may use the resources while they are replaced
+		vkDeviceWaitIdle(m_viewDevice);
+		DiscardTextureStream();
+		uint32_t rebuild = 0;
+		if (strcmp(path, m_scenePath) == 0)
+			rebuild |= ReloadScene(oldScene);
+		else
+			ReloadTextures(path);
+
+		// Walk the dependency graph to the assets using the changed one. The scene only stores the paths of its
+		// textures, so it is not converted again, but the states drawing it are recorded again
+		uint32_t dependents[MAXTEXTURES];
+		uint32_t dependentCount = m_assetManager.GetDependents(path, pathLength, dependents, MAXTEXTURES);
+		for (uint32_t i = 0; i < dependentCount && i < MAXTEXTURES; i++)
+		{
+			if (strcmp(m_assetManager.m_assetDescriptors[dependents[i]].name, m_scenePath) == 0)
+				rebuild = 1;
+		}
+		if (rebuild)
+			RebuildStaticCommandBuffers();
+
+		QueryPerformanceCounter(&end);
+		printf("Reloaded %s in %.02f ms, %u dependent assets\n", path, 1000.0 * (end.QuadPart - start.QuadPart) / frequency.QuadPart, dependentCount);
+	}
+
 	void Prepare()
 	{
 		// glfw settings
@@ -1646,8 +2458,9 @@ public:
 		CreateCommandBuffer();
 		//create image samplers
 		CreateSamplers();
+		CreateTextureStreaming();
 		//load all the data
-		SetScene(GetAssetStaticManager(SPONZAPATH));	// Create the scene
+		SetScene(GetAssetStaticManager(m_scenePath));	// Create the scene
 		CreateScene();									// Create the scene meshes
 		LoadTextures();									// Loads all the scene textures
 		
@@ -1768,6 +2581,10 @@ void resize(GLFWwindow* window, int w, int h)
 {
 	m_cvct->WindowResize(window, w, h);
 }
+void AssetChanged(const char* path, uint32_t pathLength, void* userData)
+{
+	((CVCT*)userData)->ReloadChangedAsset(path, pathLength);
+}
 
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
 {
@@ -1780,17 +2597,25 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLin
 	// Initialize window
 	m_cvct->InitializeGLFWWindow(false);
 	// Load model here
-	std::string path = SPONZAPATH;
+	uint32_t scenePathLength = GetCompiledScenePath(SPONZAPATH, m_scenePath, sizeof(m_scenePath));
 	m_assetManager.InitAssetManager();
-	m_assetManager.LoadAsset(path.c_str(), (uint32_t)path.length());
+	if (!IsCompiledSceneCurrent(m_scenePath, SPONZAPATH))
+		ImportSceneStaticManager(SPONZAPATH, (uint32_t)strlen(SPONZAPATH));	// Missing or older than the text scene
+	m_assetManager.LoadAsset(m_scenePath, scenePathLength);
 	// Initialize vulkan
 	m_cvct->InitializeSwapchain();
 	m_cvct->CVCT::Prepare();
+	// Watch the assets, changed files are reloaded while running
+	if (m_assetWatcher.Init(ASSETPATH) != 0)
+		printf("Unable to watch %s, asset hot reloading is disabled\n", ASSETPATH);
 	// Renderloop
 	m_cvct->RenderLoop();
+	m_assetWatcher.Shutdown();
 
 	// Flush all assets
 	m_assetManager.FlushAssets();
+	// Report the allocator usage, used to size the reservations
+	DumpVirtualMemoryStats("memory_stats.json");
 	// Cleanup
 	// todo: do cleanup
 
@@ -18,19 +18,19 @@ const int MAX_STEPS = 300;
 
 layout (location = 0) in vec2 inUV;
 
-layout (input_attachment_index = 1, set = 2, binding = 3) uniform subpassInput samplerposition;
-layout (input_attachment_index = 2, set = 2, binding = 4) uniform subpassInput samplerNormal;
-layout (input_attachment_index = 3, set = 2, binding = 5) uniform subpassInput samplerAlbedo;
-layout (input_attachment_index = 4, set = 2, binding = 6) uniform subpassInput samplerTangent;
+layout (input_attachment_index = 1, set = 1, binding = 3) uniform subpassInput samplerposition;
+layout (input_attachment_index = 2, set = 1, binding = 4) uniform subpassInput samplerNormal;
+layout (input_attachment_index = 3, set = 1, binding = 5) uniform subpassInput samplerAlbedo;
+layout (input_attachment_index = 4, set = 1, binding = 6) uniform subpassInput samplerTangent;
 
 //output
 layout (location = 0) out vec4 outColor;
 
 //set bindings
-layout(set = 2, binding = 1) uniform sampler3D rVoxelColor;					// Read
-layout(set = 2, binding = 2) writeonly uniform image2D scaledOutput;		// write
+layout(set = 1, binding = 1) uniform sampler3D rVoxelColor;					// Read
+layout(set = 1, binding = 2) writeonly uniform image2D scaledOutput;		// write
 
-layout (set = 2, binding = 0) uniform UBO 
+layout (set = 1, binding = 0) uniform UBO 
 {
 	vec4 voxelRegionWorld[MAXCASCADE];	// list of voxel region worlds
 	vec3 cameraPosition;				// Positon of the camera adsfasdfa
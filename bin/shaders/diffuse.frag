@@ -3,6 +3,8 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+#define MAXTEXTURES 256		// MAXTEXTURES of CVCT.cpp
+
 //input
 layout(location = 0) in vec2 inTex;
 layout(location = 1) in vec3 inWPos;
@@ -15,12 +17,16 @@ layout(location = 0) out vec4 outFragColor;
 
 //set bindings
 layout(set = 0, binding = 1) uniform sampler textureSampler;
-layout(set = 1, binding = 0) uniform texture2D diffuseTexture;
-layout(set = 1, binding = 1) uniform texture2D normalTexture;
-layout(set = 1, binding = 2) uniform texture2D maskTexture;
+layout(set = 0, binding = 2) uniform texture2D textures[MAXTEXTURES];	// All scene textures, indexed per draw
+layout(push_constant) uniform PushConsts
+{
+	layout(offset = 0)uint diffuseIndex;
+	layout(offset = 4)uint normalIndex;
+	layout(offset = 8)uint maskIndex;
+} material;
 
 void main() 
 {
-	vec3 col = texture ( sampler2D ( diffuseTexture, textureSampler ), inTex).rgb;
+	vec3 col = texture ( sampler2D ( textures[material.diffuseIndex], textureSampler ), inTex).rgb;
 	outFragColor = vec4(col, 1.0);
 }
\ No newline at end of file
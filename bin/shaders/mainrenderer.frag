@@ -3,6 +3,8 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+#define MAXTEXTURES 256		// MAXTEXTURES of CVCT.cpp
+
 #define COLOR_IMAGE_COUNT 6.0
 
 #define EPS       0.0001
@@ -31,11 +33,15 @@ layout(location = 0) out vec4 outColor;
 
 //set bindings
 layout(set = 0, binding = 1) uniform sampler textureSampler;
-layout(set = 1, binding = 0) uniform texture2D diffuseTexture;
-layout(set = 1, binding = 1) uniform texture2D normalTexture;
-layout(set = 1, binding = 2) uniform texture2D maskTexture;
-layout(set = 2, binding = 1) uniform sampler3D rVoxelColor;					// Read
-layout (set = 2, binding = 0) uniform UBO 
+layout(set = 0, binding = 2) uniform texture2D textures[MAXTEXTURES];	// All scene textures, indexed per draw
+layout(push_constant) uniform PushConsts
+{
+	layout(offset = 0)uint diffuseIndex;
+	layout(offset = 4)uint normalIndex;
+	layout(offset = 8)uint maskIndex;
+} material;
+layout(set = 1, binding = 1) uniform sampler3D rVoxelColor;					// Read
+layout (set = 1, binding = 0) uniform UBO 
 {
 	vec4 voxelRegionWorld[MAXCASCADE];	// list of voxel region worlds
 	vec3 cameraPosition;				// Positon of the camera adsfasdfa
@@ -194,7 +200,7 @@ void main()
 	vec3 worldpos = inWPos;
 	
 	// Diffuse color
-	vec3 diffuse = texture ( sampler2D ( diffuseTexture, textureSampler ), inTex).rgb;
+	vec3 diffuse = texture ( sampler2D ( textures[material.diffuseIndex], textureSampler ), inTex).rgb;
 	
 	// Normals
 	vec3 normal = normalize(inWNormal);
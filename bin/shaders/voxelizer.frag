@@ -18,6 +18,7 @@
 #define TEXTURE_DIFFUSE 0
 #define TEXTURE_NORMAL 1
 #define TEXTURE_MASK 2
+#define MAXTEXTURES 256		// MAXTEXTURES of CVCT.cpp
 #define EPS 0000.1f
 
 // Input
@@ -29,12 +30,9 @@ layout(location = 4) in vec3 inWBitan;
 
 // Set binding 0
 layout(set = 0, binding = 1) uniform sampler textureSampler;
-// Set binding 1
-layout(set = 1, binding = 0) uniform texture2D diffuseTexture;
-layout(set = 1, binding = 1) uniform texture2D normalTexture;
-layout(set = 1, binding = 2) uniform texture2D maskTexture;
+layout(set = 0, binding = 2) uniform texture2D textures[MAXTEXTURES];	// All scene textures, indexed per draw
 // Uniform buffers
-layout (set = 2, binding = 2) uniform UBO 
+layout (set = 1, binding = 2) uniform UBO 
 {
 	vec4 voxelRegionWorld;	// Base(0) origin(.xyz) and size of the grid region(.w) ( campos - (voxelbaseregion / 2) )
 	uint voxelResolution;	// Resolution of the voxel grid
@@ -42,13 +40,16 @@ layout (set = 2, binding = 2) uniform UBO
 	vec2 padding0;
 } ubo;
 // Voxel textures
-layout(set = 2, binding = COLOR_IMAGE_VOXEL, r32ui) uniform uimage3D tVoxColor;
+layout(set = 1, binding = COLOR_IMAGE_VOXEL, r32ui) uniform uimage3D tVoxColor;
 // Alpha textures
-layout(set = 2, binding = ALPHA_IMAGE_VOXEL, r32ui) uniform uimage3D tVoxAlpha;
+layout(set = 1, binding = ALPHA_IMAGE_VOXEL, r32ui) uniform uimage3D tVoxAlpha;
 // Current processed cascade
 layout(push_constant) uniform PushConsts
 {
 	layout(offset = 0)uint cascadeNum;		// The current cascade
+	layout(offset = 4)uint diffuseIndex;	// Material textures of the draw
+	layout(offset = 8)uint normalIndex;
+	layout(offset = 12)uint maskIndex;
 } pc;
 
 // Globals
@@ -124,7 +125,7 @@ void main()
 	// Get the visibility from the depth texture, to see if the texel is lit by the light
     float visibility = getVisibility();
 	// Get the diffuse color of the texel
-	vec4 diffuse = texture(sampler2D(diffuseTexture, textureSampler), inTex);
+	vec4 diffuse = texture(sampler2D(textures[pc.diffuseIndex], textureSampler), inTex);
 	// Get the alpha from the diffuse texture
 	float alpha = diffuse.a;
     alpha = 1.0;
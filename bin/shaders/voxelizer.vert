@@ -3,12 +3,11 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-//input locations
-layout(location = 0) in vec3 inPos;
+//input locations, packed by the scene importer
+layout(location = 0) in vec3 inPos;		//floats or unorm16, decoded with the position scale and bias
 layout(location = 1) in vec2 inTex;
-layout(location = 2) in vec3 inNorm;
-layout(location = 3) in vec3 inTan;
-layout(location = 4) in vec3 inBtan;
+layout(location = 2) in vec2 inNorm;	//octahedral
+layout(location = 3) in vec2 inTan;		//octahedral, the sign of y is the handedness of the frame
 
 //output locations
 layout(location = 0) out vec2 outTex;
@@ -22,6 +21,8 @@ layout (set = 0, binding = 0) uniform UBO
 	mat4 modelMatrix;
 	mat4 viewMatrix;
 	mat4 projectionMatrix;
+	vec4 positionScale;
+	vec4 positionBias;
 } ubo;
 
 out gl_PerVertex 
@@ -29,13 +30,26 @@ out gl_PerVertex
     vec4 gl_Position;   
 };
 
+vec3 OctDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
 void main() 
 {
-	vec4 wpos = ubo.modelMatrix * vec4(inPos.xyz, 1.0);
+	vec3 pos = inPos * ubo.positionScale.xyz + ubo.positionBias.xyz;
+	vec3 normal = OctDecode(inNorm);
+	vec3 tangent = OctDecode(vec2(inTan.x, abs(inTan.y) * 2.0 - 1.0));
+	vec3 bitangent = cross(normal, tangent) * (inTan.y < 0.0 ? -1.0 : 1.0);
+
+	vec4 wpos = ubo.modelMatrix * vec4(pos, 1.0);
 	gl_Position = wpos;
 	outTex = inTex;
 	outWPos = gl_Position.xyz;
-	outWNormal = mat3(ubo.modelMatrix) * inNorm;
-	outWTan = mat3(ubo.modelMatrix) * inTan;
-	outWBitan = mat3(ubo.modelMatrix) * inBtan;
+	outWNormal = mat3(ubo.modelMatrix) * normal;
+	outWTan = mat3(ubo.modelMatrix) * tangent;
+	outWBitan = mat3(ubo.modelMatrix) * bitangent;
 }
@@ -0,0 +1,361 @@
+// Asset loading benchmark. Runs the AssetManager headless over three scenarios and writes the results as JSON:
+//   cold  - no cache, every asset is converted and the cache is written
+//   warm  - every asset is loaded from the cache written by the cold run
+//   stale - the cache of the cold run with a percentage of its entries invalidated, those are converted again
+// With -names it instead times the asset registry alone: requesting, loading and getting a number of generated asset
+// paths. The paths do not exist, their loads fail at once and only the path lookups are left.
+// The benchmark uses its own cache file, the cache of the application is left alone.
+// Paths are relative to the working directory, run it from the directory the application runs from.
+//
+// usage: cvct-bench [-j <threads>] [-n <runs>] [-stale <percent>] [-names <count>] [-cache <path>] [-o <json path>] [<scene path>]
+// On Linux, without Vulkan or a GPU:
+//   g++ -std=c++14 -O2 -pthread -Wno-multichar -Isource -Iexternal -Iexternal/glm -Iexternal/openddl -I<vulkan headers>
+//       cvct-bench.cpp source/AssetManager.cpp source/OpenGEX.cpp source/CompiledScene.cpp source/MeshOptimizer.cpp source/ImageLoader.cpp source/BlockCompression.cpp source/JobSystem.cpp
+//       source/ShaderConverter.cpp external/openddl/*.cpp -o cvct-bench
+
+#include "AssetManager.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#define BENCH_SCENE_PATH "Assets/sponza.ogex"
+#define BENCH_CACHE_PATH "assets/assets.bench.cache"
+
+static AssetManager* g_assetManager = NULL;	// Manager of the running scenario
+
+// Asset helper functions
+void LoadAssetStaticManager(char* path, uint32_t pathLenght)
+{
+	g_assetManager->LoadAsset(path, pathLenght);
+}
+
+enum BenchScenario
+{
+	BENCH_COLD,
+	BENCH_WARM,
+	BENCH_STALE,
+
+	BENCH_SCENARIO_COUNT
+};
+
+static const char* g_scenarioNames[BENCH_SCENARIO_COUNT] = { "cold", "warm", "stale" };
+
+struct BenchResult
+{
+	std::vector<float> assetTimes;		// per asset load time over all runs, in ms
+	std::vector<double> loadTimes;		// wall time of the load per run, in ms
+	double flushTime;					// summed over all runs, in ms
+	uint64_t bytesMapped;				// summed over all runs
+	uint64_t bytesCopied;				// summed over all runs
+	uint64_t peakArenaBytes;			// largest asset arena usage of a run
+	uint32_t workerCount;
+	uint32_t assetCount;
+	uint32_t convertedCount;
+	uint32_t cachedCount;
+	uint32_t failedCount;
+	uint32_t invalidatedCount;
+};
+
+static double Percentile(std::vector<double> values, double percentile)
+{
+	if (values.empty())
+		return 0.0;
+	// nearest rank
+	std::sort(values.begin(), values.end());
+	size_t rank = (size_t)(percentile * values.size() + 0.999999);
+	return values[rank ? rank - 1 : 0];
+}
+
+static double ToMiliseconds(const LARGE_INTEGER& start, const LARGE_INTEGER& end)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return 1000.0 * (end.QuadPart - start.QuadPart) / frequency.QuadPart;
+}
+
+enum NamesPhase
+{
+	NAMES_REQUEST,		// first request of every path, reserves and indexes its descriptor
+	NAMES_LOAD,			// LoadAsset of every requested path, found in the descriptor index
+	NAMES_GET,			// GetAsset of every path, the per frame lookup
+
+	NAMES_PHASE_COUNT
+};
+
+static const char* g_namesPhaseNames[NAMES_PHASE_COUNT] = { "request", "load", "get" };
+
+struct NamesResult
+{
+	std::vector<double> phaseTimes[NAMES_PHASE_COUNT];	// per run, in ns per path
+	uint32_t mismatchCount;								// lookups that did not find their path
+	uint32_t workerCount;
+};
+
+// Times the registry over generated paths, nothing is converted or cached
+static void RunNames(const std::vector<std::string>& names, const char* cachePath, uint32_t workerCount, NamesResult* result)
+{
+	AssetManager* manager = new AssetManager;
+	g_assetManager = manager;
+	manager->InitAssetManager(workerCount, cachePath);
+	result->workerCount = manager->m_jobSystem.GetWorkerCount();
+
+	LARGE_INTEGER start, end;
+	QueryPerformanceCounter(&start);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (manager->RequestAsset(names[i].c_str(), (uint32_t)names[i].size(), NULL) != 0)
+			result->mismatchCount++;
+	}
+	QueryPerformanceCounter(&end);
+	result->phaseTimes[NAMES_REQUEST].push_back(1e6 * ToMiliseconds(start, end) / names.size());
+	manager->m_jobSystem.Wait(&manager->m_pendingLoads);
+
+	// every path is requested, LoadAsset only looks it up
+	QueryPerformanceCounter(&start);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (manager->LoadAsset(names[i].c_str(), (uint32_t)names[i].size()) != -1)
+			result->mismatchCount++;
+	}
+	QueryPerformanceCounter(&end);
+	result->phaseTimes[NAMES_LOAD].push_back(1e6 * ToMiliseconds(start, end) / names.size());
+
+	// the files do not exist, a found descriptor reports the failed load
+	asset_s* asset;
+	QueryPerformanceCounter(&start);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (manager->GetAsset(names[i].c_str(), &asset) != -2)
+			result->mismatchCount++;
+	}
+	QueryPerformanceCounter(&end);
+	result->phaseTimes[NAMES_GET].push_back(1e6 * ToMiliseconds(start, end) / names.size());
+
+	if (manager->m_descriptorCount != names.size())
+		result->mismatchCount++;
+
+	delete manager;
+	g_assetManager = NULL;
+}
+
+static int32_t WriteNamesResults(const char* path, uint32_t nameCount, uint32_t runCount, const NamesResult* result)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return -1;
+
+	fprintf(file, "{\n\t\"names\": %u,\n\t\"workers\": %u,\n\t\"runs\": %u,\n\t\"mismatches\": %u,\n\t\"phases\": [", nameCount, result->workerCount, runCount, result->mismatchCount);
+	for (uint32_t p = 0; p < NAMES_PHASE_COUNT; p++)
+	{
+		fprintf(file, "%s\n\t\t{ \"name\": \"%s\", \"nsPerPath\": { \"p50\": %.2f, \"max\": %.2f } }", p ? "," : "", g_namesPhaseNames[p],
+			Percentile(result->phaseTimes[p], 0.5), Percentile(result->phaseTimes[p], 1.0));
+	}
+	fprintf(file, "\n\t]\n}\n");
+	fclose(file);
+
+	return 0;
+}
+
+static int RunNamesBenchmark(uint32_t nameCount, uint32_t runCount, uint32_t workerCount, const char* cachePath, const char* outPath)
+{
+	// spread over directories and extensions like the paths of a scene
+	static const char* extensions[] = { ".png", ".tga", ".tif", ".ogex", ".spv" };
+	std::vector<std::string> names(nameCount);
+	char buffer[128];
+	for (uint32_t i = 0; i < nameCount; i++)
+	{
+		snprintf(buffer, sizeof(buffer), "Assets/synthetic/set%02u/asset_%06u%s", i % 37, i, extensions[i % 5]);
+		names[i] = buffer;
+	}
+
+	NamesResult result = {};
+	for (uint32_t r = 0; r < runCount; r++)
+		RunNames(names, cachePath, workerCount, &result);
+
+	if (WriteNamesResults(outPath, nameCount, runCount, &result) != 0)
+	{
+		printf("Unable to write the results to %s\n", outPath);
+		return 2;
+	}
+	printf("Results written to %s\n", outPath);
+	for (uint32_t p = 0; p < NAMES_PHASE_COUNT; p++)
+		printf("  %-7s p50 %.1f ns per path over %u paths\n", g_namesPhaseNames[p], Percentile(result.phaseTimes[p], 0.5), nameCount);
+
+	return result.mismatchCount ? 3 : 0;
+}
+
+static void RunScenario(BenchScenario scenario, const char* scenePath, const char* cachePath, uint32_t workerCount, uint32_t stalePercent, BenchResult* result)
+{
+	if (scenario == BENCH_COLD)
+	{
+		char tmpPath[512];
+		snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cachePath);
+		remove(cachePath);
+		remove(tmpPath);
+	}
+
+	AssetManager* manager = new AssetManager;
+	g_assetManager = manager;
+	manager->InitAssetManager(workerCount, cachePath);
+	result->workerCount = manager->m_jobSystem.GetWorkerCount();
+
+	// spread the invalidated entries evenly over the cache, rounded up so a small cache still has one
+	if (scenario == BENCH_STALE && stalePercent && manager->m_mappedCacheEntryCount)
+	{
+		uint64_t entryCount = manager->m_mappedCacheEntryCount;
+		uint64_t staleCount = std::min(entryCount, std::max<uint64_t>(1, (entryCount * stalePercent + 99) / 100));
+		uint32_t invalidatedCount = 0;
+		for (uint64_t i = 0; i < staleCount; i++)
+		{
+			const char* name = manager->m_mappedCacheEntries[i * entryCount / staleCount]->name;
+			if (manager->InvalidateCacheEntry(name, (uint32_t)strlen(name)) == 0)
+				invalidatedCount++;
+		}
+		result->invalidatedCount += invalidatedCount;
+		printf("Invalidated %u of %llu cache entries\n", invalidatedCount, (unsigned long long)entryCount);
+	}
+
+	LARGE_INTEGER start, end;
+	QueryPerformanceCounter(&start);
+	manager->LoadAsset(scenePath, (uint32_t)strlen(scenePath));
+	QueryPerformanceCounter(&end);
+	result->loadTimes.push_back(ToMiliseconds(start, end));
+
+	result->assetCount = manager->m_descriptorCount;
+	for (uint32_t i = 0; i < manager->m_descriptorCount; i++)
+	{
+		const AssetDescriptor* desc = &manager->m_assetDescriptors[i];
+		result->assetTimes.push_back(desc->loadTime);
+		if (desc->loadResult == 1)
+			result->cachedCount++;
+		else if (desc->loadResult != 0 || !desc->asset.data)
+			result->failedCount++;
+		else
+			result->convertedCount++;
+	}
+
+	// asset arenas only grow during a run, their size at the end is the peak
+	uint64_t arenaBytes = 0;
+	for (uint32_t i = 0; i < manager->m_assetAllocatorCount; i++)
+		arenaBytes += GetVirtualMemoryAllocatedByteCount(ALLOCATOR_IDX_ASSET_DATA, manager->m_assetAllocators[i]);
+	if (arenaBytes > result->peakArenaBytes)
+		result->peakArenaBytes = arenaBytes;
+
+	// only the cold run writes the cache, the other scenarios have to start from the same one every run
+	if (scenario == BENCH_COLD)
+	{
+		QueryPerformanceCounter(&start);
+		manager->FlushAssets();
+		QueryPerformanceCounter(&end);
+		result->flushTime += ToMiliseconds(start, end);
+	}
+
+	result->bytesMapped += manager->m_bytesMapped;
+	result->bytesCopied += manager->m_bytesCopied;
+
+	delete manager;
+	g_assetManager = NULL;
+}
+
+static int32_t WriteResults(const char* path, const char* scenePath, uint32_t runCount, uint32_t stalePercent, const BenchResult* results)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return -1;
+
+	fprintf(file, "{\n\t\"scene\": \"%s\",\n\t\"workers\": %u,\n\t\"runs\": %u,\n\t\"stalePercent\": %u,\n\t\"scenarios\": [", scenePath, results[0].workerCount, runCount, stalePercent);
+	for (uint32_t s = 0; s < BENCH_SCENARIO_COUNT; s++)
+	{
+		const BenchResult* result = results + s;
+		std::vector<double> assetTimes(result->assetTimes.begin(), result->assetTimes.end());
+		fprintf(file, "%s\n\t\t{ \"name\": \"%s\", \"assets\": %u, \"converted\": %u, \"cached\": %u, \"failed\": %u, \"invalidated\": %u, "
+			"\"assetTimeMs\": { \"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f }, \"loadTimeMs\": { \"p50\": %.4f, \"p95\": %.4f }, \"flushTimeMs\": %.4f, "
+			"\"bytesMapped\": %llu, \"bytesCopied\": %llu, \"peakArenaBytes\": %llu }",
+			s ? "," : "", g_scenarioNames[s], result->assetCount, result->convertedCount / runCount, result->cachedCount / runCount, result->failedCount / runCount, result->invalidatedCount / runCount,
+			Percentile(assetTimes, 0.5), Percentile(assetTimes, 0.95), Percentile(assetTimes, 1.0),
+			Percentile(result->loadTimes, 0.5), Percentile(result->loadTimes, 0.95), result->flushTime / runCount,
+			(unsigned long long)(result->bytesMapped / runCount), (unsigned long long)(result->bytesCopied / runCount), (unsigned long long)result->peakArenaBytes);
+	}
+	fprintf(file, "\n\t]\n}\n");
+	fclose(file);
+
+	return 0;
+}
+
+static void PrintUsage()
+{
+	printf("usage: cvct-bench [-j <threads>] [-n <runs>] [-stale <percent>] [-names <count>] [-cache <path>] [-o <json path>] [<scene path>]\n");
+	printf("  -j <threads>      worker threads, 0 uses one per hardware thread (default 0)\n");
+	printf("  -n <runs>         runs per scenario (default 5)\n");
+	printf("  -stale <percent>  cache entries invalidated in the stale scenario (default 10)\n");
+	printf("  -names <count>    times the asset registry over <count> generated paths instead, e.g. 10000\n");
+	printf("  -cache <path>     cache file used by the benchmark (default " BENCH_CACHE_PATH ")\n");
+	printf("  -o <json path>    results file (default asset_benchmark.json)\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t workerCount = 0;
+	uint32_t runCount = 5;
+	uint32_t stalePercent = 10;
+	uint32_t nameCount = 0;
+	const char* cachePath = BENCH_CACHE_PATH;
+	const char* outPath = "asset_benchmark.json";
+	const char* scenePath = BENCH_SCENE_PATH;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			workerCount = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			runCount = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-stale") == 0 && i + 1 < argc)
+			stalePercent = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-names") == 0 && i + 1 < argc)
+			nameCount = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc)
+			cachePath = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			outPath = argv[++i];
+		else if (argv[i][0] != '-')
+			scenePath = argv[i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (runCount == 0 || stalePercent > 100)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (nameCount)
+		return RunNamesBenchmark(nameCount, runCount, workerCount, cachePath, outPath);
+
+	BenchResult results[BENCH_SCENARIO_COUNT] = {};
+	for (uint32_t r = 0; r < runCount; r++)
+	{
+		for (uint32_t s = 0; s < BENCH_SCENARIO_COUNT; s++)
+			RunScenario((BenchScenario)s, scenePath, cachePath, workerCount, stalePercent, results + s);
+	}
+
+	if (WriteResults(outPath, scenePath, runCount, stalePercent, results) != 0)
+	{
+		printf("Unable to write the results to %s\n", outPath);
+		return 2;
+	}
+	printf("Results written to %s\n", outPath);
+	for (uint32_t s = 0; s < BENCH_SCENARIO_COUNT; s++)
+		printf("  %-6s load p50 %.02f ms, %u assets, %u failed\n", g_scenarioNames[s], Percentile(results[s].loadTimes, 0.5), results[s].assetCount, results[s].failedCount / runCount);
+
+	for (uint32_t s = 0; s < BENCH_SCENARIO_COUNT; s++)
+	{
+		if (results[s].failedCount)
+			return 3;
+	}
+	return 0;
+}
@@ -0,0 +1,108 @@
+// Offline asset cooker. Loads the given assets headless, without a window or Vulkan device,
+// and writes the asset cache the application maps at startup. Cooking a .ogex scene imports it into its .cvscene.
+// Paths are relative to the working directory, run it from the directory the application runs from.
+//
+// usage: cvct-cook [-j <threads>] [-compact] <asset path> [<asset path> ...]
+
+#include "AssetManager.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+AssetManager m_assetManager;	// Asset manager
+
+// Asset helper functions
+void LoadAssetStaticManager(char* path, uint32_t pathLenght)
+{
+	m_assetManager.LoadAsset(path, pathLenght);
+}
+
+static void PrintUsage()
+{
+	printf("usage: cvct-cook [-j <threads>] [-compact] <asset path> [<asset path> ...]\n");
+	printf("  -j <threads>  worker threads used for the conversion, 0 uses one per hardware thread\n");
+	printf("  -compact      rewrites the cache with only the live entries instead of appending to it\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t workerCount = 0;
+	uint32_t compact = 0;
+	int firstPath = argc;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			workerCount = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-compact") == 0)
+			compact = 1;
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			firstPath = i;
+			break;
+		}
+	}
+	if (firstPath == argc)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceFrequency(&frequency);
+	double tickToMiliseconds = 1000.0 / frequency.QuadPart;
+	QueryPerformanceCounter(&start);
+
+	m_assetManager.InitAssetManager(workerCount);
+	for (int i = firstPath; i < argc; i++)
+		m_assetManager.LoadAsset(argv[i], (uint32_t)strlen(argv[i]));
+
+	QueryPerformanceCounter(&end);
+	double loadTime = tickToMiliseconds * (end.QuadPart - start.QuadPart);
+
+	// Per asset stats, the time is the whole load job of the asset without its dependencies
+	uint32_t convertedCount = 0, cachedCount = 0, failedCount = 0;
+	double convertTime = 0.0;
+	printf("%-10s %-12s %-14s %s\n", "result", "time (ms)", "size (bytes)", "asset");
+	for (uint32_t i = 0; i < m_assetManager.m_descriptorCount; i++)
+	{
+		const AssetDescriptor* desc = &m_assetManager.m_assetDescriptors[i];
+		const char* result = "converted";
+		if (desc->loadResult == 1)
+		{
+			result = "cached";
+			cachedCount++;
+		}
+		else if (desc->loadResult != 0 || !desc->asset.data)
+		{
+			result = "failed";
+			failedCount++;
+		}
+		else
+		{
+			convertedCount++;
+			convertTime += desc->loadTime;
+		}
+		printf("%-10s %12.02f %14llu %s\n", result, desc->loadTime, (unsigned long long)desc->asset.size, desc->name);
+	}
+
+	QueryPerformanceCounter(&start);
+	int32_t ret = compact ? m_assetManager.CompactAssets() : m_assetManager.FlushAssets();
+	QueryPerformanceCounter(&end);
+	double writeTime = tickToMiliseconds * (end.QuadPart - start.QuadPart);
+
+	printf("\n%u assets: %u converted, %u from cache, %u failed\n", m_assetManager.m_descriptorCount, convertedCount, cachedCount, failedCount);
+	printf("Loading took %.02f ms (%.02f ms converting), writing the cache took %.02f ms\n", loadTime, convertTime, writeTime);
+
+	if (ret != 0)
+	{
+		printf("Writing the asset cache failed with code %i\n", ret);
+		return 2;
+	}
+	return failedCount ? 3 : 0;
+}
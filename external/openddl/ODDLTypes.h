@@ -66,8 +66,17 @@ namespace ODDL
 	typedef int						int32;
 	typedef unsigned int			unsigned_int32;
 
-	typedef __int64					int64;
-	typedef unsigned __int64		unsigned_int64;
+	#if defined(_MSC_VER)
+
+		typedef __int64				int64;
+		typedef unsigned __int64	unsigned_int64;
+
+	#else
+
+		typedef long long			int64;
+		typedef unsigned long long	unsigned_int64;
+
+	#endif
 
 	#if defined(_WIN64)
 
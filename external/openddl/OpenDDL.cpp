@@ -43,8 +43,28 @@
 	POSSIBILITY OF SUCH DAMAGE.
 */
 
+/*
+	This file has been modified from its original form: decimal float and integer
+	literals are read by a fast path that scans digits 16 at a time, the original
+	parsing code handles every other literal.
+*/
+
 
 #include "OpenDDL.h"
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+
+	#include <emmintrin.h>
+	#define ODDL_SSE2 1
+
+#endif
+
+#if defined(_MSC_VER)
+
+	#include <intrin.h>
+
+#endif
 
 
 using namespace ODDL;
@@ -75,6 +95,156 @@ namespace ODDL
 		};
 
 
+		// Powers of ten that are exact in a double and a float
+		const double exactPowerOfTen[23] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		const float exactFloatPowerOfTen[11] =
+		{
+			1e0F, 1e1F, 1e2F, 1e3F, 1e4F, 1e5F, 1e6F, 1e7F, 1e8F, 1e9F, 1e10F
+		};
+
+		const unsigned_int64 exactPowerOfTenInteger[9] =
+		{
+			1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL
+		};
+
+		inline int32 GetTrailingZeroCount(unsigned_int32 x)
+		{
+			#if defined(_MSC_VER)
+
+				unsigned long index;
+				_BitScanForward(&index, x);
+				return ((int32) index);
+
+			#else
+
+				return (__builtin_ctz(x));
+
+			#endif
+		}
+
+		// True when count bytes can be loaded from the text without touching the next page
+		inline bool IsLoadInsidePage(const unsigned_int8 *byte, int32 count)
+		{
+			return ((reinterpret_cast<unsigned_machine>(byte) & 4095) <= (unsigned_machine) (4096 - count));
+		}
+
+		#if ODDL_SSE2
+
+			// One bit for each of the 16 bytes that is not a decimal digit
+			inline unsigned_int32 GetNonDigitMask(const unsigned_int8 *byte)
+			{
+				__m128i x = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(byte)), _mm_set1_epi8('0'));
+				__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(-1)), _mm_cmplt_epi8(x, _mm_set1_epi8(10)));
+				return (~(unsigned_int32) _mm_movemask_epi8(digit) & 0xFFFF);
+			}
+
+		#endif
+
+		// Length of the run of decimal digits at the start of the text
+		inline int32 GetDigitCount(const unsigned_int8 *byte)
+		{
+			int32 count = 0;
+
+			#if ODDL_SSE2
+
+				// The text is zero terminated, so 16 bytes can be loaded as long as they do not cross into the next page
+				while (IsLoadInsidePage(byte + count, 16))
+				{
+					int32 n = GetTrailingZeroCount(GetNonDigitMask(byte + count) | 0x10000);
+					count += n;
+					if (n < 16)
+					{
+						return (count);
+					}
+				}
+
+			#endif
+
+			while ((unsigned_int32) (byte[count] - '0') < 10U)
+			{
+				count++;
+			}
+
+			return (count);
+		}
+
+		// Value of eight decimal digits, converted in parallel inside one 64-bit word.
+		// Fewer digits are shifted in behind leading zeros, the bytes after them are loaded but ignored
+		inline unsigned_int32 ReadEightDigits(const unsigned_int8 *byte, int32 count = 8)
+		{
+			unsigned_int64 v;
+			memcpy(&v, byte, 8);
+			v = (v - 0x3030303030303030ULL) << ((8 - count) * 8);
+			v = (v * 10) + (v >> 8);
+			v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) + (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+			return ((unsigned_int32) v);
+		}
+
+		// Appends count digits to the value, the caller keeps the result within 19 digits
+		inline unsigned_int64 ReadDigits(const unsigned_int8 *byte, int32 count, unsigned_int64 v)
+		{
+			for (; count >= 8; count -= 8)
+			{
+				v = v * 100000000ULL + ReadEightDigits(byte);
+				byte += 8;
+			}
+
+			if (count != 0)
+			{
+				if (IsLoadInsidePage(byte, 8))
+				{
+					return (v * exactPowerOfTenInteger[count] + ReadEightDigits(byte, count));
+				}
+
+				for (; count > 0; count--)
+				{
+					v = v * 10 + (byte[0] - '0');
+					byte++;
+				}
+			}
+
+			return (v);
+		}
+
+		// Correctly rounded float of mantissa * 10^exponent, false when it cannot be computed exactly in a double
+		inline bool MakeFloat(unsigned_int64 mantissa, int32 exponent, float *value)
+		{
+			// Both the mantissa and the power of ten are exact, so one operation rounds the result correctly.
+			// Up to 7 significant digits the float operation does, which covers most vertex data
+			if ((mantissa <= (1ULL << 24)) && (exponent >= -10) && (exponent <= 10))
+			{
+				*value = (exponent < 0) ? (float) (int32) mantissa / exactFloatPowerOfTen[-exponent] : (float) (int32) mantissa * exactFloatPowerOfTen[exponent];
+				return (true);
+			}
+
+			double v = 0.0;
+			if (mantissa != 0)
+			{
+				if ((mantissa > (1ULL << 53)) || (exponent < -22) || (exponent > 22))
+				{
+					return (false);
+				}
+
+				v = (exponent < 0) ? (double) (int64) mantissa / exactPowerOfTen[-exponent] : (double) (int64) mantissa * exactPowerOfTen[exponent];
+
+				// A double exactly halfway between two floats would be rounded twice
+				unsigned_int64 bits;
+				memcpy(&bits, &v, 8);
+				if ((bits & 0x1FFFFFFFULL) == 0x10000000ULL)
+				{
+					return (false);
+				}
+			}
+
+			*value = (float) v;
+			return (true);
+		}
+
 		int32 ReadEscapeChar(const char *text, unsigned_int32 *value);
 		int32 ReadStringEscapeChar(const char *text, int32 *stringLength, char *restrict string);
 		DataResult ReadCharLiteral(const char *text, int32 *textLength, unsigned_int64 *value);
@@ -82,6 +252,7 @@ namespace ODDL
 		DataResult ReadHexadecimalLiteral(const char *text, int32 *textLength, unsigned_int64 *value);
 		DataResult ReadOctalLiteral(const char *text, int32 *textLength, unsigned_int64 *value);
 		DataResult ReadBinaryLiteral(const char *text, int32 *textLength, unsigned_int64 *value);
+		bool ReadFastFloatMagnitude(const char *text, int32 *textLength, float *value);
 		bool ParseSign(const char *& text);
 	}
 }
@@ -606,6 +777,15 @@ DataResult Data::ReadDecimalLiteral(const char *text, int32 *textLength, unsigne
 {
 	const unsigned_int8 *byte = reinterpret_cast<const unsigned_int8 *>(text);
 
+	// Fast path for literals without separators that cannot overflow
+	int32 count = GetDigitCount(byte);
+	if ((count != 0) && (count <= 19) && (byte[count] != '_'))
+	{
+		*value = ReadDigits(byte, count, 0);
+		*textLength = count;
+		return (kDataOkay);
+	}
+
 	unsigned_int64 v = 0;
 	bool separator = false;
 	for (;;)
@@ -1296,6 +1476,135 @@ DataResult Data::ReadFloatMagnitude(const char *text, int32 *textLength, float *
 	return (kDataOkay);
 }
 
+bool Data::ReadFastFloatMagnitude(const char *text, int32 *textLength, float *value)
+{
+	// Plain decimal literals with up to 19 significant digits and a small exponent are converted exactly,
+	// false leaves every other literal to ReadFloatMagnitude()
+	const unsigned_int8 *byte = reinterpret_cast<const unsigned_int8 *>(text);
+
+	#if ODDL_SSE2
+
+		// Common case, the whole literal is found with one 16 byte compare: at most 8 digits, a point and at most 8 digits
+		if (IsLoadInsidePage(byte, 32))
+		{
+			unsigned_int32 nonDigit = GetNonDigitMask(byte) | 0xFFFF0000;
+			int32 integerCount = GetTrailingZeroCount(nonDigit);
+			int32 fractionCount = 0;
+			int32 length = integerCount;
+			if (byte[integerCount] == '.')
+			{
+				fractionCount = GetTrailingZeroCount(nonDigit >> (integerCount + 1));
+				length += fractionCount + 1;
+				if (fractionCount == 0)
+				{
+					return (false);
+				}
+			}
+
+			unsigned_int32 c = byte[length] | 0x20;
+			if ((length < 16) && (integerCount - 1U < 8U) && (fractionCount <= 8) && (c != ('_' | 0x20)) && (c != 'e') && (c != 'x') && (c != 'o') && (c != 'b'))
+			{
+				unsigned_int64 mantissa = ReadEightDigits(byte, integerCount);
+				if (fractionCount != 0)
+				{
+					mantissa = mantissa * exactPowerOfTenInteger[fractionCount] + ReadEightDigits(byte + integerCount + 1, fractionCount);
+				}
+
+				if (MakeFloat(mantissa, -fractionCount, value))
+				{
+					*textLength = length;
+					return (true);
+				}
+			}
+		}
+
+	#endif
+
+	const unsigned_int8 *integer = byte;
+	int32 integerCount = GetDigitCount(integer);
+	if (integerCount == 0)
+	{
+		return (false);
+	}
+
+	byte += integerCount;
+	unsigned_int32 c = byte[0];
+	if ((c == '_') || ((integerCount == 1) && (integer[0] == '0') && ((c | 0x20) == 'x' || (c | 0x20) == 'o' || (c | 0x20) == 'b')))
+	{
+		return (false);
+	}
+
+	const unsigned_int8 *fraction = byte;
+	int32 fractionCount = 0;
+	if (c == '.')
+	{
+		fraction = ++byte;
+		fractionCount = GetDigitCount(fraction);
+		if (fractionCount == 0)
+		{
+			return (false);
+		}
+
+		byte += fractionCount;
+		c = byte[0];
+		if (c == '_')
+		{
+			return (false);
+		}
+	}
+
+	int32 exponent = 0;
+	if ((c | 0x20) == 'e')
+	{
+		c = (++byte)[0];
+		bool negative = (c == '-');
+		if ((c == '-') || (c == '+'))
+		{
+			byte++;
+		}
+
+		int32 exponentCount = GetDigitCount(byte);
+		if ((exponentCount == 0) || (exponentCount > 4) || (byte[exponentCount] == '_'))
+		{
+			return (false);
+		}
+
+		exponent = (int32) ReadDigits(byte, exponentCount, 0);
+		if (negative)
+		{
+			exponent = -exponent;
+		}
+
+		byte += exponentCount;
+	}
+
+	exponent -= fractionCount;
+
+	// Leading zeros are not significant
+	while ((integerCount != 0) && (integer[0] == '0'))
+	{
+		integer++;
+		integerCount--;
+	}
+
+	if (integerCount == 0)
+	{
+		while ((fractionCount != 0) && (fraction[0] == '0'))
+		{
+			fraction++;
+			fractionCount--;
+		}
+	}
+
+	if ((integerCount + fractionCount > 19) || (!MakeFloat(ReadDigits(fraction, fractionCount, ReadDigits(integer, integerCount, 0)), exponent, value)))
+	{
+		return (false);
+	}
+
+	*textLength = (int32) (reinterpret_cast<const char *>(byte) - text);
+	return (true);
+}
+
 DataResult Data::ReadFloatMagnitude(const char *text, int32 *textLength, double *value)
 {
 	const unsigned_int8 *byte = reinterpret_cast<const unsigned_int8 *>(text);
@@ -1827,10 +2136,13 @@ DataResult FloatDataType::ParseValue(const char *& text, PrimType *value)
 
 	bool negative = Data::ParseSign(text);
 
-	DataResult result = Data::ReadFloatMagnitude(text, &length, &floatValue);
-	if (result != kDataOkay)
+	if (!Data::ReadFastFloatMagnitude(text, &length, &floatValue))
 	{
-		return (result);
+		DataResult result = Data::ReadFloatMagnitude(text, &length, &floatValue);
+		if (result != kDataOkay)
+		{
+			return (result);
+		}
 	}
 
 	if (negative)
@@ -1,7 +1,201 @@
 #include "AssetManager.h"
+#include "MurmurHash.h"
 #include "io.h"
 
 #include <stdio.h>
+#include <algorithm>
+#include <unordered_map>
+
+// load job the calling thread is converting, dependencies requested by the converter are recorded on it
+static thread_local AssetLoadJob* t_currentLoad = NULL;
+
+AssetKey MakeAssetKey(const char* path, uint32_t pathLength)
+{
+	AssetKey key;
+	MurmurHash3_x64_128(path, (int)pathLength, ASSETINDEX_SEED, key.hash);
+	return key;
+}
+
+uint64_t HashAssetContent(const void* data, uint64_t dataSizeInBytes)
+{
+	// Hash in chunks, MurmurHash takes an int length. Each chunk seeds the next one
+	const uint64_t chunkSize = 0x40000000;
+	const uint8_t* ptr = (const uint8_t*)data;
+	uint64_t out[2] = { ASSETCONTENT_SEED, 0 };
+	do
+	{
+		uint64_t size = dataSizeInBytes < chunkSize ? dataSizeInBytes : chunkSize;
+		MurmurHash3_x64_128(ptr, (int)size, (uint32_t)(out[0] ^ out[1]), out);
+		ptr += size;
+		dataSizeInBytes -= size;
+	} while (dataSizeInBytes);
+	return out[0];
+}
+
+uint64_t GetConvertedFileTimestamp()
+{
+	return t_currentLoad ? t_currentLoad->timestamp : 0;
+}
+
+// Key of converted asset data in the content index
+static AssetKey MakeContentKey(uint64_t assetHash)
+{
+	AssetKey key;
+	key.hash[0] = assetHash;
+	key.hash[1] = assetHash;
+	return key;
+}
+
+static bool SameAssetKey(const AssetKey& a, const AssetKey& b)
+{
+	return a.hash[0] == b.hash[0] && a.hash[1] == b.hash[1];
+}
+
+void AssetIndex::Init(uint32_t slots)
+{
+	assert((slots & (slots - 1)) == 0);	// Slot count has to be a power of two
+	entries = (AssetIndexEntry*)malloc(slots * sizeof(AssetIndexEntry));
+	slotCount = slots;
+	Clear();
+}
+
+void AssetIndex::Destroy()
+{
+	free(entries);
+	entries = NULL;
+	slotCount = 0;
+	usedCount = 0;
+}
+
+void AssetIndex::Clear()
+{
+	memset(entries, 0xFF, slotCount * sizeof(AssetIndexEntry));
+	usedCount = 0;
+}
+
+void AssetIndex::Insert(const AssetKey& key, uint32_t index)
+{
+	// Keep the load factor under 0.5, so probe sequences stay short
+	if ((usedCount + 1) * 2 > slotCount)
+	{
+		AssetIndexEntry* oldEntries = entries;
+		uint32_t oldSlotCount = slotCount;
+
+		Init(oldSlotCount * 2);
+		for (uint32_t i = 0; i < oldSlotCount; i++)
+		{
+			if (oldEntries[i].index == ASSETINDEX_EMPTY)
+				continue;
+
+			uint32_t slot = (uint32_t)oldEntries[i].key.hash[1] & (slotCount - 1);
+			while (entries[slot].index != ASSETINDEX_EMPTY)
+				slot = (slot + 1) & (slotCount - 1);
+			entries[slot] = oldEntries[i];
+			usedCount++;
+		}
+		free(oldEntries);
+	}
+
+	uint32_t slot = (uint32_t)key.hash[1] & (slotCount - 1);
+	while (entries[slot].index != ASSETINDEX_EMPTY)
+	{
+		if (SameAssetKey(entries[slot].key, key))
+		{
+			entries[slot].index = index;	// Already in the table; point it to the newest entry
+			return;
+		}
+		slot = (slot + 1) & (slotCount - 1);
+	}
+
+	entries[slot].key = key;
+	entries[slot].index = index;
+	usedCount++;
+}
+
+void AssetIndex::Remove(const AssetKey& key)
+{
+	uint32_t slot = (uint32_t)key.hash[1] & (slotCount - 1);
+	while (entries[slot].index != ASSETINDEX_EMPTY && !SameAssetKey(entries[slot].key, key))
+		slot = (slot + 1) & (slotCount - 1);
+	if (entries[slot].index == ASSETINDEX_EMPTY)
+		return;
+
+	// shift the rest of the probe sequence back into the hole, so lookups never need tombstones
+	uint32_t hole = slot;
+	for (;;)
+	{
+		slot = (slot + 1) & (slotCount - 1);
+		if (entries[slot].index == ASSETINDEX_EMPTY)
+			break;
+		uint32_t home = (uint32_t)entries[slot].key.hash[1] & (slotCount - 1);
+		if (((slot - home) & (slotCount - 1)) >= ((slot - hole) & (slotCount - 1)))
+		{
+			entries[hole] = entries[slot];
+			hole = slot;
+		}
+	}
+	memset(entries + hole, 0xFF, sizeof(AssetIndexEntry));
+	usedCount--;
+}
+
+uint32_t AssetIndex::Find(const AssetKey& key) const
+{
+	uint32_t slot = (uint32_t)key.hash[1] & (slotCount - 1);
+	while (entries[slot].index != ASSETINDEX_EMPTY)
+	{
+		if (SameAssetKey(entries[slot].key, key))
+			return entries[slot].index;
+		slot = (slot + 1) & (slotCount - 1);
+	}
+	return ASSETINDEX_EMPTY;
+}
+
+// Translates a pointer into the mapped journal, or into memory allocated this session, to a file offset.
+// The journal is only appended to, so offsets into earlier segments stay valid.
+static uint64_t BlobFileOffset(const void* ptr, const uint8_t* mappedStart, uint64_t mappedSize, const uint8_t* allocatedStart, uint64_t allocatedFileStart)
+{
+	const uint8_t* p = (const uint8_t*)ptr;
+	if (mappedStart && p >= mappedStart && p < mappedStart + mappedSize)
+		return p - mappedStart;
+
+	assert(p >= allocatedStart);
+	return allocatedFileStart + (p - allocatedStart);
+}
+
+static uint64_t AlignCacheOffset(uint64_t offset)
+{
+	return (offset + (ASSETCACHE_ALIGNMENT - 1)) & ~(uint64_t)(ASSETCACHE_ALIGNMENT - 1);
+}
+
+static void WriteCachePadding(FILE* file, uint64_t from, uint64_t to)
+{
+	static const uint8_t zero[ASSETCACHE_ALIGNMENT] = {};
+	if (to > from)
+		fwrite(zero, 1, (size_t)(to - from), file);
+}
+
+// Byte length of the zero terminated dependency strings of an entry
+static uint64_t DependencyBlobLength(const CacheEntry* entry)
+{
+	const char* start = entry->dependenciesStart;
+	const char* str = start;
+	for (uint32_t i = 0; i < entry->dependencyCount; i++)
+		str += strlen(str) + 1;
+	return str - start;
+}
+
+// Copies everything but the relative pointers, the caller re-bases those to where the copy is written
+static void CopyCacheEntryFields(CacheEntry* out, const CacheEntry* entry)
+{
+	memcpy(out->name, entry->name, sizeof(out->name));
+	out->timestamp = entry->timestamp;
+	out->contentHash = entry->contentHash;
+	out->contentLength = entry->contentLength;
+	out->assetHash = entry->assetHash;
+	out->dependencyCount = entry->dependencyCount;
+	out->asset.type = entry->asset.type;
+	out->asset.size = entry->asset.size;
+}
 
 AssetManager::AssetManager()
 {
@@ -12,25 +206,70 @@ AssetManager::AssetManager()
 		{ ".tga",  ConvertAsset_Image },
 		{ ".tif",  ConvertAsset_Image },
 		{ ".spv",  ConvertAsset_SPIRV },
-		{ ".ogex", ConvertAsset_OpenGEX}
+		{ ".ogex", ConvertAsset_OpenGEX },
+		{ ".cvscene", ConvertAsset_CompiledScene }
 	};
-	memset(m_conversionStack, 0, sizeof(m_conversionStack));			//set the conversion stack to 0
 	memcpy(m_converterMap, cm, sizeof(ConverterMap) * CONVERTERNUM);	//assign the conversionmap
 	m_descriptorCount = 0;
-	m_conversionDepth = 0;
+	m_assetAllocatorCount = 0;
+	m_pendingLoads = 0;
 	m_cacheEntryCount = 0;
 	m_modifcationCount = 0;
+	m_flushed = 0;
+	m_cacheFileMapped = 0;
+	m_mappedCacheStart = NULL;
+	m_mappedCacheSize = 0;
+	m_mappedSegmentCount = 0;
+	m_mappedCacheEntries = NULL;
+	m_mappedCacheEntryCount = 0;
+	m_assetDescriptorAllocator = NULL;
+	m_cacheEntryAllocator = NULL;
+	m_dependencyAllocator = NULL;
+	m_bytesMapped = 0;
+	m_bytesCopied = 0;
+	strcpy_s(m_cachePath, sizeof(m_cachePath), ASSETCACHE_PATH);
+	m_descriptorIndex.Init(ASSETINDEX_INITIAL_SLOTS);
+	m_cacheEntryIndex.Init(ASSETINDEX_INITIAL_SLOTS);
+	m_assetContentIndex.Init(ASSETINDEX_INITIAL_SLOTS);
 }
 
 AssetManager::~AssetManager()
 {
+	//the job system could still be converting into the allocators
+	m_jobSystem.Shutdown();
+
+	if (m_cacheFileMapped)
+		readonly_mapped_file_close(&m_cacheFile);
+	free(m_mappedCacheEntries);
+	m_descriptorIndex.Destroy();
+	m_cacheEntryIndex.Destroy();
+	m_assetContentIndex.Destroy();
+
+	for (uint32_t i = 0; i < m_assetAllocatorCount; i++)
+		DestroyVirtualMemoryAllocator(ALLOCATOR_IDX_ASSET_DATA, m_assetAllocators[i]);
+	if (m_assetDescriptorAllocator)
+		DestroyVirtualMemoryAllocator(ALLOCATOR_IDX_ASSET_DESC, m_assetDescriptorAllocator);
+	if (m_cacheEntryAllocator)
+		DestroyVirtualMemoryAllocator(ALLOCATOR_IDX_CACHE_ENTRY, m_cacheEntryAllocator);
+	if (m_dependencyAllocator)
+		DestroyVirtualMemoryAllocator(ALLOCATOR_IDX_DEPENDENCIES, m_dependencyAllocator);
 }
 
-int32_t AssetManager::InitAssetManager()
+int32_t AssetManager::InitAssetManager(uint32_t workerCount, const char* cachePath)
 {
+	strcpy_s(m_cachePath, sizeof(m_cachePath), cachePath);
+	SetVirtualMemoryName(ALLOCATOR_IDX_ASSET_DATA, "asset data");
+	SetVirtualMemoryName(ALLOCATOR_IDX_ASSET_DESC, "asset descriptors");
+	SetVirtualMemoryName(ALLOCATOR_IDX_CACHE_ENTRY, "cache entries");
+	SetVirtualMemoryName(ALLOCATOR_IDX_DEPENDENCIES, "dependencies");
+	SetVirtualMemoryName(ALLOCATOR_IDX_TEMP, "temp");
+
 	//TODO::Scale the allocated memory accordingly
 	//create all the allocators
-	m_assetAllocator = CreateVirtualMemoryAllocator(ALLOCATOR_IDX_ASSET_DATA, 0xFFFFFFFF);
+	m_jobSystem.Init(workerCount);
+	m_assetAllocatorCount = m_jobSystem.GetWorkerCount();
+	for (uint32_t i = 0; i < m_assetAllocatorCount; i++)
+		m_assetAllocators[i] = CreateVirtualMemoryAllocator(ALLOCATOR_IDX_ASSET_DATA, ASSETARENA_SIZE);
 	m_assetDescriptorAllocator = CreateVirtualMemoryAllocator(ALLOCATOR_IDX_ASSET_DESC, 0xFFFFFFFF);
 	m_cacheEntryAllocator = CreateVirtualMemoryAllocator(ALLOCATOR_IDX_CACHE_ENTRY, 0xFFFFFFFF);
 	m_dependencyAllocator = CreateVirtualMemoryAllocator(ALLOCATOR_IDX_DEPENDENCIES, 0xFFFFFFFF);
@@ -38,13 +277,12 @@ int32_t AssetManager::InitAssetManager()
 	//allocate memory
 	m_cacheEntries = (CacheEntry*)GetVirtualMemoryStart(ALLOCATOR_IDX_CACHE_ENTRY,m_cacheEntryAllocator);
 	//m_cacheEntries = (CacheEntry*)AllocateVirtualMemory(ALLOCATOR_IDX_CACHE_ENTRY, m_cacheEntryAllocator, 0xFFFFFFFF);
-	m_assetDescriptors = (AssetDescriptor*)AllocateVirtualMemory(ALLOCATOR_IDX_ASSET_DESC, m_assetDescriptorAllocator, 0xFFFFFFFF);
+	m_assetDescriptors = (AssetDescriptor*)GetVirtualMemoryStart(ALLOCATOR_IDX_ASSET_DESC, m_assetDescriptorAllocator);	//grows per descriptor, commits as it grows
 
 	//load asset cache here
 #define LOADCACHE
 #ifdef LOADCACHE
-	MappedFile file;
-	if(readonly_mapped_file_open(&file,"assets/assets.cache") == 0)		//loads the file, and puts it in memory
+	if(readonly_mapped_file_open(&m_cacheFile, m_cachePath, MAPPED_FILE_RANDOM) == 0)		//maps the file, data is used in place
 	{
 		printf("Loading asset cache: \n");
 		LARGE_INTEGER start, end;
@@ -55,32 +293,49 @@ int32_t AssetManager::InitAssetManager()
 
 		AssetCacheHeader* header = nullptr;
 		uint64_t fileSize;
-		uint32_t result = readonly_mapped_file_get_data(&file, (void**)&header, &fileSize);
-		if (result == 0 && header->magicNumber ==  'RAC0')
+		uint32_t result = readonly_mapped_file_get_data(&m_cacheFile, (void**)&header, &fileSize);
+		if (result == 0 && header->magicNumber == ASSETCACHE_MAGIC)
 		{
-			assert(fileSize == (sizeof(*header) + (header->entryCount * sizeof(CacheEntry) + header->assetBlobSize + header->dependencyBlobSize)));
-			void* assetData = AllocateVirtualMemory(ALLOCATOR_IDX_ASSET_DATA, m_assetAllocator, header->assetBlobSize);
-			char* dependencyData = (char*)AllocateVirtualMemory(ALLOCATOR_IDX_DEPENDENCIES, m_dependencyAllocator, header->dependencyBlobSize);
-			void* m_cacheEntries = AllocateVirtualMemory(ALLOCATOR_IDX_CACHE_ENTRY, m_cacheEntryAllocator, header->entryCount * sizeof(CacheEntry));
-			m_cacheEntryCount = header->entryCount;
-
-			const CacheEntry* srcEntries = (const CacheEntry*)(header + 1);
-			const char* srcData = (const char*)(srcEntries + header->entryCount);	//offset depending on the number of entrycounts
-			const char* scrDeps = (const char*)(srcData + header->assetBlobSize);	//offset depending on the assetblob size in bytes
+			assert(fileSize >= header->committedSize);	//anything behind the committed size is an unfinished append and ignored
+			m_cacheFileMapped = 1;
+			m_mappedCacheStart = (const uint8_t*)header;
+			m_mappedCacheSize = header->committedSize;
+			m_bytesMapped += fileSize;
+			m_mappedSegmentCount = header->segmentCount;
+			m_mappedCacheEntries = (const CacheEntry**)malloc((header->entryCount + 1) * sizeof(CacheEntry*));
+
+			//walk the segments, they are stored back to back
+			uint64_t segmentOffset = AlignCacheOffset(sizeof(AssetCacheHeader));
+			for (uint32_t s = 0; s < header->segmentCount; s++)
+			{
+				const AssetCacheSegment* segment = (const AssetCacheSegment*)(m_mappedCacheStart + segmentOffset);
+				const CacheEntry* entries = (const CacheEntry*)(segment + 1);
+				for (uint64_t i = 0; i < segment->entryCount; i++)
+					m_mappedCacheEntries[m_mappedCacheEntryCount++] = entries + i;
+				segmentOffset += segment->segmentSize;
+			}
+			assert(segmentOffset == header->committedSize && m_mappedCacheEntryCount == header->entryCount);
+			m_cacheEntryCount = m_mappedCacheEntryCount;
 
-			memcpy(m_cacheEntries, srcEntries, header->entryCount * sizeof(CacheEntry));
-			memcpy(assetData, srcData, header->assetBlobSize);
-			memcpy(dependencyData, scrDeps, header->dependencyBlobSize);
+			//index the cache entries, later entries of the same path supersede earlier ones
+			for (uint32_t i = 0; i < m_cacheEntryCount; i++)
+			{
+				m_cacheEntryIndex.Insert(MakeAssetKey(m_mappedCacheEntries[i]->name, (uint32_t)strlen(m_mappedCacheEntries[i]->name)), i);
+				m_assetContentIndex.Insert(MakeContentKey(m_mappedCacheEntries[i]->assetHash), i);
+			}
 
 			QueryPerformanceCounter(&end);
 			printf("Loading asset cache took %.02f ms\n\n", tickToMiliseconds * (end.QuadPart - start.QuadPart));
 		}
-
-		readonly_mapped_file_close(&file);
+		else
+		{
+			printf("Asset cache is outdated, magic number not consistant \n");
+			readonly_mapped_file_close(&m_cacheFile);
+		}
 	}
 	else
 	{
-		printf("No cache available, magic number not consistant \n");
+		printf("No cache available \n");
 	}
 #endif
 
@@ -89,75 +344,158 @@ int32_t AssetManager::InitAssetManager()
 
 int32_t AssetManager::LoadAsset(const char* path, uint32_t pathLength)
 {
-	//TODO: this early out wont work
-	for (uint32_t i = 0; i < m_descriptorCount; i++)
+	//called by a converter, record the dependency and let the job system load it
+	if (t_currentLoad)
+		return RequestAsset(path, pathLength, t_currentLoad);
+
+	int32_t ret = RequestAsset(path, pathLength, NULL);
+	if (ret != 0)
+		return ret;		//already loaded
+
+	LARGE_INTEGER start, end;
+	double tickToMiliseconds;
+	QueryPerformanceFrequency(&start);
+	tickToMiliseconds = 1000.0 / start.QuadPart;
+	QueryPerformanceCounter(&start);
+
+	m_jobSystem.Wait(&m_pendingLoads);	//helps converting until every dependency is loaded
+
+	QueryPerformanceCounter(&end);
+	printf("Loading %s took %.02f ms on %u workers\n\n", path, tickToMiliseconds * (end.QuadPart - start.QuadPart), m_jobSystem.GetWorkerCount());
+
+	asset_s* asset;
+	if (GetAsset(path, &asset) != 0)
+		return -7;	// Conversion failed
+	return 0;
+}
+
+int32_t AssetManager::RequestAsset(const char* path, uint32_t pathLength, AssetLoadJob* parent)
+{
+	assert(!m_flushed);		//the workers are stopped and the mapped cache is released
+	assert(pathLength < sizeof(CacheEntry::name));
+
+	//set the dependency of the file, the parent is only touched by the thread converting it
+	if (parent)
 	{
-		if(strcmp((const char*)m_assetDescriptors[i].name,path) == 0)
-		return -1;	//already loaded from cache or file
+		parent->dependencies.insert(parent->dependencies.end(), path, path + pathLength);
+		parent->dependencies.push_back('\0');
+		parent->dependencyCount++;
 	}
 
-	//save it
-	char* buffer = (char*)_alloca(pathLength + 1);
-	strncpy(buffer, path, pathLength);
-	buffer[pathLength] = '\0';
+	AssetLoadJob* job = new AssetLoadJob;
+	job->manager = this;
+	job->pathLength = pathLength;
+	memcpy(job->path, path, pathLength);
+	job->path[pathLength] = '\0';
+	job->dependencyCount = 0;
+	//hash the path once, it is used for both the descriptor and the cache lookup
+	job->key = MakeAssetKey(job->path, pathLength);
 
-	//set the dependency of the file
-	uint32_t curDepth = m_conversionDepth++;
-	assert(curDepth < CONVERSIONDEPTH);
-	if (curDepth > 0)
 	{
-		char* depStr = (char*)AllocateVirtualMemory(ALLOCATOR_IDX_DEPENDENCIES, m_dependencyAllocator, pathLength + 1);
-		strcpy_s(depStr, pathLength + 1, buffer);
-
-		for (uint32_t i = curDepth; i > 0; i--)
+		std::lock_guard<std::mutex> guard(m_lock);
+		uint32_t descriptorIdx = m_descriptorIndex.Find(job->key);
+		if (descriptorIdx != ASSETINDEX_EMPTY)
 		{
-			m_conversionStack[i - 1].dependencyCount++;
-			if (m_conversionStack[i - 1].dependencyCount == 1)
-				m_conversionStack[i - 1].dependencyStart = depStr;
+			assert(strcmp(job->path, m_assetDescriptors[descriptorIdx].name) == 0);	// Make sure this is not a hash collision
+			delete job;
+			return -1;	//already loaded from cache or file, or in flight
 		}
+
+		//reserve the descriptor, the asset is filled in when the job is done
+		job->descriptorIdx = m_descriptorCount++;
+		m_descriptorIndex.Insert(job->key, job->descriptorIdx);
+		AssetDescriptor* desc = (AssetDescriptor*)AllocateVirtualMemory(ALLOCATOR_IDX_ASSET_DESC, m_assetDescriptorAllocator, sizeof(AssetDescriptor));
+		assert(desc == m_assetDescriptors + job->descriptorIdx);
+		strcpy_s(desc->name, pathLength + 1, job->path);
+		desc->asset = asset_s();
+		desc->loadTime = 0.0f;
+		desc->loadResult = 0;
 	}
 
+	m_jobSystem.Submit(ExecuteLoadJob, job, &m_pendingLoads);
+	return 0;
+}
+
+void AssetManager::ExecuteLoadJob(void* data, uint32_t workerIdx)
+{
+	AssetLoadJob* job = (AssetLoadJob*)data;
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	int32_t ret = job->manager->ExecuteLoad(job, workerIdx);
+
+	QueryPerformanceCounter(&end);
+	//only this job writes the stats of its descriptor
+	AssetDescriptor* desc = job->manager->m_assetDescriptors + job->descriptorIdx;
+	desc->loadTime = (float)(1000.0 * (end.QuadPart - start.QuadPart) / frequency.QuadPart);
+	desc->loadResult = ret;
+	delete job;
+}
+
+int32_t AssetManager::ExecuteLoad(AssetLoadJob* job, uint32_t workerIdx)
+{
+	const char* buffer = job->path;
+	uint32_t pathLength = job->pathLength;
+	AssetDescriptor* desc = m_assetDescriptors + job->descriptorIdx;
+
 	//open file
 	MappedFile assetFile;
-	uint32_t ret = readonly_mapped_file_open(&assetFile, buffer);
+	uint32_t ret = readonly_mapped_file_open(&assetFile, buffer, MAPPED_FILE_SEQUENTIAL);
 	if (ret != 0)
-	{
-		m_conversionDepth--;
 		return -1;	// Could not open file
-	}
 
 	//get the data, and timestamp
 	const void* dataFile;
 	uint64_t fileSize, timestamp;
 	readonly_mapped_file_get_data(&assetFile, (void**)&dataFile, &fileSize);	//get data
 	readonly_mapped_file_get_change_timestamp(&assetFile, &timestamp);	//for comparing the change in time
+	m_bytesMapped += fileSize;
 
 	//load from the loaded cache, if it already is loaded once
-	uint32_t matched = 0;
-	for (uint32_t i = 0; i < m_cacheEntryCount; i++)
+	const CacheEntry* cacheHit = NULL;
 	{
-		//file is stored in cache
-		if (strcmp((const char*)m_cacheEntries[i].name,path) == 0 &&
-			m_cacheEntries[i].contentLength == fileSize &&
-			m_cacheEntries[i].timestamp == timestamp)
+		std::lock_guard<std::mutex> guard(m_lock);
+		uint32_t cacheIdx = m_cacheEntryIndex.Find(job->key);
+		cacheHit = (cacheIdx != ASSETINDEX_EMPTY) ? GetCacheEntry(cacheIdx) : NULL;
+	}
+	assert(!cacheHit || strcmp(buffer, cacheHit->name) == 0);	// Make sure this is not a hash collision
+	if (cacheHit && (cacheHit->contentLength != fileSize))
+		cacheHit = NULL;
+	//timestamps differ after a fresh checkout or copy, validate the content by hash instead
+	if (cacheHit && cacheHit->timestamp != timestamp)
+	{
+		if (HashAssetContent(dataFile, fileSize) == cacheHit->contentHash)
 		{
-			AssetDescriptor* desc = m_assetDescriptors + (m_descriptorCount++);	//offset depending
-
-			strcpy_s((char*)desc->name,pathLength+1,path);
-			desc->asset = m_cacheEntries[i].asset;
-
-			const char* dependencyStr = m_cacheEntries[i].dependenciesStart;
-			for (uint32_t j = 0; j < m_cacheEntries[i].dependencyCount; j++)
-			{
-				size_t len = strlen(dependencyStr);
-				LoadAsset(dependencyStr, (uint32_t)len);
-				dependencyStr += (len + 1);
-			}
+			//store the new timestamp, so the next run hits without hashing
+			std::lock_guard<std::mutex> guard(m_lock);
+			CacheEntry* refreshed = (CacheEntry*)AllocateVirtualMemory(ALLOCATOR_IDX_CACHE_ENTRY, m_cacheEntryAllocator, sizeof(CacheEntry));
+			*refreshed = *cacheHit;
+			refreshed->timestamp = timestamp;
+			m_cacheEntryIndex.Insert(job->key, (uint32_t)m_cacheEntryCount);
+			m_cacheEntryCount++;
+			m_modifcationCount++;
+			cacheHit = refreshed;
+		}
+		else
+			cacheHit = NULL;
+	}
+	//file is stored in cache
+	if (cacheHit)
+	{
+		desc->asset = cacheHit->asset;
 
-			readonly_mapped_file_close(&assetFile);
-			m_conversionDepth--;
-			return 0;	// Loaded from cache
+		//the dependencies load in parallel
+		const char* dependencyStr = cacheHit->dependenciesStart;
+		for (uint32_t j = 0; j < cacheHit->dependencyCount; j++)
+		{
+			size_t len = strlen(dependencyStr);
+			RequestAsset(dependencyStr, (uint32_t)len, NULL);
+			dependencyStr += (len + 1);
 		}
+
+		readonly_mapped_file_close(&assetFile);
+		return 1;	// Loaded from cache
 	}
 	//if it doesn't load the asset from cache
 	//find the extension
@@ -172,17 +510,23 @@ int32_t AssetManager::LoadAsset(const char* path, uint32_t pathLength)
 	}
 
 	//find converter based on the extension
-	sig_ConvertAsset* converterFunc;
-	for (uint32_t i = 0; i, CONVERTERNUM; i++)
+	const ConverterMap* converter = NULL;
+	for (uint32_t i = 0; i < CONVERTERNUM; i++)
 	{
 		if (strcmp(ext, m_converterMap[i].type) != 0)		//no hit
 			continue;
 		else												//hit
 		{
-			converterFunc = &m_converterMap[i].func;
+			converter = &m_converterMap[i];
 			break;
 		}
 	}
+	if (!converter)
+	{
+		readonly_mapped_file_close(&assetFile);
+		printf(" - No converter for asset %-32s\n", buffer);
+		return -8;	// Unknown extension
+	}
 
 	//get the base path length
 	uint32_t basePathLength = 0;
@@ -196,20 +540,23 @@ int32_t AssetManager::LoadAsset(const char* path, uint32_t pathLength)
 	}
 
 	//load asset normally
-	printf(" - Loading asset %-32s\r", buffer);
 	LARGE_INTEGER start, end;
 	double tickToMiliseconds;
 	QueryPerformanceFrequency(&start);
 	tickToMiliseconds = 1000.0 / start.QuadPart;
 	QueryPerformanceCounter(&start);
 
-	AssetDescriptor descriptor;
-	ret = (*converterFunc)(&descriptor.asset, dataFile, fileSize, buffer, basePathLength, m_assetAllocator, ALLOCATOR_IDX_ASSET_DATA);
+	//convert into the arena of this worker, dependencies requested by the converter are recorded on the job
+	asset_s asset;
+	job->timestamp = timestamp;
+	t_currentLoad = job;
+	ret = converter->func(&asset, dataFile, fileSize, buffer, basePathLength, m_assetAllocators[workerIdx], ALLOCATOR_IDX_ASSET_DATA);
+	t_currentLoad = NULL;
 
 	QueryPerformanceCounter(&end);				//end timing
 
+	uint64_t contentHash = HashAssetContent(dataFile, fileSize);
 	readonly_mapped_file_close(&assetFile);		//close file
-	m_conversionDepth--;
 
 	if (ret != 0)
 	{
@@ -218,84 +565,425 @@ int32_t AssetManager::LoadAsset(const char* path, uint32_t pathLength)
 	}
 
 	printf(" - [%8.02f ms] Loaded asset %-32s\n", tickToMiliseconds * (end.QuadPart - start.QuadPart), buffer);
-
-	//offset the pointer in memory
-	m_cacheEntries;
-
-	CacheEntry* cacheEntry = (CacheEntry*)AllocateVirtualMemory(ALLOCATOR_IDX_CACHE_ENTRY, m_cacheEntryAllocator,sizeof(CacheEntry));
-	m_cacheEntryCount++;
-	//CacheEntry* cacheEntry = m_cacheEntries + (m_cacheEntryCount++);
-	AssetDescriptor* descriptorEntry = m_assetDescriptors + (m_descriptorCount++);
+	m_bytesCopied += asset.size;
 
 	CacheEntry ce;
-	//ce.name = path;
-	strcpy_s((char*)ce.name, pathLength+1, path);
+	strcpy_s((char*)ce.name, pathLength+1, buffer);
 	ce.timestamp = timestamp;
+	ce.contentHash = contentHash;
 	ce.contentLength = fileSize;
-	ce.dependenciesStart = m_conversionStack[curDepth].dependencyStart;
-	ce.dependencyCount = m_conversionStack[curDepth].dependencyCount;
-	ce.asset = descriptor.asset;
+	ce.assetHash = HashAssetContent(asset.data.Get(), asset.size);
+	ce.dependencyCount = job->dependencyCount;
 
-	strcpy_s(descriptor.name, pathLength+1,path);
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		//different files can convert to the same data, like a texture saved under another name or format. They share one copy
+		uint32_t sameIdx = m_assetContentIndex.Find(MakeContentKey(ce.assetHash));
+		const CacheEntry* same = (sameIdx != ASSETINDEX_EMPTY) ? GetCacheEntry(sameIdx) : NULL;
+		if (same && same->asset.size == asset.size && memcmp(same->asset.data.Get(), asset.data.Get(), (size_t)asset.size) == 0)
+		{
+			//the converted copy is the newest allocation of this worker, unless the converter allocated more behind it
+			Memory_Linear_Allocator* arena = m_assetAllocators[workerIdx];
+			if (asset.data.Get() + asset.size == arena->startPtr + arena->allocatedBytes)
+				RewindVirtualMemory(ALLOCATOR_IDX_ASSET_DATA, arena, asset.data.Get());
+			asset.data = same->asset.data;
+			printf(" - Asset %s has the same data as %s, sharing it\n", buffer, same->name);
+		}
+		ce.asset = asset;
 
-	*cacheEntry = ce;
-	*descriptorEntry = descriptor;
+		//store the dependency edges back to back
+		char* depStr = NULL;
+		if (job->dependencyCount)
+		{
+			depStr = (char*)AllocateVirtualMemory(ALLOCATOR_IDX_DEPENDENCIES, m_dependencyAllocator, job->dependencies.size());
+			memcpy(depStr, job->dependencies.data(), job->dependencies.size());
+		}
 
-	m_modifcationCount++;
+		CacheEntry* cacheEntry = (CacheEntry*)AllocateVirtualMemory(ALLOCATOR_IDX_CACHE_ENTRY, m_cacheEntryAllocator, sizeof(CacheEntry));
+		*cacheEntry = ce;
+		cacheEntry->dependenciesStart = depStr;
+		m_cacheEntryIndex.Insert(job->key, (uint32_t)m_cacheEntryCount);
+		if (!same || same->asset.data.Get() != asset.data.Get())
+			m_assetContentIndex.Insert(MakeContentKey(ce.assetHash), (uint32_t)m_cacheEntryCount);
+		m_cacheEntryCount++;
+		m_modifcationCount++;
+	}
+	desc->asset = asset;
 
 	return 0;
 }
 
 int32_t AssetManager::FlushAssets()
 {
-	/*store in this format:
-		- header
-		- cacheentries
-		- data
-		- dependencies
+	/*append one segment to the journal:
+		- segment header
+		- cacheentries created this session
+		- data allocated this session
+		- dependencies allocated this session
+	  Pointers are stored self-relative. Entries refreshed this session can still point into earlier segments,
+	  so the cost of a flush only depends on what changed. The header is rewritten last, it commits the segment.
 	*/
 
+	//terminal, the mapped entries, segment count and loaded assets are not rebuilt after the mapping is released
+	assert(!m_flushed);
+	m_jobSystem.Shutdown();			//loading is done, the cache is written at the end of the run
+
 	if (m_modifcationCount == 0)		//check for changes in the cache entry
+	{
+		m_flushed = 1;
 		return 0;
+	}
+
+	//compact instead when the superseded data outweighs the live data
+	uint64_t liveBytes = 0, deadBytes = 0;
+	for (uint32_t i = 0; i < m_mappedCacheEntryCount; i++)
+	{
+		const CacheEntry* entry = m_mappedCacheEntries[i];
+		if (m_cacheEntryIndex.Find(MakeAssetKey(entry->name, (uint32_t)strlen(entry->name))) == i)
+			liveBytes += entry->asset.size;
+		else
+			deadBytes += entry->asset.size;
+	}
+	if (deadBytes > ASSETCACHE_COMPACT_MIN_BYTES && deadBytes > liveBytes)
+		return CompactAssets();
+	m_flushed = 1;
+
+	const uint64_t sessionEntryCount = m_cacheEntryCount - m_mappedCacheEntryCount;
+	AssetCacheHeader header = {};
+	header.magicNumber = ASSETCACHE_MAGIC;
+	header.segmentCount = m_mappedSegmentCount + 1;
+	header.entryCount = m_cacheEntryCount;
 
-	FILE* cacheFile = fopen("assets/assets.cache", "wb"); //write in binary
+	AssetCacheSegment segment;
+	segment.entryCount = sessionEntryCount;
+	segment.assetBlobSize = GetAssetBlobSize();
+	segment.dependencyBlobSize = m_dependencyAllocator->allocatedBytes;
+
+	const uint64_t segmentStart = m_cacheFileMapped ? m_mappedCacheSize : AlignCacheOffset(sizeof(AssetCacheHeader));
+	const uint64_t entryStart = segmentStart + sizeof(AssetCacheSegment);
+	const uint64_t assetBlobStart = AlignCacheOffset(entryStart + sessionEntryCount * sizeof(CacheEntry));
+	const uint64_t dependencyBlobStart = assetBlobStart + segment.assetBlobSize;
+	segment.segmentSize = AlignCacheOffset(dependencyBlobStart + segment.dependencyBlobSize) - segmentStart;
+	header.committedSize = segmentStart + segment.segmentSize;
+
+	// re-base the pointers of the new entries to the file layout, while the old segments are still mapped
+	CacheEntry* outEntries = (CacheEntry*)calloc((size_t)sessionEntryCount + 1, sizeof(CacheEntry));	//zeroed, the padding is written as well
+	for (uint64_t i = 0; i < sessionEntryCount; i++)
+	{
+		const CacheEntry* entry = m_cacheEntries + i;
+		CacheEntry* out = outEntries + i;
+		CopyCacheEntryFields(out, entry);
+		uint64_t entryOffset = entryStart + i * sizeof(CacheEntry);
+
+		const uint8_t* data = entry->asset.data;
+		uint64_t dataOffset = (data >= m_mappedCacheStart && data < m_mappedCacheStart + m_mappedCacheSize) ? data - m_mappedCacheStart : assetBlobStart + GetAssetBlobOffset(data);
+		out->asset.data.offset = (int64_t)(dataOffset - (entryOffset + offsetof(CacheEntry, asset) + offsetof(asset_s, data)));
+
+		out->dependenciesStart.offset = 0;
+		if (entry->dependencyCount)
+		{
+			uint64_t depOffset = BlobFileOffset(entry->dependenciesStart, m_mappedCacheStart, m_mappedCacheSize, m_dependencyAllocator->startPtr, dependencyBlobStart);
+			out->dependenciesStart.offset = (int64_t)(depOffset - (entryOffset + offsetof(CacheEntry, dependenciesStart)));
+		}
+	}
+
+	// release the mapping, the file is opened for writing
+	if (m_cacheFileMapped)
+	{
+		readonly_mapped_file_close(&m_cacheFile);
+		m_cacheFileMapped = 0;
+	}
+
+	FILE* cacheFile = fopen(m_cachePath, segmentStart == m_mappedCacheSize ? "r+b" : "wb");
 	if (!cacheFile)
-		printf("no available cache file to flush to \n");
+	{
+		free(outEntries);
+		RETURN_ERROR(-1, "no available cache file to flush to");
+	}
 
-	AssetCacheHeader header;
-	header.magicNumber = 'RAC0';
-	header.entryCount = m_cacheEntryCount;
-	header.assetBlobSize = m_assetAllocator->allocatedBytes;
-	header.dependencyBlobSize = m_dependencyAllocator->allocatedBytes;
+	// a new file gets an empty header first, an interrupted append leaves the old header intact
+	if (segmentStart != m_mappedCacheSize)
+	{
+		AssetCacheHeader empty = {};
+		empty.magicNumber = ASSETCACHE_MAGIC;
+		empty.committedSize = segmentStart;
+		fwrite(&empty, sizeof(empty), 1, cacheFile);
+		WriteCachePadding(cacheFile, sizeof(empty), segmentStart);
+	}
+	_fseeki64(cacheFile, segmentStart, SEEK_SET);
+
+	fwrite(&segment, sizeof(segment), 1, cacheFile);
+	fwrite(outEntries, sizeof(CacheEntry), (size_t)sessionEntryCount, cacheFile);
+	WriteCachePadding(cacheFile, entryStart + sessionEntryCount * sizeof(CacheEntry), assetBlobStart);
+	// write raw data, asset internal pointers stay valid since the blob is written contiguous
+	uint64_t arenaOffset = assetBlobStart;
+	for (uint32_t i = 0; i < m_assetAllocatorCount; i++)		//stitch the worker arenas together
+	{
+		fwrite(m_assetAllocators[i]->startPtr, 1, (size_t)m_assetAllocators[i]->allocatedBytes, cacheFile);
+		WriteCachePadding(cacheFile, arenaOffset + m_assetAllocators[i]->allocatedBytes, AlignCacheOffset(arenaOffset + m_assetAllocators[i]->allocatedBytes));
+		arenaOffset = AlignCacheOffset(arenaOffset + m_assetAllocators[i]->allocatedBytes);
+	}
+	fwrite(m_dependencyAllocator->startPtr, 1, (size_t)segment.dependencyBlobSize, cacheFile);
+	WriteCachePadding(cacheFile, dependencyBlobStart + segment.dependencyBlobSize, header.committedSize);
+	free(outEntries);
+
+	// commit the segment
+	fflush(cacheFile);
+	_fseeki64(cacheFile, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, cacheFile);
+	fclose(cacheFile);
+
+	m_bytesCopied += header.committedSize - segmentStart;
+	m_modifcationCount = 0;
+	return 0;
+}
+
+int32_t AssetManager::CompactAssets()
+{
+	/*rewrite the journal as a single segment, only the newest entry per path is kept.
+	  Data is copied per asset, so the pointers are re-based per entry
+	*/
+	assert(!m_flushed);
+	m_jobSystem.Shutdown();			//terminal like FlushAssets
+	m_flushed = 1;
+
+	std::vector<uint32_t> live;
+	std::vector<uint64_t> liveDataOffsets;					//offset of the data of every live entry in the asset blob
+	std::unordered_map<const uint8_t*, uint64_t> blobs;	//entries sharing data share the blob as well
+	uint64_t assetBlobSize = 0, dependencyBlobSize = 0;
+	for (uint32_t i = 0; i < m_cacheEntryCount; i++)
+	{
+		const CacheEntry* entry = GetCacheEntry(i);
+		if (m_cacheEntryIndex.Find(MakeAssetKey(entry->name, (uint32_t)strlen(entry->name))) != i)
+			continue;	//superseded
+		live.push_back(i);
+		auto blob = blobs.insert(std::make_pair(entry->asset.data.Get(), assetBlobSize));
+		if (blob.second)
+			assetBlobSize += AlignCacheOffset(entry->asset.size);
+		liveDataOffsets.push_back(blob.first->second);
+		dependencyBlobSize += DependencyBlobLength(entry);
+	}
+
+	char tmpPath[sizeof(m_cachePath) + 4];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", m_cachePath);
+	FILE* cacheFile = fopen(tmpPath, "wb"); //write in binary, the current cache can still be mapped
+	if (!cacheFile)
+		RETURN_ERROR(-1, "no available cache file to compact to");
 
-	uint32_t cacheSize = sizeof(CacheEntry);
+	const uint64_t segmentStart = AlignCacheOffset(sizeof(AssetCacheHeader));
+	const uint64_t entryStart = segmentStart + sizeof(AssetCacheSegment);
+	const uint64_t assetBlobStart = AlignCacheOffset(entryStart + live.size() * sizeof(CacheEntry));
+	const uint64_t dependencyBlobStart = assetBlobStart + assetBlobSize;
+
+	AssetCacheSegment segment;
+	segment.entryCount = live.size();
+	segment.assetBlobSize = assetBlobSize;
+	segment.dependencyBlobSize = dependencyBlobSize;
+	segment.segmentSize = AlignCacheOffset(dependencyBlobStart + dependencyBlobSize) - segmentStart;
+
+	AssetCacheHeader header = {};
+	header.magicNumber = ASSETCACHE_MAGIC;
+	header.segmentCount = 1;
+	header.entryCount = live.size();
+	header.committedSize = segmentStart + segment.segmentSize;
 
-	// write header
 	fwrite(&header, sizeof(header), 1, cacheFile);
-	// write cache entires ( descriptors )
-	fwrite(m_cacheEntryAllocator->startPtr, 1, m_cacheEntryAllocator->allocatedBytes, cacheFile);
-	// write raw data
-	fwrite(m_assetAllocator->startPtr, 1, m_assetAllocator->allocatedBytes, cacheFile);
+	WriteCachePadding(cacheFile, sizeof(header), segmentStart);
+	fwrite(&segment, sizeof(segment), 1, cacheFile);
+
+	// write cache entires, with the pointers re-based to the compacted layout
+	CacheEntry* outEntries = (CacheEntry*)calloc(live.size() + 1, sizeof(CacheEntry));	//zeroed, the padding is written as well
+	uint64_t depOffset = dependencyBlobStart;
+	for (size_t i = 0; i < live.size(); i++)
+	{
+		const CacheEntry* entry = GetCacheEntry(live[i]);
+		CacheEntry* out = outEntries + i;
+		CopyCacheEntryFields(out, entry);
+		uint64_t entryOffset = entryStart + i * sizeof(CacheEntry);
+
+		out->asset.data.offset = (int64_t)(assetBlobStart + liveDataOffsets[i] - (entryOffset + offsetof(CacheEntry, asset) + offsetof(asset_s, data)));
+
+		out->dependenciesStart.offset = 0;
+		if (entry->dependencyCount)
+		{
+			out->dependenciesStart.offset = (int64_t)(depOffset - (entryOffset + offsetof(CacheEntry, dependenciesStart)));
+			depOffset += DependencyBlobLength(entry);
+		}
+	}
+	fwrite(outEntries, sizeof(CacheEntry), live.size(), cacheFile);
+	free(outEntries);
+	WriteCachePadding(cacheFile, entryStart + live.size() * sizeof(CacheEntry), assetBlobStart);
+	// write raw data per asset, asset internal pointers are relative to the asset itself
+	uint64_t dataOffset = 0;
+	for (size_t i = 0; i < live.size(); i++)
+	{
+		const CacheEntry* entry = GetCacheEntry(live[i]);
+		if (liveDataOffsets[i] != dataOffset)
+			continue;	//shared, the blob is already written
+		dataOffset += AlignCacheOffset(entry->asset.size);
+		fwrite(entry->asset.data.Get(), 1, (size_t)entry->asset.size, cacheFile);
+		WriteCachePadding(cacheFile, entry->asset.size, AlignCacheOffset(entry->asset.size));
+	}
 	// write dependencies
-	fwrite(m_dependencyAllocator->startPtr, 1, m_dependencyAllocator->allocatedBytes, cacheFile);
+	for (size_t i = 0; i < live.size(); i++)
+	{
+		const CacheEntry* entry = GetCacheEntry(live[i]);
+		if (entry->dependencyCount)
+			fwrite(entry->dependenciesStart.Get(), 1, (size_t)DependencyBlobLength(entry), cacheFile);
+	}
+	WriteCachePadding(cacheFile, dependencyBlobStart + dependencyBlobSize, header.committedSize);
 	fclose(cacheFile);
+	m_bytesCopied += header.committedSize;
+
+	printf("Compacted asset cache, dropped %llu superseded entries\n", (unsigned long long)(m_cacheEntryCount - live.size()));
 
+	// release the old mapping before replacing the file
+	if (m_cacheFileMapped)
+	{
+		readonly_mapped_file_close(&m_cacheFile);
+		m_cacheFileMapped = 0;
+	}
+	uint32_t error = replace_file(tmpPath, m_cachePath);
+	if (error != 0)
+		RETURN_ERROR(-1, "unable to replace the asset cache (0x%08X)", error);
+
+	m_modifcationCount = 0;
 	return 0;
 }
 
-int32_t AssetManager::GetAsset(const char* path, asset_s** outAsset)
+int32_t AssetManager::InvalidateCacheEntry(const char* path, uint32_t pathLength)
+{
+	assert(!m_flushed);
+	AssetKey key = MakeAssetKey(path, pathLength);
+	std::lock_guard<std::mutex> guard(m_lock);
+	if (m_cacheEntryIndex.Find(key) == ASSETINDEX_EMPTY)
+		return -1;
+	//the entry stays in the journal, it is superseded by the next conversion or dropped by compaction
+	m_cacheEntryIndex.Remove(key);
+	return 0;
+}
+
+int32_t AssetManager::ReloadAsset(const char* path, uint32_t pathLength)
 {
-	asset_s* out = NULL;
-	int32_t ret = 0;
+	assert(!t_currentLoad);		//converters request their dependencies with LoadAsset
+	assert(!m_flushed);
+	assert(pathLength < sizeof(CacheEntry::name));
+
+	AssetLoadJob* job = new AssetLoadJob;
+	job->manager = this;
+	job->pathLength = pathLength;
+	memcpy(job->path, path, pathLength);
+	job->path[pathLength] = '\0';
+	job->dependencyCount = 0;
+	job->key = MakeAssetKey(job->path, pathLength);
 
-	for (uint32_t i = 0; i < m_descriptorCount; i++)
 	{
-		if (strcmp(path, (const char*)m_assetDescriptors[i].name) == 0)//hit
+		std::lock_guard<std::mutex> guard(m_lock);
+		job->descriptorIdx = m_descriptorIndex.Find(job->key);
+	}
+	if (job->descriptorIdx == ASSETINDEX_EMPTY)
+	{
+		delete job;
+		return -1;	//not loaded, nothing to reload
+	}
+
+	//the cache entry of the old content misses on the hash, so only a changed file is converted.
+	//the descriptor keeps the old asset when the conversion fails, its data stays valid until the manager is destroyed
+	uint32_t descriptorIdx = job->descriptorIdx;
+	m_jobSystem.Submit(ExecuteLoadJob, job, &m_pendingLoads);
+	m_jobSystem.Wait(&m_pendingLoads);		//new dependencies of the asset are loaded as well
+
+	return m_assetDescriptors[descriptorIdx].loadResult;
+}
+
+uint32_t AssetManager::GetDependents(const char* path, uint32_t pathLength, uint32_t* outDescriptorIndices, uint32_t maxCount)
+{
+	//walk the dependency edges of the loaded assets backwards, breadth first
+	std::vector<uint32_t> dependents;
+	std::lock_guard<std::mutex> guard(m_lock);
+	uint32_t target = m_descriptorIndex.Find(MakeAssetKey(path, pathLength));
+	if (target == ASSETINDEX_EMPTY)
+		return 0;
+
+	dependents.push_back(target);
+	for (size_t t = 0; t < dependents.size(); t++)
+	{
+		const char* targetName = m_assetDescriptors[dependents[t]].name;
+		for (uint32_t i = 0; i < m_descriptorCount; i++)
 		{
-			(*outAsset) = &m_assetDescriptors[i].asset;
-			return ret;
+			const char* name = m_assetDescriptors[i].name;
+			uint32_t cacheIdx = m_cacheEntryIndex.Find(MakeAssetKey(name, (uint32_t)strlen(name)));
+			if (cacheIdx == ASSETINDEX_EMPTY)
+				continue;	//failed or still loading
+
+			const CacheEntry* entry = GetCacheEntry(cacheIdx);
+			const char* dependencyStr = entry->dependenciesStart;
+			for (uint32_t j = 0; j < entry->dependencyCount; j++)
+			{
+				if (strcmp(dependencyStr, targetName) == 0)
+				{
+					if (std::find(dependents.begin(), dependents.end(), i) == dependents.end())
+						dependents.push_back(i);
+					break;
+				}
+				dependencyStr += strlen(dependencyStr) + 1;
+			}
 		}
 	}
-	ret = -1;
-	return ret;
+
+	//the asset itself is not one of its dependents
+	uint32_t count = (uint32_t)dependents.size() - 1;
+	for (uint32_t i = 0; i < count && i < maxCount; i++)
+		outDescriptorIndices[i] = dependents[i + 1];
+	return count;
+}
+
+int32_t AssetManager::GetAsset(const char* path, asset_s** outAsset)
+{
+	return GetAsset(MakeAssetKey(path, (uint32_t)strlen(path)), path, outAsset);
+}
+
+int32_t AssetManager::GetAsset(const AssetKey& key, const char* path, asset_s** outAsset)
+{
+	assert(!m_flushed);		//assets from the mapped cache are unmapped
+	uint32_t i = m_descriptorIndex.Find(key);
+	if (i == ASSETINDEX_EMPTY)
+		return -1;
+
+	assert(strcmp(path, m_assetDescriptors[i].name) == 0);	// Make sure this is not a hash collision
+	if (!m_assetDescriptors[i].asset.data)
+		return -2;	//failed to load
+	(*outAsset) = &m_assetDescriptors[i].asset;	//hit
+	return 0;
+}
+
+uint64_t AssetManager::GetAssetBlobSize() const
+{
+	uint64_t size = 0;
+	for (uint32_t i = 0; i < m_assetAllocatorCount; i++)
+		size = AlignCacheOffset(size + m_assetAllocators[i]->allocatedBytes);
+	return size;
+}
+
+uint64_t AssetManager::GetAssetBlobOffset(const void* ptr) const
+{
+	const uint8_t* p = (const uint8_t*)ptr;
+	uint64_t offset = 0;
+	for (uint32_t i = 0; i < m_assetAllocatorCount; i++)
+	{
+		const Memory_Linear_Allocator* arena = m_assetAllocators[i];
+		if (p >= arena->startPtr && p < arena->startPtr + arena->allocatedBytes)
+			return offset + (p - arena->startPtr);
+		offset = AlignCacheOffset(offset + arena->allocatedBytes);
+	}
+	assert(0);	//not allocated in an asset arena
+	return 0;
+}
+
+const CacheEntry* AssetManager::GetCacheEntry(uint32_t index) const
+{
+	assert(index < m_cacheEntryCount);
+	if (index < m_mappedCacheEntryCount)
+		return m_mappedCacheEntries[index];
+	return m_cacheEntries + (index - m_mappedCacheEntryCount);
 }
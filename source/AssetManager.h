@@ -5,14 +5,27 @@
 #include "Defines.h"
 #include "DataTypes.h"
 #include "OpenGEX.h"
+#include "io.h"
+#include "JobSystem.h"
 
+#include <mutex>
+#include <atomic>
+#include <vector>
 
-#define CONVERTERNUM 5
-#define CONVERSIONDEPTH 4
+
+#define CONVERTERNUM 6
+#define ASSETARENA_SIZE 0x40000000ull		//asset data reserved per worker
+#define ASSETINDEX_SEED 0xA86F13C7
+#define ASSETINDEX_INITIAL_SLOTS 1024
+#define ASSETINDEX_EMPTY 0xFFFFFFFF
+#define ASSETCONTENT_SEED 0x3C6EF372
+#define ASSETCACHE_COMPACT_MIN_BYTES (64ull << 20)	//superseded bytes in the journal before a flush compacts it
+#define ASSETCACHE_PATH "assets/assets.cache"
 
 typedef uint32_t(*sig_ConvertAsset) (asset_s* outAsset, const void* data, uint64_t dataSizeInBytes, const char* basePath, uint32_t basePathLength, Memory_Linear_Allocator* allocator, uint32_t allocatorIdx);
 uint32_t ConvertAsset_Image(asset_s* outAsset, const void* data, uint64_t dataSizeInBytes, const char* basePath, uint32_t basePathLength, Memory_Linear_Allocator* allocator, uint32_t allocatorIdx);
 uint32_t ConvertAsset_OpenGEX(asset_s* outAsset, const void* data, uint64_t dataSizeInBytes, const char* basePath, uint32_t basePathLength, Memory_Linear_Allocator* allocator, uint32_t allocatorIdx);
+uint32_t ConvertAsset_CompiledScene(asset_s* outAsset, const void* data, uint64_t dataSizeInBytes, const char* basePath, uint32_t basePathLength, Memory_Linear_Allocator* allocator, uint32_t allocatorIdx);
 uint32_t ConvertAsset_HLSL_Bytecode(asset_s* outAsset, const void* data, uint64_t dataSizeInBytes, const char* basePath, uint32_t basePathLength, Memory_Linear_Allocator* allocator, uint32_t allocatorIdx);
 uint32_t ConvertAsset_SPIRV(asset_s* outAsset, const void* data, uint64_t dataSizeInBytes, const char* basePath, uint32_t basePathLength, Memory_Linear_Allocator* allocator, uint32_t allocatorIdx);
 
@@ -22,10 +35,49 @@ struct ConverterMap
 	sig_ConvertAsset func;
 };
 
-struct ConversionStack
+// Hashed asset path, computed once per lookup and reused for every table it is probed in
+struct AssetKey
+{
+	uint64_t hash[2];
+};
+
+// Open addressing (linear probing) index mapping an asset path to an array index
+struct AssetIndex
+{
+	struct AssetIndexEntry
+	{
+		AssetKey key;		// whole path hash, both halves are compared so a lookup never needs the name
+		uint32_t index;		// index into the indexed array, ASSETINDEX_EMPTY when unused
+	} *entries;
+	uint32_t slotCount;		// always a power of two
+	uint32_t usedCount;
+
+	void Init(uint32_t slots);
+	void Destroy();
+	void Clear();
+	void Insert(const AssetKey& key, uint32_t index);	// inserts or replaces the index stored for key
+	uint32_t Find(const AssetKey& key) const;			// returns ASSETINDEX_EMPTY when the key is not indexed
+	void Remove(const AssetKey& key);
+};
+
+AssetKey MakeAssetKey(const char* path, uint32_t pathLength);
+uint64_t HashAssetContent(const void* data, uint64_t dataSizeInBytes);
+// Change timestamp of the file the calling converter is converting, 0 outside of a conversion
+uint64_t GetConvertedFileTimestamp();
+
+class AssetManager;
+
+// One asset to load, executed on the job system. Dependencies requested while converting are the edges of the asset
+struct AssetLoadJob
 {
-	const char* dependencyStart;
+	AssetManager* manager;
+	AssetKey key;
+	uint32_t descriptorIdx;
+	uint32_t pathLength;
+	char path[sizeof(CacheEntry::name)];
+	uint64_t timestamp;					//of the mapped file while it is converted
 	uint32_t dependencyCount;
+	std::vector<char> dependencies;		//zero terminated dependency paths, back to back
 };
 
 
@@ -35,10 +87,21 @@ public:
 	AssetManager();
 	~AssetManager();
 
-	int32_t InitAssetManager();// initializes the assetmanager
-	int32_t LoadAsset(const char* path, uint32_t pathLength); 	//loads all assets, will branch depending on the type of file
-	int32_t FlushAssets();
+	int32_t InitAssetManager(uint32_t workerCount = 0, const char* cachePath = ASSETCACHE_PATH);// initializes the assetmanager, 0 workers uses one per hardware thread
+	int32_t LoadAsset(const char* path, uint32_t pathLength); 	//loads the asset and its dependencies, returns when all are loaded. Called from a converter it only records and schedules the dependency
+	int32_t FlushAssets();		// appends the changes to the cache, releases the mapped cache file. Terminal and called once: stops the workers, loaded assets are invalid afterwards and only the destructor may follow
+	int32_t CompactAssets();	// rewrites the cache with only the newest entry per path, releases the mapped cache file. Terminal like FlushAssets
 	int32_t GetAsset(const char* path, asset_s** outAsset);
+	int32_t GetAsset(const AssetKey& key, const char* path, asset_s** outAsset);
+	const CacheEntry* GetCacheEntry(uint32_t index) const;	//mapped entries first, followed by the entries of this session
+	int32_t InvalidateCacheEntry(const char* path, uint32_t pathLength);	//the next load of the path converts it again, -1 when it is not cached
+	int32_t ReloadAsset(const char* path, uint32_t pathLength);	//converts a loaded asset again when its file changed. 0 when converted, 1 when unchanged, -1 when it was never loaded
+	uint32_t GetDependents(const char* path, uint32_t pathLength, uint32_t* outDescriptorIndices, uint32_t maxCount);	//loaded assets depending on the path, directly or indirectly. Returns the total count
+	int32_t RequestAsset(const char* path, uint32_t pathLength, AssetLoadJob* parent);	//reserves the descriptor and schedules the load, -1 when already requested
+	int32_t ExecuteLoad(AssetLoadJob* job, uint32_t workerIdx);	//0 when converted, 1 when loaded from the cache, negative on failure
+	static void ExecuteLoadJob(void* data, uint32_t workerIdx);
+	uint64_t GetAssetBlobSize() const;						//size of all asset arenas, stitched together
+	uint64_t GetAssetBlobOffset(const void* ptr) const;		//offset of a pointer into an asset arena in the stitched blob
 	///////////////////////////////////////////////////////
 	//convertermap
 	ConverterMap		m_converterMap[CONVERTERNUM];
@@ -46,16 +109,36 @@ public:
 	uint32_t m_descriptorCount;
 	uint64_t m_cacheEntryCount;
 	uint32_t m_modifcationCount;
+	uint32_t m_flushed;										//FlushAssets or CompactAssets ran, the mapped state is stale
 	//allocators
-	Memory_Linear_Allocator* m_assetAllocator;				//linear asset allocator for easy caching of data
+	Memory_Linear_Allocator* m_assetAllocators[JOBSYSTEM_MAX_WORKERS];	//linear asset allocator per worker, stitched together on flush
+	uint32_t m_assetAllocatorCount;
 	Memory_Linear_Allocator* m_assetDescriptorAllocator;	//linear descriptor allocator
 	Memory_Linear_Allocator* m_cacheEntryAllocator;			//linear cache entry allocator
 	Memory_Linear_Allocator* m_dependencyAllocator;			//linear dependency allocator
 	//memory pointer data
-	CacheEntry* m_cacheEntries;								//pointer to start of the cache entries
+	CacheEntry* m_cacheEntries;								//pointer to start of the cache entries created this session
 	AssetDescriptor* m_assetDescriptors;					//pointer to start of the allocated descriptors
-	uint32_t m_conversionDepth;
-	ConversionStack m_conversionStack[CONVERSIONDEPTH];
+	//mapped asset cache, used in place
+	MappedFile m_cacheFile;
+	uint32_t m_cacheFileMapped;
+	const uint8_t* m_mappedCacheStart;
+	uint64_t m_mappedCacheSize;								//committed size of the mapped journal
+	uint32_t m_mappedSegmentCount;
+	const CacheEntry** m_mappedCacheEntries;				//entries of all mapped segments, indices [0, m_mappedCacheEntryCount)
+	uint64_t m_mappedCacheEntryCount;
+	//lookup indices keyed on the asset path
+	AssetIndex m_descriptorIndex;							//path -> m_assetDescriptors
+	AssetIndex m_cacheEntryIndex;							//path -> m_cacheEntries (newest entry wins)
+	AssetIndex m_assetContentIndex;							//hash of the converted data -> cache entry, identical assets share that data
+	//loading
+	JobSystem m_jobSystem;
+	std::atomic<uint32_t> m_pendingLoads;
+	std::mutex m_lock;										//guards the counters, indices, cache entries and dependencies
+	char m_cachePath[256];
+	//statistics
+	std::atomic<uint64_t> m_bytesMapped;					//asset files mapped for loading, and the mapped cache
+	std::atomic<uint64_t> m_bytesCopied;					//asset data produced by converters, and bytes written to the cache
 
 };
 
@@ -0,0 +1,500 @@
+#include "BlockCompression.h"
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_image/stb_dxt.h>
+
+#include <emmintrin.h>		//SSE2, the baseline of every x64 CPU
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+static const uint32_t g_blockSizes[IMAGE_FORMAT_COUNT] = { 0, 8, 8, 16, 16 };
+static const uint32_t g_bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+uint64_t GetImageLevelSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	if (format == IMAGE_FORMAT_RGBA8)
+		return (uint64_t)width * height * sizeof(uint32_t);
+	return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * g_blockSizes[format];
+}
+
+// Gathers a 4x4 block, texels over the edge of the level repeat the last row and column
+static void LoadBlock(uint32_t* block, const uint32_t* src, uint32_t width, uint32_t height, uint32_t bx, uint32_t by)
+{
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		const uint32_t* row = src + width * std::min(by + y, height - 1);
+		if (bx + 4 <= width)
+			memcpy(block + 4 * y, row + bx, 4 * sizeof(uint32_t));
+		else
+		{
+			for (uint32_t x = 0; x < 4; x++)
+				block[4 * y + x] = row[std::min(bx + x, width - 1)];
+		}
+	}
+}
+
+// Writes a decoded 4x4 block, texels over the edge of the level are dropped
+static void StoreBlock(uint32_t* dst, const uint32_t* block, uint32_t width, uint32_t height, uint32_t bx, uint32_t by)
+{
+	for (uint32_t y = 0; y < 4 && by + y < height; y++)
+	{
+		for (uint32_t x = 0; x < 4 && bx + x < width; x++)
+			dst[width * (by + y) + bx + x] = block[4 * y + x];
+	}
+}
+
+static inline void WriteBits(uint64_t* bits, uint32_t* pos, uint64_t value, uint32_t count)
+{
+	uint32_t word = *pos >> 6, shift = *pos & 63;
+	bits[word] |= value << shift;
+	if (shift + count > 64)
+		bits[word + 1] |= value >> (64 - shift);
+	*pos += count;
+}
+
+static inline uint32_t ReadBits(const uint64_t* bits, uint32_t* pos, uint32_t count)
+{
+	uint32_t word = *pos >> 6, shift = *pos & 63;
+	uint64_t value = bits[word] >> shift;
+	if (shift + count > 64)
+		value |= bits[word + 1] << (64 - shift);
+	*pos += count;
+	return (uint32_t)(value & ((1ull << count) - 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BC4 and BC5
+////////////////////////////////////////////////////////////////////////////////
+// One byte channel of the 16 texels of a block
+static inline __m128i GatherChannel(const uint32_t* block, uint32_t channel)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i shift = _mm_cvtsi32_si128(8 * channel);
+	__m128i r0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)block + 0), shift), mask);
+	__m128i r1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)block + 1), shift), mask);
+	__m128i r2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)block + 2), shift), mask);
+	__m128i r3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*)block + 3), shift), mask);
+	return _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+}
+
+// Encodes one channel like a BC4 block, the indices are optimal for the min and max endpoints (see stb_dxt)
+static void CompressChannelBlock(uint8_t* dst, const uint32_t* block, uint32_t channel)
+{
+	__m128i v = GatherChannel(block, channel);
+	__m128i mn = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+	__m128i mx = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 2));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 2));
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 1));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 1));
+	int32_t minValue = _mm_cvtsi128_si32(mn) & 0xFF;
+	int32_t maxValue = _mm_cvtsi128_si32(mx) & 0xFF;
+
+	uint8_t values[16];
+	_mm_storeu_si128((__m128i*)values, v);
+
+	//max first selects the mode with 6 interpolated values
+	dst[0] = (uint8_t)maxValue;
+	dst[1] = (uint8_t)minValue;
+
+	int32_t dist = maxValue - minValue;
+	int32_t dist4 = dist * 4;
+	int32_t dist2 = dist * 2;
+	int32_t bias = ((dist < 8) ? (dist - 1) : (dist / 2 + 2)) - minValue * 7;
+	uint64_t indices = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		int32_t a = values[i] * 7 + bias;
+		int32_t t, index;
+		//linear position between min (0) and max (7)
+		t = (a >= dist4) ? -1 : 0; index = t & 4; a -= dist4 & t;
+		t = (a >= dist2) ? -1 : 0; index += t & 2; a -= dist2 & t;
+		index += (a >= dist);
+		//to the index order of the block, 0 and 1 are the endpoints
+		index = -index & 7;
+		index ^= (2 > index);
+		indices |= (uint64_t)index << (3 * i);
+	}
+	for (uint32_t i = 0; i < 6; i++)
+		dst[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+static void DecompressChannelBlock(uint8_t* values, const uint8_t* src)
+{
+	uint32_t palette[8];
+	palette[0] = src[0];
+	palette[1] = src[1];
+	if (palette[0] > palette[1])
+	{
+		for (uint32_t i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7;
+	}
+	else
+	{
+		for (uint32_t i = 1; i < 5; i++)
+			palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t indices = 0;
+	for (uint32_t i = 0; i < 6; i++)
+		indices |= (uint64_t)src[2 + i] << (8 * i);
+	for (uint32_t i = 0; i < 16; i++)
+		values[i] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BC1
+////////////////////////////////////////////////////////////////////////////////
+static void CompressBlockBC1(uint8_t* dst, const uint32_t* block)
+{
+	//stb_dxt builds its tables on the first call without a lock, build them before the workers use it
+	static const int initialized = (stb_compress_dxt_block(dst, (const unsigned char*)block, 0, STB_DXT_NORMAL), 1);
+	(void)initialized;
+	stb_compress_dxt_block(dst, (const unsigned char*)block, 0, STB_DXT_NORMAL);
+}
+
+static inline uint32_t Expand565(uint32_t c)
+{
+	uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	return ((r << 3) | (r >> 2)) | (((g << 2) | (g >> 4)) << 8) | (((b << 3) | (b >> 2)) << 16);
+}
+
+static void DecompressBlockBC1(uint32_t* block, const uint8_t* src)
+{
+	uint32_t c0 = src[0] | (src[1] << 8);
+	uint32_t c1 = src[2] | (src[3] << 8);
+	uint32_t palette[4];
+	palette[0] = Expand565(c0) | 0xFF000000;
+	palette[1] = Expand565(c1) | 0xFF000000;
+	uint8_t* p0 = (uint8_t*)&palette[0];
+	uint8_t* p1 = (uint8_t*)&palette[1];
+	uint8_t* p2 = (uint8_t*)&palette[2];
+	uint8_t* p3 = (uint8_t*)&palette[3];
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		if (c0 > c1)
+		{
+			p2[c] = (uint8_t)((2 * p0[c] + p1[c]) / 3);
+			p3[c] = (uint8_t)((p0[c] + 2 * p1[c]) / 3);
+		}
+		else
+		{
+			p2[c] = (uint8_t)((p0[c] + p1[c]) / 2);
+			p3[c] = 0;
+		}
+	}
+	p2[3] = 255;
+	p3[3] = (c0 > c1) ? 255 : 0;
+
+	uint32_t indices = src[4] | (src[5] << 8) | (src[6] << 16) | ((uint32_t)src[7] << 24);
+	for (uint32_t i = 0; i < 16; i++)
+		block[i] = palette[(indices >> (2 * i)) & 3];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BC7, mode 6 only: one subset, rgba endpoints of 7 bits with a p-bit each, 4 bit indices
+////////////////////////////////////////////////////////////////////////////////
+static inline __m128 UnpackTexel(uint32_t texel)
+{
+	__m128i v = _mm_cvtsi32_si128((int)texel);
+	v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, _mm_setzero_si128()), _mm_setzero_si128());
+	return _mm_cvtepi32_ps(v);
+}
+
+static inline float Dot4(__m128 a, __m128 b)
+{
+	__m128 m = _mm_mul_ps(a, b);
+	m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+	m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(m);
+}
+
+// Quantizes an endpoint to 7 bits per channel, the shared p-bit is the one with the smaller error
+static void QuantizeEndpointBC7(__m128 endpoint, uint32_t* quantized, uint32_t* pbit)
+{
+	float e[4];
+	_mm_storeu_ps(e, _mm_min_ps(_mm_max_ps(endpoint, _mm_setzero_ps()), _mm_set1_ps(255.0f)));
+	float bestError = 1e30f;
+	for (uint32_t p = 0; p < 2; p++)
+	{
+		uint32_t q[4];
+		float error = 0.0f;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			int32_t v = (int32_t)((e[c] - p) * 0.5f + 0.5f);
+			q[c] = (uint32_t)std::min(std::max(v, 0), 127);
+			float d = (float)((q[c] << 1) | p) - e[c];
+			error += d * d;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(quantized, q, sizeof(q));
+			*pbit = p;
+		}
+	}
+}
+
+// Picks the nearest of the 16 interpolated colors for every texel, returns the squared error of the block
+static float FindIndicesBC7(const __m128* texels, const uint32_t* q0, uint32_t p0, const uint32_t* q1, uint32_t p1, uint8_t* indices)
+{
+	__m128 palette[16];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t c[4];
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			uint32_t e0 = (q0[k] << 1) | p0, e1 = (q1[k] << 1) | p1;
+			c[k] = ((64 - g_bc7Weights[i]) * e0 + g_bc7Weights[i] * e1 + 32) >> 6;
+		}
+		palette[i] = _mm_setr_ps((float)c[0], (float)c[1], (float)c[2], (float)c[3]);
+	}
+
+	//the palette lies on a line, only the neighbours of the projection are tested
+	__m128 axis = _mm_sub_ps(palette[15], palette[0]);
+	float axisLength = Dot4(axis, axis);
+	float scale = axisLength > 0.0f ? 15.0f / axisLength : 0.0f;
+	float totalError = 0.0f;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		int32_t guess = (int32_t)(Dot4(_mm_sub_ps(texels[i], palette[0]), axis) * scale + 0.5f);
+		guess = std::min(std::max(guess, 0), 15);
+		float bestError = 1e30f;
+		for (int32_t k = std::max(guess - 1, 0); k <= std::min(guess + 1, 15); k++)
+		{
+			__m128 d = _mm_sub_ps(texels[i], palette[k]);
+			float error = Dot4(d, d);
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = (uint8_t)k;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+static void CompressBlockBC7(uint8_t* dst, const uint32_t* block)
+{
+	__m128 texels[16];
+	__m128 mean = _mm_setzero_ps();
+	__m128 minTexel = _mm_set1_ps(255.0f);
+	__m128 maxTexel = _mm_setzero_ps();
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		texels[i] = UnpackTexel(block[i]);
+		mean = _mm_add_ps(mean, texels[i]);
+		minTexel = _mm_min_ps(minTexel, texels[i]);
+		maxTexel = _mm_max_ps(maxTexel, texels[i]);
+	}
+	mean = _mm_mul_ps(mean, _mm_set1_ps(1.0f / 16.0f));
+
+	//principal axis of the colors, a few power iterations on the covariance starting at the bounding box diagonal
+	__m128 covariance[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		__m128 d = _mm_sub_ps(texels[i], mean);
+		covariance[0] = _mm_add_ps(covariance[0], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(0, 0, 0, 0))));
+		covariance[1] = _mm_add_ps(covariance[1], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1))));
+		covariance[2] = _mm_add_ps(covariance[2], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2))));
+		covariance[3] = _mm_add_ps(covariance[3], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3))));
+	}
+	__m128 axis = _mm_sub_ps(maxTexel, minTexel);
+	for (uint32_t n = 0; n < 4; n++)
+	{
+		float a[4];
+		_mm_storeu_ps(a, axis);
+		axis = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(covariance[0], _mm_set1_ps(a[0])), _mm_mul_ps(covariance[1], _mm_set1_ps(a[1]))),
+			_mm_add_ps(_mm_mul_ps(covariance[2], _mm_set1_ps(a[2])), _mm_mul_ps(covariance[3], _mm_set1_ps(a[3]))));
+		float length = Dot4(axis, axis);
+		if (length < 1e-8f)
+			break;
+		axis = _mm_mul_ps(axis, _mm_set1_ps(1.0f / sqrtf(length)));
+	}
+	if (Dot4(axis, axis) < 1e-8f)
+		axis = _mm_setzero_ps();	// Single color
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float t = Dot4(_mm_sub_ps(texels[i], mean), axis);
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	__m128 e0 = _mm_add_ps(mean, _mm_mul_ps(axis, _mm_set1_ps(minT)));
+	__m128 e1 = _mm_add_ps(mean, _mm_mul_ps(axis, _mm_set1_ps(maxT)));
+
+	uint32_t q0[4], q1[4], p0, p1;
+	uint8_t indices[16];
+	QuantizeEndpointBC7(e0, q0, &p0);
+	QuantizeEndpointBC7(e1, q1, &p1);
+	float error = FindIndicesBC7(texels, q0, p0, q1, p1, indices);
+
+	//least squares fit of the endpoints to the chosen indices, kept when it lowers the error
+	float a = 0.0f, b = 0.0f, c = 0.0f;
+	__m128 x = _mm_setzero_ps(), y = _mm_setzero_ps();
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float w = g_bc7Weights[indices[i]] / 64.0f;
+		a += (1.0f - w) * (1.0f - w);
+		b += (1.0f - w) * w;
+		c += w * w;
+		x = _mm_add_ps(x, _mm_mul_ps(texels[i], _mm_set1_ps(1.0f - w)));
+		y = _mm_add_ps(y, _mm_mul_ps(texels[i], _mm_set1_ps(w)));
+	}
+	float det = a * c - b * b;
+	if (det > 1e-6f)
+	{
+		__m128 invDet = _mm_set1_ps(1.0f / det);
+		__m128 f0 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(x, _mm_set1_ps(c)), _mm_mul_ps(y, _mm_set1_ps(b))), invDet);
+		__m128 f1 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(y, _mm_set1_ps(a)), _mm_mul_ps(x, _mm_set1_ps(b))), invDet);
+		uint32_t fq0[4], fq1[4], fp0, fp1;
+		uint8_t fitIndices[16];
+		QuantizeEndpointBC7(f0, fq0, &fp0);
+		QuantizeEndpointBC7(f1, fq1, &fp1);
+		if (FindIndicesBC7(texels, fq0, fp0, fq1, fp1, fitIndices) < error)
+		{
+			memcpy(q0, fq0, sizeof(q0));
+			memcpy(q1, fq1, sizeof(q1));
+			p0 = fp0;
+			p1 = fp1;
+			memcpy(indices, fitIndices, sizeof(indices));
+		}
+	}
+
+	//the first index has an implicit high bit of 0, swap the endpoints when it is set
+	if (indices[0] & 8)
+	{
+		std::swap(q0, q1);
+		std::swap(p0, p1);
+		for (uint32_t i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	uint64_t bits[2] = { 0, 0 };
+	uint32_t pos = 0;
+	WriteBits(bits, &pos, 1 << 6, 7);	// Mode 6
+	for (uint32_t k = 0; k < 4; k++)
+	{
+		WriteBits(bits, &pos, q0[k], 7);
+		WriteBits(bits, &pos, q1[k], 7);
+	}
+	WriteBits(bits, &pos, p0, 1);
+	WriteBits(bits, &pos, p1, 1);
+	WriteBits(bits, &pos, indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++)
+		WriteBits(bits, &pos, indices[i], 4);
+	memcpy(dst, bits, 16);
+}
+
+static void DecompressBlockBC7(uint32_t* block, const uint8_t* src)
+{
+	uint64_t bits[2];
+	memcpy(bits, src, 16);
+	if ((bits[0] & 0x7F) != (1 << 6))
+	{
+		memset(block, 0, 16 * sizeof(uint32_t));	// Not mode 6
+		return;
+	}
+
+	uint32_t pos = 7;
+	uint32_t e0[4], e1[4];
+	for (uint32_t k = 0; k < 4; k++)
+	{
+		e0[k] = ReadBits(bits, &pos, 7) << 1;
+		e1[k] = ReadBits(bits, &pos, 7) << 1;
+	}
+	uint32_t p0 = ReadBits(bits, &pos, 1);
+	uint32_t p1 = ReadBits(bits, &pos, 1);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t index = ReadBits(bits, &pos, i ? 4 : 3);
+		uint32_t texel = 0;
+		for (uint32_t k = 0; k < 4; k++)
+			texel |= (((64 - g_bc7Weights[index]) * (e0[k] | p0) + g_bc7Weights[index] * (e1[k] | p1) + 32) >> 6) << (8 * k);
+		block[i] = texel;
+	}
+}
+
+void CompressImageLevel(uint32_t format, const uint32_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+{
+	if (format == IMAGE_FORMAT_RGBA8)
+	{
+		memcpy(dst, src, GetImageLevelSize(format, width, height));
+		return;
+	}
+
+	uint32_t block[16];
+	for (uint32_t by = 0; by < height; by += 4)
+	{
+		for (uint32_t bx = 0; bx < width; bx += 4)
+		{
+			LoadBlock(block, src, width, height, bx, by);
+			switch (format)
+			{
+			case IMAGE_FORMAT_BC1:
+				CompressBlockBC1(dst, block);
+				break;
+			case IMAGE_FORMAT_BC4:
+				CompressChannelBlock(dst, block, 0);
+				break;
+			case IMAGE_FORMAT_BC5:
+				CompressChannelBlock(dst, block, 0);
+				CompressChannelBlock(dst + 8, block, 1);
+				break;
+			case IMAGE_FORMAT_BC7:
+				CompressBlockBC7(dst, block);
+				break;
+			}
+			dst += g_blockSizes[format];
+		}
+	}
+}
+
+void DecompressImageLevel(uint32_t format, const uint8_t* src, uint32_t width, uint32_t height, uint32_t* dst)
+{
+	if (format == IMAGE_FORMAT_RGBA8)
+	{
+		memcpy(dst, src, GetImageLevelSize(format, width, height));
+		return;
+	}
+
+	//decoded like the GPU does, missing channels are 0 and alpha is opaque
+	uint32_t block[16];
+	uint8_t red[16], green[16];
+	for (uint32_t by = 0; by < height; by += 4)
+	{
+		for (uint32_t bx = 0; bx < width; bx += 4)
+		{
+			switch (format)
+			{
+			case IMAGE_FORMAT_BC1:
+				DecompressBlockBC1(block, src);
+				break;
+			case IMAGE_FORMAT_BC4:
+				DecompressChannelBlock(red, src);
+				for (uint32_t i = 0; i < 16; i++)
+					block[i] = red[i] | 0xFF000000;
+				break;
+			case IMAGE_FORMAT_BC5:
+				DecompressChannelBlock(red, src);
+				DecompressChannelBlock(green, src + 8);
+				for (uint32_t i = 0; i < 16; i++)
+					block[i] = red[i] | (green[i] << 8) | 0xFF000000;
+				break;
+			case IMAGE_FORMAT_BC7:
+				DecompressBlockBC7(block, src);
+				break;
+			}
+			StoreBlock(dst, block, width, height, bx, by);
+			src += g_blockSizes[format];
+		}
+	}
+}
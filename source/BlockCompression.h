@@ -0,0 +1,26 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <stdint.h>
+
+// Formats of the pixel data of an image asset, stored in image_desc_s
+enum ImageFormat
+{
+	IMAGE_FORMAT_RGBA8 = 0,
+	IMAGE_FORMAT_BC1 = 1,		//rgb, 8 bytes per 4x4 block
+	IMAGE_FORMAT_BC4 = 2,		//red, 8 bytes per 4x4 block
+	IMAGE_FORMAT_BC5 = 3,		//red and green, 16 bytes per 4x4 block
+	IMAGE_FORMAT_BC7 = 4,		//rgba, 16 bytes per 4x4 block
+
+	IMAGE_FORMAT_COUNT
+};
+
+// Bytes of one mip level
+uint64_t GetImageLevelSize(uint32_t format, uint32_t width, uint32_t height);
+// Encodes one rgba8 mip level, blocks over the edge repeat the last row and column
+void CompressImageLevel(uint32_t format, const uint32_t* src, uint32_t width, uint32_t height, uint8_t* dst);
+// Decodes one mip level to rgba8, for devices without block compression support.
+// Only the BC7 mode written by CompressImageLevel is decoded, other modes decode to black
+void DecompressImageLevel(uint32_t format, const uint8_t* src, uint32_t width, uint32_t height, uint32_t* dst);
+
+#endif	//BLOCKCOMPRESSION_H
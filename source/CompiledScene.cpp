@@ -0,0 +1,164 @@
+#include "CompiledScene.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "AssetManager.h"
+#include "io.h"
+
+extern void LoadAssetStaticManager(char* path, uint32_t pathLenght);
+
+uint32_t GetCompiledScenePath(const char* sourcePath, char* outPath, uint32_t outPathSize)
+{
+	uint32_t length = (uint32_t)strlen(sourcePath);
+	for (uint32_t i = length; i > 0; i--)
+	{
+		if (sourcePath[i - 1] == '/' || sourcePath[i - 1] == '\\')
+			break;
+		if (sourcePath[i - 1] == '.')
+		{
+			length = i - 1;
+			break;
+		}
+	}
+
+	uint32_t extensionLength = (uint32_t)strlen(CVSCENE_EXTENSION);
+	if (length + extensionLength >= outPathSize)
+		return 0;
+	memcpy(outPath, sourcePath, length);
+	memcpy(outPath + length, CVSCENE_EXTENSION, extensionLength + 1);
+	return length + extensionLength;
+}
+
+int32_t WriteCompiledScene(const char* path, const scene_s* scene, uint64_t sceneSize, const void* sourceData, uint64_t sourceLength, uint64_t sourceTimestamp)
+{
+	char tmpPath[512];
+	if (snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path) >= (int)sizeof(tmpPath))
+		return -1;	// Path too long
+
+	FILE* file = fopen(tmpPath, "wb");
+	if (!file)
+		return -2;	// Could not create the file
+
+	CompiledSceneHeader header = {};
+	header.magicNumber = CVSCENE_MAGIC;
+	header.version = CVSCENE_VERSION;
+	header.sceneSize = sceneSize;
+	header.sourceLength = sourceLength;
+	header.sourceTimestamp = sourceTimestamp;
+	header.sourceHash = HashAssetContent(sourceData, sourceLength);
+
+	size_t written = fwrite(&header, sizeof(header), 1, file);
+	written += fwrite(scene, (size_t)sceneSize, 1, file);
+	fclose(file);
+	if (written != 2)
+	{
+		remove(tmpPath);
+		return -3;	// Could not write the scene
+	}
+
+	if (replace_file(tmpPath, path) != 0)
+	{
+		remove(tmpPath);
+		return -4;	// Could not replace the old scene
+	}
+	return 0;
+}
+
+uint32_t IsCompiledSceneCurrent(const char* path, const char* sourcePath)
+{
+	MappedFile compiledFile;
+	if (readonly_mapped_file_open(&compiledFile, path, MAPPED_FILE_RANDOM) != 0)
+		return 0;	// Not imported yet
+
+	const void* compiledData;
+	uint64_t compiledSize;
+	readonly_mapped_file_get_data(&compiledFile, (void**)&compiledData, &compiledSize);
+	CompiledSceneHeader header = {};
+	if (compiledSize >= sizeof(header))
+		memcpy(&header, compiledData, sizeof(header));
+	readonly_mapped_file_close(&compiledFile);
+	if (header.magicNumber != CVSCENE_MAGIC || header.version != CVSCENE_VERSION || compiledSize < sizeof(header) + header.sceneSize)
+		return 0;
+
+	MappedFile sourceFile;
+	if (readonly_mapped_file_open(&sourceFile, sourcePath, MAPPED_FILE_RANDOM) != 0)
+		return 1;	// No source to import from
+
+	const void* sourceData;
+	uint64_t sourceLength, sourceTimestamp;
+	readonly_mapped_file_get_data(&sourceFile, (void**)&sourceData, &sourceLength);
+	readonly_mapped_file_get_change_timestamp(&sourceFile, &sourceTimestamp);
+	// Timestamps differ after a fresh checkout or copy, the content is hashed then
+	uint32_t current = header.sourceLength == sourceLength &&
+		(header.sourceTimestamp == sourceTimestamp || header.sourceHash == HashAssetContent(sourceData, sourceLength));
+	readonly_mapped_file_close(&sourceFile);
+
+	// Store the new timestamp, so the next start does not hash the source again
+	if (current && header.sourceTimestamp != sourceTimestamp)
+	{
+		header.sourceTimestamp = sourceTimestamp;
+		FILE* file = fopen(path, "r+b");
+		if (file)
+		{
+			fwrite(&header, sizeof(header), 1, file);
+			fclose(file);
+		}
+	}
+
+	return current;
+}
+
+void RequestSceneTextures(const scene_s* scene, const char* basePath, uint32_t basePathLength)
+{
+	char buffer[512];
+	memcpy(buffer, basePath, basePathLength);
+
+	for (uint32_t i = 0; i < scene->textureCount; i++)
+	{
+		const char* texturePath = scene->stringData + scene->textures[i].pathOffset;
+		uint32_t texturePathLength = (uint32_t)strlen(texturePath);
+		uint32_t pathLength = basePathLength + texturePathLength;
+
+		assert(pathLength < sizeof(buffer));
+		memcpy(buffer + basePathLength, texturePath, texturePathLength);
+		buffer[pathLength] = '\0';
+
+		LoadAssetStaticManager(buffer, pathLength);
+	}
+}
+
+uint32_t ConvertAsset_CompiledScene
+(
+	asset_s* outAsset,
+	const void* data,
+	uint64_t dataSizeInBytes,
+	const char* basePath,
+	uint32_t basePathLength,
+	Memory_Linear_Allocator* allocator,
+	uint32_t allocatorIdx
+)
+{
+	const CompiledSceneHeader* header = (const CompiledSceneHeader*)data;
+	if (dataSizeInBytes < sizeof(CompiledSceneHeader) || header->magicNumber != CVSCENE_MAGIC)
+		return 1;	// Not a compiled scene
+	if (header->version != CVSCENE_VERSION)
+		return 2;	// Compiled by another version, import the source again
+	if (header->sceneSize < sizeof(scene_s) || dataSizeInBytes < sizeof(CompiledSceneHeader) + header->sceneSize)
+		return 3;	// Truncated
+
+	// The scene is stored as it is used, one copy into the arena and no parsing. The mapping is closed once the converter
+	// returns, and on Windows an open mapping would keep the importer from replacing the file on hot reload. The copy is
+	// the asset the cache stores, warm starts use the scene in the mapped cache in place
+	uint8_t* memory = (uint8_t*)AllocateVirtualMemory(ALLOCATOR_IDX_ASSET_DATA, allocator, header->sceneSize);
+	memcpy(memory, header + 1, (size_t)header->sceneSize);
+
+	outAsset->type = 'OGEX';
+	outAsset->size = header->sceneSize;
+	outAsset->data = memory;
+
+	RequestSceneTextures((const scene_s*)memory, basePath, basePathLength);
+
+	return 0;
+}
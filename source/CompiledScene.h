@@ -0,0 +1,35 @@
+#ifndef COMPILEDSCENE_H
+#define COMPILEDSCENE_H
+
+#include <stdint.h>
+#include "DataTypes.h"
+
+// Binary scene, written by the OpenGEX importer next to the text file it was imported from.
+// The file is a header followed by the scene_s asset exactly as the importer lays it out in memory,
+// every pointer in it is self-relative. Loading it needs no parsing, the mapped file is the scene.
+// Bump the version whenever scene_s or one of its arrays changes layout, or the importer changes what it writes.
+#define CVSCENE_MAGIC 'CVSC'
+#define CVSCENE_VERSION 5
+#define CVSCENE_EXTENSION ".cvscene"
+
+struct CompiledSceneHeader
+{
+	uint32_t magicNumber;
+	uint32_t version;
+	uint64_t sceneSize;			//bytes of the scene following the header
+	uint64_t sourceLength;		//size, change time and content hash of the file the scene was imported from
+	uint64_t sourceTimestamp;
+	uint64_t sourceHash;
+};
+
+// Path of the compiled scene of a source scene, the extension replaced. Returns the length, 0 when it does not fit
+uint32_t GetCompiledScenePath(const char* sourcePath, char* outPath, uint32_t outPathSize);
+// Writes the scene through a temporary file, a running application only sees the complete file
+int32_t WriteCompiledScene(const char* path, const scene_s* scene, uint64_t sceneSize, const void* sourceData, uint64_t sourceLength, uint64_t sourceTimestamp);
+// 1 when the compiled scene can be loaded, 0 when it has to be imported from its source again.
+// The source is only hashed when its timestamp changed. Without the source the compiled scene is always used
+uint32_t IsCompiledSceneCurrent(const char* path, const char* sourcePath);
+// Loads the textures of the scene, their paths are relative to the scene file
+void RequestSceneTextures(const scene_s* scene, const char* basePath, uint32_t basePathLength);
+
+#endif	//COMPILEDSCENE_H
@@ -33,10 +33,7 @@ void BuildCommandBufferConeTracerState(
 	////////////////////////////////////////////////////////////////////////////////
 	// Rebuild the command buffers
 	////////////////////////////////////////////////////////////////////////////////
-	renderState->m_commandBufferCount = framebufferCount;
-	renderState->m_commandBuffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer)*renderState->m_commandBufferCount);
-	for (uint32_t i = 0; i < renderState->m_commandBufferCount; i++)
-		renderState->m_commandBuffers[i] = VKTools::Initializers::CreateCommandBuffer(commandpool, device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+	AcquireCommandBuffers(*renderState, commandpool, device, framebufferCount);
 	
 	////////////////////////////////////////////////////////////////////////////////
 	// Record command buffer
@@ -168,7 +165,7 @@ void CreateConeTraceState(
 		renderState.m_descriptorLayoutCount = 1;
 		renderState.m_descriptorLayouts = (VkDescriptorSetLayout*)malloc(sizeof(VkDescriptorSetLayout)*renderState.m_descriptorLayoutCount);
 		//dynamic descriptorset
-		VkDescriptorSetLayoutBinding layoutBinding[FORWARDRENDER_DESCRIPTOR_COUNT];
+		VkDescriptorSetLayoutBinding layoutBinding[CONETRACER_DESCRIPTOR_COUNT];
 		// Binding 0 : diffuse texture sampled image
 		layoutBinding[CONETRACER_DESCRIPTOR_VOXELGRID] =
 		{ CONETRACER_DESCRIPTOR_VOXELGRID, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL };
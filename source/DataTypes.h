@@ -1,6 +1,8 @@
 #ifndef DATATYPES_H
 #define DATATYPES_H
 
+#include <stdint.h>
+#include <stddef.h>
 #include <glm/glm.hpp>
 #include <vulkan.h>
 
@@ -13,6 +15,28 @@ class SwapChain;
 
 enum VoxelDirections { POSX, NEGX, POSY, NEGY, POSZ, NEGZ, NUM_DIRECTIONS };
 
+// Self-relative pointer, stores the distance from its own address to the target.
+// Used inside asset data, so the asset cache can be mapped at any address and used in place.
+// Copying re-bases the offset to the new location, an offset of 0 is a null pointer.
+template<typename T>
+struct rel_ptr
+{
+	int64_t offset;
+
+	rel_ptr() : offset(0) {}
+	rel_ptr(const rel_ptr& other) { Set(other.Get()); }
+	rel_ptr& operator=(const rel_ptr& other) { Set(other.Get()); return *this; }
+	rel_ptr& operator=(T* ptr) { Set(ptr); return *this; }
+
+	inline T* Get() const { return offset ? (T*)((const uint8_t*)this + offset) : NULL; }
+	inline void Set(T* ptr) { offset = ptr ? (int64_t)((const uint8_t*)ptr - (const uint8_t*)this) : 0; }
+
+	inline operator T*() const { return Get(); }
+	inline T* operator->() const { return Get(); }
+	inline T* operator++(int) { T* ptr = Get(); Set(ptr + 1); return ptr; }
+	inline rel_ptr& operator+=(ptrdiff_t count) { Set(Get() + count); return *this; }
+};
+
 struct mesh_s
 {
 	uint32_t primitiveType;
@@ -27,7 +51,7 @@ struct model_ref_s
 {
 	uint64_t nameOffset;
 	uint32_t modelIndex;
-	uint32_t* materialIndices;
+	rel_ptr<uint32_t> materialIndices;
 	uint32_t materialIndexCount;
 	glm::mat4 transform;
 };
@@ -83,6 +107,16 @@ struct directional_light_s
 	uint32_t flags;
 };
 
+// Types of the elements of a vertex buffer. The importer packs the attributes, the normalized types are read as floats by the shaders
+enum
+{
+	VERTEX_BUFFER_ELEMENT_TYPE_HALF,
+	VERTEX_BUFFER_ELEMENT_TYPE_FLOAT,
+	VERTEX_BUFFER_ELEMENT_TYPE_DOUBLE,
+	VERTEX_BUFFER_ELEMENT_TYPE_UNORM16,
+	VERTEX_BUFFER_ELEMENT_TYPE_SNORM16
+};
+
 struct vertex_buffer_s
 {
 	uint32_t elementType;
@@ -102,27 +136,32 @@ struct index_buffer_s
 	uint64_t totalSize;
 };
 
+enum SceneVertexFlags
+{
+	SCENE_VERTEX_QUANTIZED_POSITIONS = 1 << 0,	//positions are 4 unorm16, quantized to the bounds of the scene
+};
+
 struct scene_s
 {
-	model_s* models;
-	mesh_s* meshes;
-	material_s* materials;
-	vertex_buffer_s* vertexBuffers;
-	index_buffer_s* indexBuffers;
-	model_ref_s* modelRefs;
-	texture_s* textures;
-	texture_ref_s* textureRefs;
-	spot_light_s* spotLights;
-	point_light_s* pointLights;
-	directional_light_s* directionalLights;
-
-	uint32_t* materialIndices;
+	rel_ptr<model_s> models;
+	rel_ptr<mesh_s> meshes;
+	rel_ptr<material_s> materials;
+	rel_ptr<vertex_buffer_s> vertexBuffers;
+	rel_ptr<index_buffer_s> indexBuffers;
+	rel_ptr<model_ref_s> modelRefs;
+	rel_ptr<texture_s> textures;
+	rel_ptr<texture_ref_s> textureRefs;
+	rel_ptr<spot_light_s> spotLights;
+	rel_ptr<point_light_s> pointLights;
+	rel_ptr<directional_light_s> directionalLights;
+
+	rel_ptr<uint32_t> materialIndices;
 	//uint32_t* meshIndices;
 	//uint64_t* materialStringOffsets;
 
-	uint8_t* vertexData;
-	uint8_t* indexData;
-	const char* stringData;
+	rel_ptr<uint8_t> vertexData;
+	rel_ptr<uint8_t> indexData;
+	rel_ptr<const char> stringData;
 
 	uint64_t vertexDataSizeInBytes;
 	uint64_t indexDataSizeInBytes;
@@ -143,27 +182,50 @@ struct scene_s
 	uint32_t spotLightCount;
 	uint32_t pointLightCount;
 	uint32_t directionalLightCount;
+
+	uint32_t vertexFlags;		//SceneVertexFlags
+	float positionScale[3];		//stored positions are decoded as position * scale + bias
+	float positionBias[3];
 };
 
 struct asset_s
 {
 	uint64_t type;
 	uint64_t size;
-	uint8_t* data;
+	rel_ptr<uint8_t> data;
 };
 
 struct AssetDescriptor
 {
 	char name[512];
 	asset_s asset;
+	float loadTime;			//milliseconds the load job took, conversion or cache lookup
+	int32_t loadResult;		//return code of AssetManager::ExecuteLoad
 };
 
+// Version 7 of the cache, all pointers stored in the cache are self-relative. Images store their whole mip chain and format,
+// scenes their packed vertex attributes.
+// The file is a journal: a header followed by segments, every flush appends one segment.
+// Entries of later segments supersede entries of the same path in earlier segments.
+// Entries with identical converted data point to the same blob.
+#define ASSETCACHE_MAGIC 'RAC7'
+#define ASSETCACHE_ALIGNMENT 16
+
 struct AssetCacheHeader
 {
 	uint32_t magicNumber;
+	uint32_t segmentCount;
+	uint64_t entryCount;		//entries over all segments, including superseded ones
+	uint64_t committedSize;		//bytes of the file covered by complete segments, anything behind is an unfinished append
+	uint64_t reserved;
+};
+
+struct AssetCacheSegment
+{
 	uint64_t entryCount;
 	uint64_t assetBlobSize;
 	uint64_t dependencyBlobSize;
+	uint64_t segmentSize;		//segment header, entries and blobs, padded to ASSETCACHE_ALIGNMENT
 };
 
 struct CacheEntry
@@ -172,7 +234,8 @@ struct CacheEntry
 	uint64_t timestamp;
 	uint64_t contentHash;
 	uint64_t contentLength;
-	const char* dependenciesStart;
+	uint64_t assetHash;			//hash of the converted data, assets with the same data share it
+	rel_ptr<const char> dependenciesStart;
 	uint32_t dependencyCount;
 	asset_s asset;
 };
@@ -198,7 +261,8 @@ struct mip_desc_s
 struct image_desc_s
 {
 	uint32_t width, height, mipCount;
-	mip_desc_s* mips;
+	uint32_t format;		//ImageFormat of the pixel data, see BlockCompression.h
+	rel_ptr<mip_desc_s> mips;
 };
 
 struct vk_ib_s
@@ -241,8 +305,13 @@ struct vk_texture_s
 	VkImageLayout			imageLayout;
 	VkImageView*			view;
 	VkDescriptorImageInfo*	descriptor;
-	//VkFormat				format;
+	VkFormat				format;
 	VkDeviceMemory			deviceMemory;
+	uint32_t				baseMip;			//first mip of the image asset held by the image, the mips above it are not resident
+	uint32_t				streamed;			//the resident mips change with the texture budget
+	uint64_t				residentBytes;		//pixel data of the resident mips
+	const void*				content;			//image asset data the texture is created from, identical images share the data
+	uint32_t				referenceCount;		//texture reference slots sampling the texture
 	TextureMipMapperUBOComp*	ubo;
 	UniformData*			uboDescriptor;
 };
@@ -252,8 +321,7 @@ enum VertexOffset
 	ATTRIBUTE_POSITION,
 	ATTRIBUTE_TEXCOORD,
 	ATTRIBUTE_NORMAL,
-	ATTRIBUTE_TANGENT,
-	ATTRIBUTE_BITANGENT,
+	ATTRIBUTE_TANGENT,		//the bitangent is rebuilt from the normal and the sign stored with the tangent
 
 	ATTRIBUTE_COUNT
 };
@@ -309,6 +377,8 @@ struct CVCTSettings
 	uint32_t currentSide = VoxelDirections::POSX;
 	uint32_t conecount;
 	uint32_t deferredRender = 0;
+	uint32_t textureBudget;		// Texture memory the streaming may use, in MB
+	uint32_t textureMemory;		// Texture memory in use, in MB
 };
 
 struct RenderStatesTimeStamps
@@ -15,6 +15,11 @@ struct Parameter
 	float scale;
 };
 
+struct PushConstantFrag
+{
+	uint32_t textureIndex[TEXTURE_NUM];	// Material textures in the static texture array
+};
+
 void BuildCommandBufferDeferredMainRenderState(
 	RenderState* renderstate,
 	VkCommandPool commandpool,
@@ -41,10 +46,7 @@ void BuildCommandBufferDeferredMainRenderState(
 	////////////////////////////////////////////////////////////////////////////////
 	// Rebuild the command buffers
 	////////////////////////////////////////////////////////////////////////////////
-	renderState->m_commandBufferCount = framebufferCount;
-	renderState->m_commandBuffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer)*renderState->m_commandBufferCount);
-	for (uint32_t i = 0; i < renderState->m_commandBufferCount; i++)
-		renderState->m_commandBuffers[i] = VKTools::Initializers::CreateCommandBuffer(commandpool, core->GetViewDevice(), VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+	AcquireCommandBuffers(*renderState, commandpool, core->GetViewDevice(), framebufferCount);
 
 	////////////////////////////////////////////////////////////////////////////////
 	// Record command buffer
@@ -109,7 +111,6 @@ void BuildCommandBufferDeferredMainRenderState(
 		// Bind descriptor sets describing shader binding points
 		uint32_t doffset = 0;
 		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 0, 1, &staticDescriptorSet, 1, &doffset);
-		uint32_t d = 0;
 		for (uint32_t m = 0; m < meshCount; m++)
 		{
 			//select the current mesh
@@ -118,52 +119,8 @@ void BuildCommandBufferDeferredMainRenderState(
 			vkCmdBindVertexBuffers(renderState->m_commandBuffers[i], 0, mesh->vbvCount, mesh->vertexResources, mesh->vertexOffsets);
 			for (uint32_t j = 0; j < mesh->submeshCount; j++)
 			{
-				//TODO: BIND new descriptorset
-				VkDescriptorSet descriptorset = renderState->m_descriptorSets[(i*DYNAMIC_DESCRIPTOR_SET_COUNT) + d++ +2];
-
-				//bind the textures to the correct format
-				//format: stype,pnext,scSet,srcBinding,srcArrayelement,dstSet,dstbinding,dstarrayelement,descriptorcount
-				VkCopyDescriptorSet textureDescriptorSets[TEXTURE_NUM];
-				//diffuse texture
-				VkCopyDescriptorSet diffuse;
-				diffuse.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				diffuse.pNext = NULL;
-				diffuse.srcSet = staticDescriptorSet;
-				diffuse.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				diffuse.srcArrayElement = mesh->submeshes[j].textureIndex[DIFFUSE_TEXTURE];
-				diffuse.dstSet = descriptorset;
-				diffuse.dstBinding = FORWARDRENDER_DESCRIPTOR_IMAGE_DIFFUSE;
-				diffuse.dstArrayElement = 0;
-				diffuse.descriptorCount = 1;
-				textureDescriptorSets[DIFFUSE_TEXTURE] = diffuse;
-				//normal texture
-				VkCopyDescriptorSet normal;
-				normal.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				normal.pNext = NULL;
-				normal.srcSet = staticDescriptorSet;
-				normal.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				normal.srcArrayElement = mesh->submeshes[j].textureIndex[NORMAL_TEXTURE];
-				normal.dstSet = descriptorset;
-				normal.dstBinding = FORWARDRENDER_DESCRIPTOR_IMAGE_NORMAL;
-				normal.dstArrayElement = 0;
-				normal.descriptorCount = 1;
-				textureDescriptorSets[NORMAL_TEXTURE] = normal;
-				//opacity teture
-				VkCopyDescriptorSet opacity;
-				opacity.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				opacity.pNext = NULL;
-				opacity.srcSet = staticDescriptorSet;
-				opacity.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				opacity.srcArrayElement = (uint32_t)mesh->submeshes[j].textureIndex[OPACITY_TEXTURE];
-				opacity.dstSet = descriptorset;
-				opacity.dstBinding = FORWARDRENDER_DESCRIPTOR_IMAGE_OPACITY;
-				opacity.dstArrayElement = 0;
-				opacity.descriptorCount = 1;
-				textureDescriptorSets[OPACITY_TEXTURE] = opacity;
-				// Update the descriptors
-				vkUpdateDescriptorSets(core->GetViewDevice(), 0, NULL, (uint32_t)TEXTURE_NUM, textureDescriptorSets);
-				// Bind descriptor sets describing shader binding points
-				vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 1, 1, &descriptorset, 0, NULL);
+				// Select the material textures of the submesh
+				vkCmdPushConstants(renderState->m_commandBuffers[i], renderState->m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantFrag), mesh->submeshes[j].textureIndex);
 				// Bind triangle indices
 				vkCmdBindIndexBuffer(renderState->m_commandBuffers[i], mesh->submeshes[j].ibv.buffer, mesh->submeshes[j].ibv.offset, mesh->submeshes[j].ibv.format);
 				// Draw indexed triangle
@@ -189,7 +146,7 @@ void BuildCommandBufferDeferredMainRenderState(
 		scissor.offset.y = 0;
 		vkCmdSetScissor(renderState->m_commandBuffers[i], 0, 1, &scissor);
 		vkCmdBindPipeline(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderstate->m_pipelines[2]);
-		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 2, 1, &renderState->m_descriptorSets[0], 0, NULL);
+		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 1, 1, &renderState->m_descriptorSets[0], 0, NULL);
 		vkCmdDraw(renderState->m_commandBuffers[i], 3, 1, 0, 0);
 
 		// renderpass three
@@ -228,7 +185,6 @@ void BuildCommandBufferDeferredMainRenderState(
 		vkCmdClearAttachments(renderState->m_commandBuffers[i], 6, at, 1, &clearrect);
 
 		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 0, 1, &staticDescriptorSet, 1, &doffset);
-		d = 0;
 		for (uint32_t m = 0; m < meshCount; m++)
 		{
 			//select the current mesh
@@ -237,8 +193,8 @@ void BuildCommandBufferDeferredMainRenderState(
 			vkCmdBindVertexBuffers(renderState->m_commandBuffers[i], 0, mesh->vbvCount, mesh->vertexResources, mesh->vertexOffsets);
 			for (uint32_t j = 0; j < mesh->submeshCount; j++)
 			{
-				// Bind descriptor sets describing shader binding points
-				vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 1, 1, &renderState->m_descriptorSets[(i*DYNAMIC_DESCRIPTOR_SET_COUNT) + d++ + 2], 0, NULL);
+				// Select the material textures of the submesh
+				vkCmdPushConstants(renderState->m_commandBuffers[i], renderState->m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantFrag), mesh->submeshes[j].textureIndex);
 				// Bind triangle indices
 				vkCmdBindIndexBuffer(renderState->m_commandBuffers[i], mesh->submeshes[j].ibv.buffer, mesh->submeshes[j].ibv.offset, mesh->submeshes[j].ibv.format);
 				// Draw indexed triangle
@@ -264,8 +220,8 @@ void BuildCommandBufferDeferredMainRenderState(
 		scissor.offset.y = 0;
 		vkCmdSetScissor(renderState->m_commandBuffers[i], 0, 1, &scissor);
 		vkCmdBindPipeline(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderstate->m_pipelines[3]);
-		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 2, 1, &renderState->m_descriptorSets[0], 0, NULL);
-		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 3, 1, &renderState->m_descriptorSets[1], 0, NULL);
+		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 1, 1, &renderState->m_descriptorSets[0], 0, NULL);
+		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 2, 1, &renderState->m_descriptorSets[1], 0, NULL);
 		vkCmdDraw(renderState->m_commandBuffers[i], 3, 1, 0, 0);
 		
 		// Setup query
@@ -564,21 +520,11 @@ extern void CreateDeferredMainRenderState(
 	////////////////////////////////////////////////////////////////////////////////
 	if (!renderState.m_descriptorLayouts)
 	{
-		renderState.m_descriptorLayoutCount = 3;
+		renderState.m_descriptorLayoutCount = 2;
 		renderState.m_descriptorLayouts = (VkDescriptorSetLayout*)malloc(sizeof(VkDescriptorSetLayout)*renderState.m_descriptorLayoutCount);
-		// Dynamic descriptorset
-		VkDescriptorSetLayoutBinding layoutbinding0[DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT];
+		// The textures are indexed in the static descriptorset
 		VkDescriptorSetLayoutBinding layoutbinding1[DEFERRED_MAIN_DESCRIPTOR_PASS_COUNT];
 		VkDescriptorSetLayoutBinding layoutbinding2[1];
-		// Binding 0 : Diffuse texture sampled image
-		layoutbinding0[DEFERRED_MAIN_DESCRIPTOR_IMAGE_DIFFUSE] =
-		{ DEFERRED_MAIN_DESCRIPTOR_IMAGE_DIFFUSE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 1 : Normal texture sampled image
-		layoutbinding0[DEFERRED_MAIN_DESCRIPTOR_IMAGE_NORMAL] =
-		{ DEFERRED_MAIN_DESCRIPTOR_IMAGE_NORMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 2: Opacity texture sampled image
-		layoutbinding0[DEFERRED_MAIN_DESCRIPTOR_IMAGE_OPACITY] =
-		{ DEFERRED_MAIN_DESCRIPTOR_IMAGE_OPACITY, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
 		// Binding 0: Fragment uniform buffer
 		layoutbinding1[DEFERRED_MAIN_DESCRIPTOR_BUFFER_FRAG] =
 		{ DEFERRED_MAIN_DESCRIPTOR_BUFFER_FRAG, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
@@ -603,15 +549,12 @@ extern void CreateDeferredMainRenderState(
 		// Binding 1: Fragment Voxelgrid
 		layoutbinding2[DEFERRED_MAIN_DESCRIPTOR_INPUT] =
 		{ DEFERRED_MAIN_DESCRIPTOR_INPUT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER , 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Create the descriptorlayout0
-		VkDescriptorSetLayoutCreateInfo descriptorLayout0 = VKTools::Initializers::DescriptorSetLayoutCreateInfo(0, DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT, layoutbinding0);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(core->GetViewDevice(), &descriptorLayout0, NULL, &renderState.m_descriptorLayouts[0]));
 		// Create the descriptorlayout1
 		VkDescriptorSetLayoutCreateInfo descriptorLayout1 = VKTools::Initializers::DescriptorSetLayoutCreateInfo(0, DEFERRED_MAIN_DESCRIPTOR_PASS_COUNT, layoutbinding1);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(core->GetViewDevice(), &descriptorLayout1, NULL, &renderState.m_descriptorLayouts[1]));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(core->GetViewDevice(), &descriptorLayout1, NULL, &renderState.m_descriptorLayouts[0]));
 		// Create the descriptorlayout2
 		VkDescriptorSetLayoutCreateInfo descriptorLayout2 = VKTools::Initializers::DescriptorSetLayoutCreateInfo(0, 1, layoutbinding2);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(core->GetViewDevice(), &descriptorLayout2, NULL, &renderState.m_descriptorLayouts[2]));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(core->GetViewDevice(), &descriptorLayout2, NULL, &renderState.m_descriptorLayouts[1]));
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -619,8 +562,11 @@ extern void CreateDeferredMainRenderState(
 	////////////////////////////////////////////////////////////////////////////////
 	if (!renderState.m_pipelineLayout)
 	{
-		VkDescriptorSetLayout dLayouts[] = { staticDescLayout, renderState.m_descriptorLayouts[0], renderState.m_descriptorLayouts[1], renderState.m_descriptorLayouts[2]};
-		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = VKTools::Initializers::PipelineLayoutCreateInfo(0, 4, dLayouts);
+		VkDescriptorSetLayout dLayouts[] = { staticDescLayout, renderState.m_descriptorLayouts[0], renderState.m_descriptorLayouts[1]};
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = VKTools::Initializers::PipelineLayoutCreateInfo(0, 3, dLayouts);
+		VkPushConstantRange pushConstantRange = VKTools::Initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantFrag));
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(core->GetViewDevice(), &pipelineLayoutCreateInfo, NULL, &renderState.m_pipelineLayout));
 	}
 
@@ -630,18 +576,15 @@ extern void CreateDeferredMainRenderState(
 	if (!renderState.m_descriptorPool)
 	{
 		VkDescriptorPoolSize poolSize[DEFERRED_MAIN_DESCRIPTOR_COUNT];
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_IMAGE_DIFFUSE] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_IMAGE_NORMAL] =  { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_IMAGE_OPACITY] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_BUFFER_FRAG + DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1};
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_VOXELGRID + DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_OUTPUT + DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1};
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_POSITION +DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1};
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_NORMAL +DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1};
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_ALBEDO +DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1 };
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_TANGENT + DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1 };
-		poolSize[DEFERRED_MAIN_DESCRIPTOR_PASS_COUNT + DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
-		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = VKTools::Initializers::DescriptorPoolCreateInfo(0, framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT+3, DEFERRED_MAIN_DESCRIPTOR_COUNT, poolSize);
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_BUFFER_FRAG] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1};
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_VOXELGRID] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_OUTPUT] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1};
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_POSITION] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1};
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_NORMAL] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1};
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_ALBEDO] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1 };
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_INPUT_TANGENT] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1 };
+		poolSize[DEFERRED_MAIN_DESCRIPTOR_PASS_COUNT] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = VKTools::Initializers::DescriptorPoolCreateInfo(0, 2, DEFERRED_MAIN_DESCRIPTOR_COUNT, poolSize);
 		//create the descriptorPool
 		VK_CHECK_RESULT(vkCreateDescriptorPool(core->GetViewDevice(), &descriptorPoolCreateInfo, NULL, &renderState.m_descriptorPool));
 	}
@@ -652,20 +595,12 @@ extern void CreateDeferredMainRenderState(
 	//allocate the requirered descriptorsets
 	if (!renderState.m_descriptorSets)
 	{
-		renderState.m_descriptorSetCount = DYNAMIC_DESCRIPTOR_SET_COUNT * framebufferCount + 2;
+		renderState.m_descriptorSetCount = 2;
 		renderState.m_descriptorSets = (VkDescriptorSet*)malloc(renderState.m_descriptorSetCount * sizeof(VkDescriptorSet));
-		for (uint32_t i = 0; i < framebufferCount; i++)
-		{
-			for (uint32_t j = 0; j < DYNAMIC_DESCRIPTOR_SET_COUNT; j++)
-			{
-				VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[0]);
-				VK_CHECK_RESULT(vkAllocateDescriptorSets(core->GetViewDevice(), &descriptorSetAllocateInfo, &renderState.m_descriptorSets[(i*DYNAMIC_DESCRIPTOR_SET_COUNT) + j + 2]));
-			}
-		}
 		// scaled renderer
-		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[1]);
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[0]);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(core->GetViewDevice(), &descriptorSetAllocateInfo, &renderState.m_descriptorSets[0]));
-		descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[2]);
+		descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[1]);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(core->GetViewDevice(), &descriptorSetAllocateInfo, &renderState.m_descriptorSets[1]));
 
 		///////////////////////////////////////////////////////
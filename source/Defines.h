@@ -2,19 +2,73 @@
 #define DEFINES_H
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <time.h>
+#include <alloca.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//#define ALLOCATOR_USE_HUGEPAGES					//back large allocators with transparent huge pages
+#define ALLOCATOR_HUGEPAGE_THRESHOLD (64ull << 20)	//smallest allocator that is backed by huge pages
+
+// the few win32 helpers used by the asset pipeline
+typedef union
+{
+	int64_t QuadPart;
+} LARGE_INTEGER;
+
+inline int QueryPerformanceCounter(LARGE_INTEGER* outCounter)
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	outCounter->QuadPart = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	return 1;
+}
+
+inline int QueryPerformanceFrequency(LARGE_INTEGER* outFrequency)
+{
+	outFrequency->QuadPart = 1000000000;	//nanoseconds
+	return 1;
+}
+
+inline int strcpy_s(char* dst, size_t dstSize, const char* src)
+{
+	size_t len = strlen(src);
+	if (len >= dstSize)
+		return (dstSize ? dst[0] = '\0' : 0), -1;
+	memcpy(dst, src, len + 1);
+	return 0;
+}
+
+#define _alloca alloca
+#define _fseeki64 fseeko
+#endif
 
 #define _STR(x) #x
 #define STR(x) _STR(x)
+#ifdef _MSC_VER
 #define LOG(severity,format,...) printf(STR(__FILE__) ": " STR(__LINE__) "][" severity"] " format "\n",__VA_ARGS__)
 #define RETURN_ERROR(errcode,format,...) return LOG("CRITICAL", format, __VA_ARGS__),assert(0),errcode
 #define ERROR_VOID(format,...) return LOG("CRITICAL", format, __VA_ARGS__),assert(0)
+#else	// gcc and clang only drop the trailing comma with ##
+#define LOG(severity,format,...) printf(STR(__FILE__) ": " STR(__LINE__) "][" severity"] " format "\n",##__VA_ARGS__)
+#define RETURN_ERROR(errcode,format,...) return LOG("CRITICAL", format, ##__VA_ARGS__),assert(0),errcode
+#define ERROR_VOID(format,...) return LOG("CRITICAL", format, ##__VA_ARGS__),assert(0)
+#endif
 
 // in seconds
 inline float Ctime()
 {
-	static __int64 start = 0;
-	static __int64 frequency = 0;
+	static int64_t start = 0;
+	static int64_t frequency = 0;
 
 	if (start == 0)
 	{
@@ -23,7 +77,7 @@ inline float Ctime()
 		return 0.0f;
 	}
 
-	__int64 counter = 0;
+	int64_t counter = 0;
 	QueryPerformanceCounter((LARGE_INTEGER*)&counter);
 	return (float)((counter - start) / double(frequency));
 }
@@ -32,33 +86,155 @@ inline float Ctime()
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 // Memory system
+#define ALLOCATOR_COMMIT_GRANULARITY 0x10000ull		//pages are committed in 64KB steps
+#define ALLOCATOR_TELEMETRY_SLOTS 32				//telemetry is kept per allocator index
+
 struct Memory_Linear_Allocator
 {
 	uint8_t* startPtr;			//starting pointer of allocated buffer
 	uint64_t sizeInBytes;		//totall size of the allocated buffer
 	uint64_t allocatedBytes;	//current allocated size
+	uint64_t committedBytes;	//backed by memory, grows with the allocated size
+};
+
+// Counters shared by all allocators of one index, updated lock free from any thread
+struct Memory_Allocator_Telemetry
+{
+	const char* name;
+	std::atomic<uint64_t> allocatorCount;		//live allocators
+	std::atomic<uint64_t> allocationCount;
+	std::atomic<uint64_t> failedAllocationCount;
+	std::atomic<uint64_t> allocatedBytes;		//currently allocated over all live allocators
+	std::atomic<uint64_t> highWaterMark;		//peak of allocatedBytes
+	std::atomic<uint64_t> largestAllocation;
+	std::atomic<uint64_t> reservedBytes;
+	std::atomic<uint64_t> committedBytes;
 };
 
+// Snapshot of the telemetry of one allocator index
+struct Memory_Allocator_Stats
+{
+	const char* name;
+	uint64_t allocatorCount;
+	uint64_t allocationCount;
+	uint64_t failedAllocationCount;
+	uint64_t allocatedBytes;
+	uint64_t highWaterMark;
+	uint64_t largestAllocation;
+	uint64_t reservedBytes;
+	uint64_t committedBytes;
+};
+
+inline Memory_Allocator_Telemetry* GetVirtualMemoryTelemetry(uint32_t rendererIdx)
+{
+	static Memory_Allocator_Telemetry telemetry[ALLOCATOR_TELEMETRY_SLOTS];	//zero initialized
+	assert(rendererIdx < ALLOCATOR_TELEMETRY_SLOTS);
+	return telemetry + rendererIdx;
+}
+
+inline void AtomicMax(std::atomic<uint64_t>* value, uint64_t candidate)
+{
+	uint64_t current = value->load(std::memory_order_relaxed);
+	while (current < candidate && !value->compare_exchange_weak(current, candidate, std::memory_order_relaxed));
+}
+
+inline void SetVirtualMemoryName(uint32_t rendererIdx, const char* name)
+{
+	GetVirtualMemoryTelemetry(rendererIdx)->name = name;
+}
+
+inline void GetVirtualMemoryStats(uint32_t rendererIdx, Memory_Allocator_Stats* outStats)
+{
+	const Memory_Allocator_Telemetry* telemetry = GetVirtualMemoryTelemetry(rendererIdx);
+	outStats->name = telemetry->name;
+	outStats->allocatorCount = telemetry->allocatorCount.load(std::memory_order_relaxed);
+	outStats->allocationCount = telemetry->allocationCount.load(std::memory_order_relaxed);
+	outStats->failedAllocationCount = telemetry->failedAllocationCount.load(std::memory_order_relaxed);
+	outStats->allocatedBytes = telemetry->allocatedBytes.load(std::memory_order_relaxed);
+	outStats->highWaterMark = telemetry->highWaterMark.load(std::memory_order_relaxed);
+	outStats->largestAllocation = telemetry->largestAllocation.load(std::memory_order_relaxed);
+	outStats->reservedBytes = telemetry->reservedBytes.load(std::memory_order_relaxed);
+	outStats->committedBytes = telemetry->committedBytes.load(std::memory_order_relaxed);
+}
+
+// Writes the telemetry of every allocator index that was used to a JSON file
+inline int32_t DumpVirtualMemoryStats(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return -1;
+
+	fprintf(file, "{\n\t\"allocators\": [");
+	uint32_t written = 0;
+	for (uint32_t i = 0; i < ALLOCATOR_TELEMETRY_SLOTS; i++)
+	{
+		Memory_Allocator_Stats stats;
+		GetVirtualMemoryStats(i, &stats);
+		if (stats.allocationCount == 0 && stats.reservedBytes == 0 && stats.highWaterMark == 0)
+			continue;	//never used
+
+		fprintf(file, "%s\n\t\t{ \"index\": %u, \"name\": \"%s\", \"allocators\": %llu, \"allocations\": %llu, \"failedAllocations\": %llu, "
+			"\"allocatedBytes\": %llu, \"highWaterMark\": %llu, \"largestAllocation\": %llu, \"reservedBytes\": %llu, \"committedBytes\": %llu }",
+			written++ ? "," : "", i, stats.name ? stats.name : "",
+			(unsigned long long)stats.allocatorCount, (unsigned long long)stats.allocationCount, (unsigned long long)stats.failedAllocationCount,
+			(unsigned long long)stats.allocatedBytes, (unsigned long long)stats.highWaterMark, (unsigned long long)stats.largestAllocation,
+			(unsigned long long)stats.reservedBytes, (unsigned long long)stats.committedBytes);
+	}
+	fprintf(file, "\n\t]\n}\n");
+	fclose(file);
+
+	return 0;
+}
+
 inline Memory_Linear_Allocator* CreateVirtualMemoryAllocator(uint32_t rendererIdx, uint64_t sizeInBytes)
 {
-	void* memptr = (void*)((rendererIdx + 1) * 0x100000000ULL);
-	memptr = VirtualAlloc(memptr, sizeInBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	// No fixed address is needed, data that gets cached only stores self-relative pointers
+#ifdef _WIN32
+	// reserve only, pages are committed as the allocator grows
+	void* memptr = VirtualAlloc(NULL, sizeInBytes, MEM_RESERVE, PAGE_READWRITE);
 
 	if (memptr == NULL)
 		return NULL;
+#else
+	// reserve only, pages are backed on first touch
+	void* memptr = mmap(NULL, sizeInBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (memptr == MAP_FAILED)
+		return NULL;
+#ifdef ALLOCATOR_USE_HUGEPAGES
+	if (sizeInBytes >= ALLOCATOR_HUGEPAGE_THRESHOLD)
+		madvise(memptr, sizeInBytes, MADV_HUGEPAGE);
+#endif
+#endif
 
 	Memory_Linear_Allocator* allocator = (Memory_Linear_Allocator*)malloc(sizeof(Memory_Linear_Allocator));
 	(*allocator).startPtr = (uint8_t*)memptr;
 	(*allocator).sizeInBytes = sizeInBytes;
 	(*allocator).allocatedBytes = 0;
+	(*allocator).committedBytes = 0;
+
+	Memory_Allocator_Telemetry* telemetry = GetVirtualMemoryTelemetry(rendererIdx);
+	telemetry->allocatorCount.fetch_add(1, std::memory_order_relaxed);
+	telemetry->reservedBytes.fetch_add(sizeInBytes, std::memory_order_relaxed);
 
 	return allocator;
 }
 
 inline uint32_t DestroyVirtualMemoryAllocator(uint32_t rendererIdx, Memory_Linear_Allocator* allocator)
 {
+#ifdef _WIN32
 	if (VirtualFree(allocator->startPtr, 0, MEM_RELEASE) == FALSE)
 		return -1;
+#else
+	if (munmap(allocator->startPtr, allocator->sizeInBytes) != 0)
+		return -1;
+#endif
+
+	Memory_Allocator_Telemetry* telemetry = GetVirtualMemoryTelemetry(rendererIdx);
+	telemetry->allocatorCount.fetch_sub(1, std::memory_order_relaxed);
+	telemetry->reservedBytes.fetch_sub(allocator->sizeInBytes, std::memory_order_relaxed);
+	telemetry->committedBytes.fetch_sub(allocator->committedBytes, std::memory_order_relaxed);
+	telemetry->allocatedBytes.fetch_sub(allocator->allocatedBytes, std::memory_order_relaxed);
 
 	free(allocator);
 
@@ -67,23 +243,71 @@ inline uint32_t DestroyVirtualMemoryAllocator(uint32_t rendererIdx, Memory_Linea
 
 inline void* AllocateVirtualMemory(uint32_t rendererIdx, Memory_Linear_Allocator* allocator, uint64_t sizeInBytes)
 {
+	Memory_Allocator_Telemetry* telemetry = GetVirtualMemoryTelemetry(rendererIdx);
 	if (allocator->allocatedBytes + sizeInBytes > allocator->sizeInBytes)
+	{
+		telemetry->failedAllocationCount.fetch_add(1, std::memory_order_relaxed);
 		return NULL;
+	}
 
 	uint8_t* startPtr = allocator->startPtr + allocator->allocatedBytes;
 	allocator->allocatedBytes += sizeInBytes;
 
+	//grow the committed range
+	if (allocator->allocatedBytes > allocator->committedBytes)
+	{
+		uint64_t committedEnd = (allocator->allocatedBytes + ALLOCATOR_COMMIT_GRANULARITY - 1) & ~(ALLOCATOR_COMMIT_GRANULARITY - 1);
+		if (committedEnd > allocator->sizeInBytes)
+			committedEnd = allocator->sizeInBytes;
+#ifdef _WIN32
+		if (VirtualAlloc(allocator->startPtr + allocator->committedBytes, committedEnd - allocator->committedBytes, MEM_COMMIT, PAGE_READWRITE) == NULL)
+		{
+			allocator->allocatedBytes -= sizeInBytes;
+			telemetry->failedAllocationCount.fetch_add(1, std::memory_order_relaxed);
+			return NULL;
+		}
+#endif
+		telemetry->committedBytes.fetch_add(committedEnd - allocator->committedBytes, std::memory_order_relaxed);
+		allocator->committedBytes = committedEnd;
+	}
+
+	telemetry->allocationCount.fetch_add(1, std::memory_order_relaxed);
+	uint64_t allocatedBytes = telemetry->allocatedBytes.fetch_add(sizeInBytes, std::memory_order_relaxed) + sizeInBytes;
+	AtomicMax(&telemetry->highWaterMark, allocatedBytes);
+	AtomicMax(&telemetry->largestAllocation, sizeInBytes);
+
 	return (void*)startPtr;
 }
 
 inline void ResetVirtualMemory(uint32_t rendererIdx, Memory_Linear_Allocator* allocator)
 {
-	void* memptr = allocator->startPtr;
-	memptr = VirtualAlloc(memptr, allocator->sizeInBytes, MEM_RESET, PAGE_READWRITE);
-	assert(memptr && memptr == allocator->startPtr);
+	// only the committed range holds data
+	if (allocator->committedBytes)
+	{
+#ifdef _WIN32
+		void* memptr = allocator->startPtr;
+		memptr = VirtualAlloc(memptr, allocator->committedBytes, MEM_RESET, PAGE_READWRITE);
+		assert(memptr && memptr == allocator->startPtr);
+#else
+		// drops the pages, they read back as zero
+		int result = madvise(allocator->startPtr, allocator->committedBytes, MADV_DONTNEED);
+		assert(result == 0);
+		(void)result;
+#endif
+	}
+	GetVirtualMemoryTelemetry(rendererIdx)->allocatedBytes.fetch_sub(allocator->allocatedBytes, std::memory_order_relaxed);
 	allocator->allocatedBytes = 0;
 }
 
+// Frees the allocations made since mark, a pointer AllocateVirtualMemory returned. The pages stay committed
+inline void RewindVirtualMemory(uint32_t rendererIdx, Memory_Linear_Allocator* allocator, const void* mark)
+{
+	uint64_t allocatedBytes = (const uint8_t*)mark - allocator->startPtr;
+	assert(allocatedBytes <= allocator->allocatedBytes);
+	GetVirtualMemoryTelemetry(rendererIdx)->allocatedBytes.fetch_sub(allocator->allocatedBytes - allocatedBytes, std::memory_order_relaxed);
+	allocator->allocatedBytes = allocatedBytes;
+}
+
 inline uint64_t GetVirtualMemoryAllocatedByteCount(uint32_t rendererIdx, Memory_Linear_Allocator* allocator)
 {
 	return allocator->allocatedBytes;
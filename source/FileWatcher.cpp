@@ -0,0 +1,304 @@
+#include "FileWatcher.h"
+#include "Defines.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher()
+{
+#ifdef _WIN32
+	m_directory = INVALID_HANDLE_VALUE;
+	memset(&m_overlapped, 0, sizeof(m_overlapped));
+	m_reading = 0;
+#else
+	m_inotify = -1;
+#endif
+	m_buffer = NULL;
+	m_rootPath[0] = '\0';
+	m_rootPathLength = 0;
+	m_frequency = 1;
+	m_initialized = 0;
+}
+
+FileWatcher::~FileWatcher()
+{
+	Shutdown();
+}
+
+int32_t FileWatcher::Init(const char* rootPath)
+{
+	assert(!m_initialized);
+	if (strcpy_s(m_rootPath, sizeof(m_rootPath), rootPath) != 0)
+		return -1;	// Path too long
+	m_rootPathLength = (uint32_t)strlen(m_rootPath);
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_frequency = frequency.QuadPart;
+	m_buffer = (uint32_t*)malloc(FILEWATCHER_BUFFER_SIZE);
+
+#ifdef _WIN32
+	m_directory = CreateFileA(m_rootPath, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (m_directory == INVALID_HANDLE_VALUE)
+		return free(m_buffer), m_buffer = NULL,
+		-2;	// Could not open the directory
+	m_overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+#else
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0)
+		return free(m_buffer), m_buffer = NULL,
+		-2;	// No inotify instance available
+	if (AddDirectory("") != 0)
+		return close(m_inotify), m_inotify = -1, free(m_buffer), m_buffer = NULL,
+		-3;	// Could not watch the directory
+#endif
+
+	m_initialized = 1;
+	return 0;
+}
+
+void FileWatcher::Shutdown()
+{
+	if (!m_initialized)
+		return;
+
+#ifdef _WIN32
+	//the system writes into the buffer until the read is cancelled
+	if (m_reading)
+	{
+		DWORD byteCount;
+		CancelIo(m_directory);
+		GetOverlappedResult(m_directory, &m_overlapped, &byteCount, TRUE);
+		m_reading = 0;
+	}
+	CloseHandle(m_overlapped.hEvent);
+	CloseHandle(m_directory);
+	m_directory = INVALID_HANDLE_VALUE;
+#else
+	close(m_inotify);		//removes all watches
+	m_inotify = -1;
+	m_directories.clear();
+#endif
+	free(m_buffer);
+	m_buffer = NULL;
+	m_pending.clear();
+	m_initialized = 0;
+}
+
+void FileWatcher::AddChange(const char* relativePath, uint32_t relativePathLength)
+{
+	if (m_rootPathLength + relativePathLength >= FILEWATCHER_MAX_PATH)
+		return;
+
+	char path[FILEWATCHER_MAX_PATH];
+	memcpy(path, m_rootPath, m_rootPathLength);
+	for (uint32_t i = 0; i < relativePathLength; i++)
+		path[m_rootPathLength + i] = (relativePath[i] == '\\') ? '/' : relativePath[i];
+	uint32_t pathLength = m_rootPathLength + relativePathLength;
+	path[pathLength] = '\0';
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	//a file changing again restarts its settle time
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		if (m_pending[i].pathLength == pathLength && memcmp(m_pending[i].path, path, pathLength) == 0)
+		{
+			m_pending[i].lastChange = now.QuadPart;
+			return;
+		}
+	}
+
+	PendingChange change;
+	memcpy(change.path, path, pathLength + 1);
+	change.pathLength = pathLength;
+	change.lastChange = now.QuadPart;
+	m_pending.push_back(change);
+}
+
+#ifdef _WIN32
+uint32_t FileWatcher::ReadEvents()
+{
+	const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+	if (!m_reading)
+	{
+		if (!ReadDirectoryChangesW(m_directory, m_buffer, FILEWATCHER_BUFFER_SIZE, TRUE, filter, NULL, &m_overlapped, NULL))
+			return 0;
+		m_reading = 1;
+	}
+
+	DWORD byteCount;
+	if (!GetOverlappedResult(m_directory, &m_overlapped, &byteCount, FALSE))
+		return 0;	// Nothing changed yet
+	m_reading = 0;
+
+	//0 bytes when the buffer overflowed, those changes are lost
+	uint32_t eventCount = 0;
+	const uint8_t* ptr = (const uint8_t*)m_buffer;
+	while (byteCount)
+	{
+		const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)ptr;
+		if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+		{
+			char relativePath[FILEWATCHER_MAX_PATH];
+			int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR), relativePath, sizeof(relativePath) - 1, NULL, NULL);
+			if (length > 0)
+			{
+				AddChange(relativePath, (uint32_t)length);
+				eventCount++;
+			}
+		}
+		if (!info->NextEntryOffset)
+			break;
+		ptr += info->NextEntryOffset;
+	}
+
+	//queue the next read, changes in between are buffered by the system
+	if (ReadDirectoryChangesW(m_directory, m_buffer, FILEWATCHER_BUFFER_SIZE, TRUE, filter, NULL, &m_overlapped, NULL))
+		m_reading = 1;
+
+	return eventCount;
+}
+#else
+int32_t FileWatcher::AddDirectory(const char* relativePath)
+{
+	WatchedDirectory directory;
+	int length = snprintf(directory.path, sizeof(directory.path), "%s%s", relativePath, relativePath[0] ? "/" : "");
+	if (length < 0 || length >= (int)sizeof(directory.path))
+		return -1;	// Path too long
+
+	char path[FILEWATCHER_MAX_PATH];
+	length = snprintf(path, sizeof(path), "%s%s", m_rootPath, directory.path);
+	if (length < 0 || length >= (int)sizeof(path))
+		return -1;	// Path too long
+
+	//files are reported once they are closed after writing, or renamed into place
+	directory.watch = inotify_add_watch(m_inotify, path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+	if (directory.watch < 0)
+		return -2;	// Could not watch the directory
+	m_directories.push_back(directory);
+
+	//inotify is not recursive, watch every subdirectory
+	DIR* dir = opendir(path);
+	if (!dir)
+		return 0;
+	while (dirent* entry = readdir(dir))
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		char childPath[FILEWATCHER_MAX_PATH];
+		length = snprintf(childPath, sizeof(childPath), "%s%s", directory.path, entry->d_name);
+		if (length < 0 || length >= (int)sizeof(childPath))
+			continue;
+
+		uint32_t isDirectory = (entry->d_type == DT_DIR);
+		if (entry->d_type == DT_UNKNOWN)
+		{
+			//not every file system fills in the type
+			char fullPath[FILEWATCHER_MAX_PATH];
+			struct stat info;
+			length = snprintf(fullPath, sizeof(fullPath), "%s%s", m_rootPath, childPath);
+			if (length < 0 || length >= (int)sizeof(fullPath))
+				continue;
+			isDirectory = (stat(fullPath, &info) == 0 && S_ISDIR(info.st_mode));
+		}
+		if (isDirectory)
+			AddDirectory(childPath);
+	}
+	closedir(dir);
+
+	return 0;
+}
+
+uint32_t FileWatcher::ReadEvents()
+{
+	uint32_t eventCount = 0;
+	for (;;)
+	{
+		ssize_t size = read(m_inotify, m_buffer, FILEWATCHER_BUFFER_SIZE);
+		if (size <= 0)
+			break;	// No events left
+
+		const uint8_t* ptr = (const uint8_t*)m_buffer;
+		const uint8_t* end = ptr + size;
+		while (ptr < end)
+		{
+			const inotify_event* event = (const inotify_event*)ptr;
+			ptr += sizeof(inotify_event) + event->len;
+			if (!event->len)
+				continue;	// Event of the watched directory itself
+
+			const WatchedDirectory* directory = NULL;
+			for (size_t i = 0; i < m_directories.size(); i++)
+			{
+				if (m_directories[i].watch == event->wd)
+				{
+					directory = &m_directories[i];
+					break;
+				}
+			}
+			if (!directory)
+				continue;
+
+			char relativePath[FILEWATCHER_MAX_PATH];
+			int length = snprintf(relativePath, sizeof(relativePath), "%s%s", directory->path, event->name);
+			if (length < 0 || length >= (int)sizeof(relativePath))
+				continue;
+
+			if (event->mask & IN_ISDIR)
+			{
+				//new subdirectory, files written into it are reported as well
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+					AddDirectory(relativePath);
+				continue;
+			}
+			if (!(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+				continue;	// Created, but not written yet
+
+			AddChange(relativePath, (uint32_t)length);
+			eventCount++;
+		}
+	}
+	return eventCount;
+}
+#endif
+
+uint32_t FileWatcher::Poll(sig_FileChanged callback, void* userData)
+{
+	if (!m_initialized)
+		return 0;
+
+	while (ReadEvents())
+		;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	int64_t settleTicks = (int64_t)(FILEWATCHER_SETTLE_MS * m_frequency / 1000.0);
+
+	uint32_t reportedCount = 0;
+	for (size_t i = 0; i < m_pending.size();)
+	{
+		if (now.QuadPart - m_pending[i].lastChange < settleTicks)
+		{
+			i++;
+			continue;
+		}
+
+		PendingChange change = m_pending[i];
+		m_pending[i] = m_pending.back();
+		m_pending.pop_back();
+		callback(change.path, change.pathLength, userData);
+		reportedCount++;
+	}
+	return reportedCount;
+}
@@ -0,0 +1,64 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <stdint.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#define FILEWATCHER_MAX_PATH 512
+#define FILEWATCHER_BUFFER_SIZE 0x10000		//bytes of change events read per poll
+#define FILEWATCHER_SETTLE_MS 50.0			//a file is reported once it stopped changing for this long, editors write in several steps
+
+typedef void(*sig_FileChanged)(const char* path, uint32_t pathLength, void* userData);
+
+// Watches a directory and its subdirectories for files that are written or renamed into place.
+// inotify on Linux, ReadDirectoryChangesW on Windows. Polled from the main loop, it never blocks.
+// Reported paths are the root path followed by the relative path, with '/' separators.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	int32_t Init(const char* rootPath);		//rootPath ends with a separator, like "Assets/"
+	void Shutdown();
+	uint32_t Poll(sig_FileChanged callback, void* userData);	//reports the files that settled since the last poll, returns their count
+
+private:
+	struct PendingChange
+	{
+		char path[FILEWATCHER_MAX_PATH];
+		uint32_t pathLength;
+		int64_t lastChange;		//performance counter of the last event of the file
+	};
+
+	void AddChange(const char* relativePath, uint32_t relativePathLength);
+	uint32_t ReadEvents();
+
+#ifdef _WIN32
+	HANDLE m_directory;
+	OVERLAPPED m_overlapped;
+	uint32_t m_reading;					//a read is queued on the directory
+#else
+	struct WatchedDirectory
+	{
+		int32_t watch;
+		char path[FILEWATCHER_MAX_PATH];	//relative to the root, empty or ending with '/'
+	};
+	int32_t AddDirectory(const char* relativePath);
+
+	int32_t m_inotify;
+	std::vector<WatchedDirectory> m_directories;
+#endif
+	uint32_t* m_buffer;					//DWORD aligned, ReadDirectoryChangesW requires it
+	char m_rootPath[FILEWATCHER_MAX_PATH];
+	uint32_t m_rootPathLength;
+	std::vector<PendingChange> m_pending;
+	int64_t m_frequency;
+	uint32_t m_initialized;
+};
+
+#endif	//FILEWATCHER_H
@@ -16,6 +16,11 @@ struct Parameter
 	VkDescriptorSet staticDescriptorSet;
 };
 
+struct PushConstantFrag
+{
+	uint32_t textureIndex[TEXTURE_NUM];	// Material textures in the static texture array
+};
+
 void BuildCommandBufferForwardRenderState(
 	RenderState* renderstate,
 	VkCommandPool commandpool,
@@ -40,10 +45,7 @@ void BuildCommandBufferForwardRenderState(
 	////////////////////////////////////////////////////////////////////////////////
 	// Rebuild the command buffers
 	////////////////////////////////////////////////////////////////////////////////
-	renderState->m_commandBufferCount = framebufferCount;
-	renderState->m_commandBuffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer)*renderState->m_commandBufferCount);
-	for (uint32_t i = 0; i < renderState->m_commandBufferCount; i++)
-		renderState->m_commandBuffers[i] = VKTools::Initializers::CreateCommandBuffer(commandpool, device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+	AcquireCommandBuffers(*renderState, commandpool, device, framebufferCount);
 
 	////////////////////////////////////////////////////////////////////////////////
 	// Record command buffer
@@ -105,7 +107,6 @@ void BuildCommandBufferForwardRenderState(
 		// Bind descriptor sets describing shader binding points
 		uint32_t doffset = 0;
 		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 0, 1, &staticDescriptorSet, 1, &doffset);
-		uint32_t d = 0;
 		for (uint32_t m = 0; m < meshCount; m++)
 		{
 			//select the current mesh
@@ -114,52 +115,8 @@ void BuildCommandBufferForwardRenderState(
 			vkCmdBindVertexBuffers(renderState->m_commandBuffers[i], 0, mesh->vbvCount, mesh->vertexResources, mesh->vertexOffsets);
 			for (uint32_t j = 0; j < mesh->submeshCount; j++)
 			{
-				//TODO: BIND new descriptorset
-				VkDescriptorSet descriptorset = renderState->m_descriptorSets[(i*DYNAMIC_DESCRIPTOR_SET_COUNT) + d++];
-
-				//bind the textures to the correct format
-				//format: stype,pnext,scSet,srcBinding,srcArrayelement,dstSet,dstbinding,dstarrayelement,descriptorcount
-				VkCopyDescriptorSet textureDescriptorSets[TEXTURE_NUM];
-				//diffuse texture
-				VkCopyDescriptorSet diffuse;
-				diffuse.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				diffuse.pNext = NULL;
-				diffuse.srcSet = staticDescriptorSet;
-				diffuse.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				diffuse.srcArrayElement = mesh->submeshes[j].textureIndex[DIFFUSE_TEXTURE];
-				diffuse.dstSet = descriptorset;
-				diffuse.dstBinding = FORWARDRENDER_DESCRIPTOR_IMAGE_DIFFUSE;
-				diffuse.dstArrayElement = 0;
-				diffuse.descriptorCount = 1;
-				textureDescriptorSets[DIFFUSE_TEXTURE] = diffuse;
-				//normal texture
-				VkCopyDescriptorSet normal;
-				normal.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				normal.pNext = NULL;
-				normal.srcSet = staticDescriptorSet;
-				normal.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				normal.srcArrayElement = mesh->submeshes[j].textureIndex[NORMAL_TEXTURE];
-				normal.dstSet = descriptorset;
-				normal.dstBinding = FORWARDRENDER_DESCRIPTOR_IMAGE_NORMAL;
-				normal.dstArrayElement = 0;
-				normal.descriptorCount = 1;
-				textureDescriptorSets[NORMAL_TEXTURE] = normal;
-				//opacity teture
-				VkCopyDescriptorSet opacity;
-				opacity.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				opacity.pNext = NULL;
-				opacity.srcSet = staticDescriptorSet;
-				opacity.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				opacity.srcArrayElement = (uint32_t)mesh->submeshes[j].textureIndex[OPACITY_TEXTURE];
-				opacity.dstSet = descriptorset;
-				opacity.dstBinding = FORWARDRENDER_DESCRIPTOR_IMAGE_OPACITY;
-				opacity.dstArrayElement = 0;
-				opacity.descriptorCount = 1;
-				textureDescriptorSets[OPACITY_TEXTURE] = opacity;
-				// Update the descriptors
-				vkUpdateDescriptorSets(device, 0, NULL, (uint32_t)TEXTURE_NUM, textureDescriptorSets);
-				// Bind descriptor sets describing shader binding points
-				vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 1, 1, &descriptorset, 0, NULL);
+				// Select the material textures of the submesh
+				vkCmdPushConstants(renderState->m_commandBuffers[i], renderState->m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantFrag), mesh->submeshes[j].textureIndex);
 				// Bind triangle indices
 				vkCmdBindIndexBuffer(renderState->m_commandBuffers[i], mesh->submeshes[j].ibv.buffer, mesh->submeshes[j].ibv.offset, mesh->submeshes[j].ibv.format);
 				// Draw indexed triangle
@@ -250,69 +207,23 @@ extern void CreateForwardRenderState(
 	////////////////////////////////////////////////////////////////////////////////
 	// Create the descriptorlayout
 	////////////////////////////////////////////////////////////////////////////////
-	if (!renderState.m_descriptorLayouts)
-	{
-		renderState.m_descriptorLayoutCount = 1;
-		renderState.m_descriptorLayouts = (VkDescriptorSetLayout*)malloc(sizeof(VkDescriptorSetLayout)*renderState.m_descriptorLayoutCount);
-		//dynamic descriptorset
-		VkDescriptorSetLayoutBinding layoutBinding[FORWARDRENDER_DESCRIPTOR_COUNT];
-		// Binding 0 : diffuse texture sampled image
-		layoutBinding[FORWARDRENDER_DESCRIPTOR_IMAGE_DIFFUSE] =
-		{ FORWARDRENDER_DESCRIPTOR_IMAGE_DIFFUSE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 1 : normal texture sampled image
-		layoutBinding[FORWARDRENDER_DESCRIPTOR_IMAGE_NORMAL] =
-		{ FORWARDRENDER_DESCRIPTOR_IMAGE_NORMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 2: opacity texture sampled image
-		layoutBinding[FORWARDRENDER_DESCRIPTOR_IMAGE_OPACITY] =
-		{ FORWARDRENDER_DESCRIPTOR_IMAGE_OPACITY, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// set the createinfo
-		//create the descriptorlayout
-		VkDescriptorSetLayoutCreateInfo descriptorLayout = VKTools::Initializers::DescriptorSetLayoutCreateInfo(0, FORWARDRENDER_DESCRIPTOR_COUNT, layoutBinding);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, NULL, &renderState.m_descriptorLayouts[0]));
-	}
-	
+	// The textures are indexed in the static descriptorset, no descriptorsets of its own
+	renderState.m_descriptorLayoutCount = 0;
+	renderState.m_descriptorLayouts = NULL;
+	renderState.m_descriptorSetCount = 0;
+	renderState.m_descriptorSets = NULL;
+
 	////////////////////////////////////////////////////////////////////////////////
 	// Create layout
 	////////////////////////////////////////////////////////////////////////////////
 	if (!renderState.m_pipelineLayout)
 	{
-		VkDescriptorSetLayout dLayouts[] = { staticDescLayout, renderState.m_descriptorLayouts[0] };
-		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = VKTools::Initializers::PipelineLayoutCreateInfo(0, 2, dLayouts);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = VKTools::Initializers::PipelineLayoutCreateInfo(0, 1, &staticDescLayout);
+		VkPushConstantRange pushConstantRange = VKTools::Initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantFrag));
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &renderState.m_pipelineLayout));
 	}
-
-	////////////////////////////////////////////////////////////////////////////////
-	// Create descriptor pool
-	////////////////////////////////////////////////////////////////////////////////
-	if (!renderState.m_descriptorPool)
-	{
-		VkDescriptorPoolSize poolSize[FORWARDRENDER_DESCRIPTOR_COUNT];
-		poolSize[FORWARDRENDER_DESCRIPTOR_IMAGE_DIFFUSE] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE , framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[FORWARDRENDER_DESCRIPTOR_IMAGE_NORMAL] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE , framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[FORWARDRENDER_DESCRIPTOR_IMAGE_OPACITY] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE , framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = VKTools::Initializers::DescriptorPoolCreateInfo(0, framebufferCount * DYNAMIC_DESCRIPTOR_SET_COUNT, FORWARDRENDER_DESCRIPTOR_COUNT, poolSize);
-		//create the descriptorPool
-		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, NULL, &renderState.m_descriptorPool));
-	}
-	
-	////////////////////////////////////////////////////////////////////////////////
-	// Create the descriptor set
-	////////////////////////////////////////////////////////////////////////////////
-	//allocate the requirered descriptorsets
-	if (!renderState.m_descriptorSets)
-	{
-		renderState.m_descriptorSetCount = DYNAMIC_DESCRIPTOR_SET_COUNT * framebufferCount;
-		renderState.m_descriptorSets = (VkDescriptorSet*)malloc(renderState.m_descriptorSetCount * sizeof(VkDescriptorSet));
-		for (uint32_t i = 0; i < framebufferCount; i++)
-		{
-			for (uint32_t j = 0; j < DYNAMIC_DESCRIPTOR_SET_COUNT; j++)
-			{
-				VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[0]);
-				//allocate the descriptorset with the pool
-				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &renderState.m_descriptorSets[(i*DYNAMIC_DESCRIPTOR_SET_COUNT) + j]));
-			}
-		}
-	}
 	
 	////////////////////////////////////////////////////////////////////////////////
 	// Create Pipeline
@@ -1,7 +1,268 @@
 #include "ImageLoader.h"
 
 #define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_FAILURE_STRINGS		//the failure reason is a global, images are decoded on several threads
+//stbi__err is left unused without the failure strings
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable: 4505)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
 #include <stb_image/stb_image.h>
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <emmintrin.h>		//SSE2, the baseline of every x64 CPU
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// The content decides how the mips are filtered, told apart by the naming of the textures
+enum ImageContent
+{
+	IMAGE_CONTENT_COLOR,		//sRGB encoded, filtered in linear space
+	IMAGE_CONTENT_DATA,			//linear values like specular maps
+	IMAGE_CONTENT_MASK,			//linear single channel, like opacity masks
+	IMAGE_CONTENT_NORMAL,		//tangent space normals, renormalized after filtering
+};
+
+static ImageContent GetImageContent(const char* path)
+{
+	if (strstr(path, "_ddn"))
+		return IMAGE_CONTENT_NORMAL;
+	if (strstr(path, "_mask"))
+		return IMAGE_CONTENT_MASK;
+	if (strstr(path, "_spec"))
+		return IMAGE_CONTENT_DATA;
+	return IMAGE_CONTENT_COLOR;
+}
+
+#define SRGB_ENCODE_LUT_SIZE 4096		//linear to sRGB steps, below one 8 bit step over the whole range
+
+struct SRGBTables
+{
+	float toLinear[256];
+	float toSRGB[SRGB_ENCODE_LUT_SIZE + 1];
+};
+
+static const SRGBTables* GetSRGBTables()
+{
+	//built once, thread safe through the static initialization
+	static const SRGBTables* tables = []()
+	{
+		static SRGBTables t;
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			t.toLinear[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (uint32_t i = 0; i <= SRGB_ENCODE_LUT_SIZE; i++)
+		{
+			float c = (float)i / SRGB_ENCODE_LUT_SIZE;
+			t.toSRGB[i] = (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+		}
+		return &t;
+	}();
+	return tables;
+}
+
+// Expands one row of 8 bit texels with 1 to 4 channels to rgba8. Grey is repeated over rgb, a missing alpha is opaque
+static void ExpandRowRGBA8(uint32_t* dst, const uint8_t* src, uint32_t width, int comp)
+{
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	uint32_t x = 0;
+	switch (comp)
+	{
+	case 4:
+		memcpy(dst, src, width * sizeof(uint32_t));
+		return;
+	case 3:
+		//4 texels of 3 bytes from one load, it reads 4 bytes past them so stop 6 texels before the end of the row
+		for (; x + 6 <= width; x += 4)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + 3 * x));
+			__m128i t01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+			__m128i t23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+			_mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_unpacklo_epi64(t01, t23), opaque));
+		}
+		for (; x < width; x++)
+			dst[x] = src[3 * x] | (src[3 * x + 1] << 8) | (src[3 * x + 2] << 16) | 0xFF000000;
+		return;
+	case 2:
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + 2 * x));
+			__m128i grey = _mm_and_si128(v, _mm_set1_epi16(0x00FF));
+			__m128i alpha = _mm_slli_epi16(_mm_srli_epi16(v, 8), 8);
+			//grey | grey << 8 per 16 bits, then alpha takes the top byte of every texel
+			__m128i gg = _mm_or_si128(grey, _mm_slli_epi16(grey, 8));
+			__m128i ga = _mm_or_si128(grey, alpha);
+			_mm_storeu_si128((__m128i*)(dst + x), _mm_unpacklo_epi16(gg, ga));
+			_mm_storeu_si128((__m128i*)(dst + x + 4), _mm_unpackhi_epi16(gg, ga));
+		}
+		for (; x < width; x++)
+			dst[x] = src[2 * x] * 0x010101u | (src[2 * x + 1] << 24);
+		return;
+	case 1:
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+			__m128i lo = _mm_unpacklo_epi8(v, v);
+			__m128i hi = _mm_unpackhi_epi8(v, v);
+			_mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_unpacklo_epi16(lo, lo), opaque));
+			_mm_storeu_si128((__m128i*)(dst + x + 4), _mm_or_si128(_mm_unpackhi_epi16(lo, lo), opaque));
+			_mm_storeu_si128((__m128i*)(dst + x + 8), _mm_or_si128(_mm_unpacklo_epi16(hi, hi), opaque));
+			_mm_storeu_si128((__m128i*)(dst + x + 12), _mm_or_si128(_mm_unpackhi_epi16(hi, hi), opaque));
+		}
+		for (; x < width; x++)
+			dst[x] = src[x] * 0x010101u | 0xFF000000;
+		return;
+	}
+}
+
+// Unpacks a rgba8 texel into the space it is filtered in
+static inline __m128 DecodeTexel(uint32_t texel, ImageContent content, const float* toLinear)
+{
+	if (content == IMAGE_CONTENT_COLOR)
+		return _mm_setr_ps(toLinear[texel & 0xFF], toLinear[(texel >> 8) & 0xFF], toLinear[(texel >> 16) & 0xFF], (texel >> 24) * (1.0f / 255.0f));
+
+	__m128i v = _mm_cvtsi32_si128((int)texel);
+	v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, _mm_setzero_si128()), _mm_setzero_si128());
+	__m128 f = _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 255.0f));
+	if (content == IMAGE_CONTENT_NORMAL)
+		f = _mm_add_ps(_mm_mul_ps(f, _mm_setr_ps(2.0f, 2.0f, 2.0f, 1.0f)), _mm_setr_ps(-1.0f, -1.0f, -1.0f, 0.0f));
+	return f;
+}
+
+// Averages the 2x2 footprint of a texel of the next level
+static inline __m128 FilterTexel(__m128 a, __m128 b, __m128 c, __m128 d, ImageContent content)
+{
+	__m128 texel = _mm_mul_ps(_mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d)), _mm_set1_ps(0.25f));
+	if (content == IMAGE_CONTENT_NORMAL)
+	{
+		//averaged normals get shorter, scale xyz back to unit length
+		__m128 xyz = _mm_and_ps(texel, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+		__m128 sq = _mm_mul_ps(xyz, xyz);
+		__m128 dot = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+		dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+		__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(dot, _mm_set1_ps(1e-12f))));
+		__m128 w = _mm_andnot_ps(_mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)), texel);
+		texel = _mm_or_ps(_mm_mul_ps(xyz, invLength), w);
+	}
+	return texel;
+}
+
+// Halves the rgba8 top level, odd edges repeat their last texel
+static void DownsampleLevelRGBA8(float* dst, uint32_t dstWidth, uint32_t dstHeight, const uint32_t* src, uint32_t srcWidth, uint32_t srcHeight, ImageContent content)
+{
+	const float* toLinear = GetSRGBTables()->toLinear;
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		const uint32_t* row0 = src + srcWidth * std::min(2 * y, srcHeight - 1);
+		const uint32_t* row1 = src + srcWidth * std::min(2 * y + 1, srcHeight - 1);
+		float* out = dst + 4 * dstWidth * y;
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			uint32_t x0 = std::min(2 * x, srcWidth - 1);
+			uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+			_mm_storeu_ps(out + 4 * x, FilterTexel(
+				DecodeTexel(row0[x0], content, toLinear), DecodeTexel(row0[x1], content, toLinear),
+				DecodeTexel(row1[x0], content, toLinear), DecodeTexel(row1[x1], content, toLinear), content));
+		}
+	}
+}
+
+// Halves a decoded level, odd edges repeat their last texel
+static void DownsampleLevel(float* dst, uint32_t dstWidth, uint32_t dstHeight, const float* src, uint32_t srcWidth, uint32_t srcHeight, ImageContent content)
+{
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		const float* row0 = src + 4 * srcWidth * std::min(2 * y, srcHeight - 1);
+		const float* row1 = src + 4 * srcWidth * std::min(2 * y + 1, srcHeight - 1);
+		float* out = dst + 4 * dstWidth * y;
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			uint32_t x0 = 4 * std::min(2 * x, srcWidth - 1);
+			uint32_t x1 = 4 * std::min(2 * x + 1, srcWidth - 1);
+			_mm_storeu_ps(out + 4 * x, FilterTexel(
+				_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1),
+				_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1), content));
+		}
+	}
+}
+
+// Converts a decoded level back and packs it to rgba8, rounded to the nearest value
+static void EncodeLevel(uint32_t* dst, const float* src, uint32_t pixelCount, ImageContent content)
+{
+	const float* toSRGB = GetSRGBTables()->toSRGB;
+	const __m128 scale = _mm_set1_ps(255.0f);
+	const __m128 normalScale = _mm_setr_ps(0.5f, 0.5f, 0.5f, 1.0f);
+	const __m128 normalBias = _mm_setr_ps(0.5f, 0.5f, 0.5f, 0.0f);
+	for (uint32_t i = 0; i < pixelCount; i++)
+	{
+		__m128 texel = _mm_loadu_ps(src + 4 * i);
+		if (content == IMAGE_CONTENT_COLOR)
+		{
+			float c[4];
+			_mm_storeu_ps(c, _mm_min_ps(_mm_max_ps(texel, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+			c[0] = toSRGB[(uint32_t)(c[0] * SRGB_ENCODE_LUT_SIZE + 0.5f)];
+			c[1] = toSRGB[(uint32_t)(c[1] * SRGB_ENCODE_LUT_SIZE + 0.5f)];
+			c[2] = toSRGB[(uint32_t)(c[2] * SRGB_ENCODE_LUT_SIZE + 0.5f)];
+			texel = _mm_loadu_ps(c);
+		}
+		else if (content == IMAGE_CONTENT_NORMAL)
+			texel = _mm_add_ps(_mm_mul_ps(texel, normalScale), normalBias);
+
+		//the packs saturate, values outside of [0, 1] are clamped
+		__m128i v = _mm_cvtps_epi32(_mm_mul_ps(texel, scale));
+		v = _mm_packs_epi32(v, v);
+		dst[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+	}
+}
+
+// Block compressed format of an image, chosen by its content. Albedo and data with alpha keep it in BC7
+static uint32_t GetImageFormat(ImageContent content, const uint32_t* pixels, uint32_t pixelCount)
+{
+#if IMAGE_BLOCK_COMPRESSION
+	if (content == IMAGE_CONTENT_NORMAL)
+		return IMAGE_FORMAT_BC5;	// z is reconstructed from xy
+	if (content == IMAGE_CONTENT_MASK)
+		return IMAGE_FORMAT_BC4;
+
+	for (uint32_t i = 0; i < pixelCount; i++)
+	{
+		if ((pixels[i] >> 24) != 0xFF)
+			return IMAGE_FORMAT_BC7;
+	}
+	return IMAGE_FORMAT_BC1;
+#else
+	return IMAGE_FORMAT_RGBA8;
+#endif
+}
+
+// Fills in the levels behind the top level of a rgba8 mip chain. The first mip is filtered from the
+// rgba8 level, the rest from the previous level in full precision
+static void BuildMipChain(uint32_t* pixels, const mip_desc_s* levels, uint32_t levelCount, ImageContent content, Memory_Linear_Allocator* tempAlloc)
+{
+	const float* srcLevel = NULL;
+	for (uint32_t i = 1; i < levelCount; i++)
+	{
+		const mip_desc_s* src = &levels[i - 1];
+		const mip_desc_s* dst = &levels[i];
+		float* dstLevel = (float*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, dst->width * dst->height * 4 * sizeof(float));
+		if (i == 1)
+			DownsampleLevelRGBA8(dstLevel, dst->width, dst->height, pixels + src->offset / sizeof(uint32_t), src->width, src->height, content);
+		else
+			DownsampleLevel(dstLevel, dst->width, dst->height, srcLevel, src->width, src->height, content);
+		EncodeLevel(pixels + dst->offset / sizeof(uint32_t), dstLevel, dst->width * dst->height, content);
+		srcLevel = dstLevel;
+	}
+}
 
 uint32_t ConvertAsset_Image
 (
@@ -14,12 +275,15 @@ uint32_t ConvertAsset_Image
 	uint32_t allocatorIdx
 )
 {
-	//TODO LOAD MIPMAPS
+	//8 bit sources are decoded as they are, float decoding is 4 times the memory traffic.
+	//Only HDR sources are decoded to float, they are clamped to rgba8 like everything else
 	int width = 0, height = 0, comp = 0;
-	stbi_set_flip_vertically_on_load(1);
-	stbi_ldr_to_hdr_scale(1.0f);
-	stbi_ldr_to_hdr_gamma(1.0f);
-	float* pixels = stbi_loadf_from_memory((stbi_uc*)data, (int)dataSizeInBytes, &width, &height, &comp, 4);
+	uint32_t hdr = stbi_is_hdr_from_memory((stbi_uc*)data, (int)dataSizeInBytes);
+	void* pixels;
+	if (hdr)
+		pixels = stbi_loadf_from_memory((stbi_uc*)data, (int)dataSizeInBytes, &width, &height, &comp, 4);
+	else
+		pixels = stbi_load_from_memory((stbi_uc*)data, (int)dataSizeInBytes, &width, &height, &comp, 0);
 
 	if (!pixels)
 	{
@@ -27,9 +291,47 @@ uint32_t ConvertAsset_Image
 		return -1;
 	}
 
-	uint32_t totalPixelCount = width * height;
-	uint32_t mips = 1;
-	uint32_t totalByteSize = sizeof(image_desc_s) + totalPixelCount * sizeof(uint32_t) + mips * sizeof(mip_desc_s);
+	//the whole mip chain down to 1x1, the GPU mip pass is skipped for these images
+	mip_desc_s levels[32];
+	uint32_t mips = 0;
+	uint32_t totalPixelCount = 0;
+	uint32_t w = width, h = height;
+	for (;;)
+	{
+		levels[mips].width = w;
+		levels[mips].height = h;
+		levels[mips].offset = totalPixelCount * sizeof(uint32_t);
+		totalPixelCount += w * h;
+		mips++;
+		if (w == 1 && h == 1)
+			break;
+		w = std::max(w >> 1, 1u);
+		h = std::max(h >> 1, 1u);
+	}
+
+	//the rgba8 chain is built in temporary memory, then stored in the format of the image
+	Memory_Linear_Allocator* tempAlloc = CreateVirtualMemoryAllocator(ALLOCATOR_IDX_TEMP, totalPixelCount * sizeof(uint32_t) + (totalPixelCount - width * height) * 4 * sizeof(float));
+	uint32_t* rgbaPixels = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, totalPixelCount * sizeof(uint32_t));
+
+	//flipped vertically while packing, instead of another pass of stb_image
+	for (int32_t y = 0; y < height; y++)
+	{
+		uint32_t* dstRow = rgbaPixels + (height - 1 - y) * width;
+		if (hdr)
+			EncodeLevel(dstRow, (const float*)pixels + 4 * y * width, width, IMAGE_CONTENT_DATA);
+		else
+			ExpandRowRGBA8(dstRow, (const stbi_uc*)pixels + y * width * comp, width, comp);
+	}
+	stbi_image_free(pixels);
+
+	ImageContent content = GetImageContent(basePath);
+	BuildMipChain(rgbaPixels, levels, mips, content, tempAlloc);
+	uint32_t format = GetImageFormat(content, rgbaPixels, width * height);
+
+	uint64_t pixelByteSize = 0;
+	for (uint32_t i = 0; i < mips; i++)
+		pixelByteSize += GetImageLevelSize(format, levels[i].width, levels[i].height);
+	uint64_t totalByteSize = sizeof(image_desc_s) + mips * sizeof(mip_desc_s) + pixelByteSize;
 	uint8_t* assetData = (uint8_t*)AllocateVirtualMemory(ALLOCATOR_IDX_ASSET_DATA, allocator, totalByteSize);
 
 	//assign the first image description(main image)
@@ -39,36 +341,25 @@ uint32_t ConvertAsset_Image
 	image.height = height;
 	image.width = width;
 	image.mipCount = mips;
+	image.format = format;
 	image.mips = mip;
 	*imgDesc = image;
 
-	uint32_t* outPixels = (uint32_t*)(assetData + sizeof(image_desc_s) + mips * sizeof(mip_desc_s));
-	uint32_t* mipPixels = outPixels;
-	
-	mip_desc_s mip0;
-	mip0.width = width;
-	mip0.height = height;
-	mip0.offset = 0;
-	*mip = mip0;
-
-	for (int32_t y = 0; y < height; y++)
+	uint8_t* outPixels = assetData + sizeof(image_desc_s) + mips * sizeof(mip_desc_s);
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < mips; i++)
 	{
-		for (int32_t x = 0; x < width; x++)
-		{
-			float* src = pixels + (4 * (y * width + x));
-			mipPixels[y * width + x] =
-				(((uint32_t)(src[0] * 255.0f)) << 0)
-				| (((uint32_t)(src[1] * 255.0f)) << 8)
-				| (((uint32_t)(src[2] * 255.0f)) << 16)
-				| (((uint32_t)(src[3] * 255.0f)) << 24);
-		}
+		mip[i].width = levels[i].width;
+		mip[i].height = levels[i].height;
+		mip[i].offset = offset;
+		CompressImageLevel(format, rgbaPixels + levels[i].offset / sizeof(uint32_t), levels[i].width, levels[i].height, outPixels + offset);
+		offset += (uint32_t)GetImageLevelSize(format, levels[i].width, levels[i].height);
 	}
+	DestroyVirtualMemoryAllocator(ALLOCATOR_IDX_TEMP, tempAlloc);
 
 	outAsset->type = 'IMG';
-	outAsset->size = sizeof(image_desc_s) + mips * sizeof(mip_desc_s) + totalPixelCount * 4;
+	outAsset->size = totalByteSize;
 	outAsset->data = assetData;
-
-	stbi_image_free(pixels);
 	
 	return 0;
 }
@@ -6,6 +6,9 @@
 #include "Defines.h"
 #include "DataTypes.h"
 #include "AssetManager.h"
+#include "BlockCompression.h"
+
+#define IMAGE_BLOCK_COMPRESSION 1	//images are stored block compressed (BC1, BC4, BC5, BC7) by their content, 0 keeps rgba8
 
 class ImageLoader
 {
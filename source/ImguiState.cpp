@@ -8,6 +8,7 @@
 #include "DataTypes.h"
 #include "AnisotropicVoxelTexture.h"
 #include "Camera.h"
+#include "Defines.h"
 #include "imgui_impl_glfw_vulkan.h"
 
 struct PushConstantComp
@@ -217,6 +218,27 @@ void BuildCommandBufferImGUIState
 			}
 		}
 
+		if (ImGui::CollapsingHeader("Memory"))
+		{
+			// allocator telemetry, per allocator index
+			for (uint32_t i = 0; i < ALLOCATOR_TELEMETRY_SLOTS; i++)
+			{
+				Memory_Allocator_Stats stats;
+				GetVirtualMemoryStats(i, &stats);
+				if (stats.allocationCount == 0 && stats.reservedBytes == 0)
+					continue;
+
+				if (ImGui::TreeNode((void*)(uintptr_t)i, "%s (%u)", stats.name ? stats.name : "allocator", i))
+				{
+					ImGui::Text("Allocators %llu, allocations %llu, failed %llu", stats.allocatorCount, stats.allocationCount, stats.failedAllocationCount);
+					ImGui::Text("Allocated %.2f MB, high-water mark %.2f MB", stats.allocatedBytes / (1024.0 * 1024.0), stats.highWaterMark / (1024.0 * 1024.0));
+					ImGui::Text("Committed %.2f MB of %.2f MB reserved", stats.committedBytes / (1024.0 * 1024.0), stats.reservedBytes / (1024.0 * 1024.0));
+					ImGui::Text("Largest allocation %.2f MB", stats.largestAllocation / (1024.0 * 1024.0));
+					ImGui::TreePop();
+				}
+			}
+		}
+
 		if (ImGui::CollapsingHeader("Options"))
 		{
 			if (ImGui::TreeNode("General Application Options"))
@@ -232,6 +254,14 @@ void BuildCommandBufferImGUIState
 				}
 				ImGui::SameLine();
 				ImGui::SliderInt("Cone Count", &slidercone, 1, 31);
+				// change the texture memory the streaming may use
+				static int sliderbudget = settings->textureBudget;
+				if (ImGui::Button("Apply Budget"))
+				{
+					settings->textureBudget = sliderbudget;
+				}
+				ImGui::SameLine();
+				ImGui::SliderInt("Texture Budget (MB)", &sliderbudget, 32, 4096);
 				ImGui::TreePop();
 			}
 
@@ -288,6 +318,7 @@ void BuildCommandBufferImGUIState
 		ImGui::Text("Base Region Size          %.01f", gridRegion);
 		ImGui::Text("Voxel Resolution          [%i, %i, %i]", avt->m_width, avt->m_height, avt->m_depth);
 		ImGui::Text("Cone Count                %i", settings->conecount);
+		ImGui::Text("Texture Memory            %i / %i MB", settings->textureMemory, settings->textureBudget);
 		ImGui::Text("");
 
 		ImGui::End();
@@ -350,14 +381,17 @@ void CreateImgGUIPipelineState(
 	renderState.m_framebuffers = NULL;
 	renderState.m_framebufferCount = 0;
 
-	// Create the semaphore
-	if (!renderState.m_commandBuffers)
+	// Rebuilt every frame, the state owns its pool and recycles it with vkResetCommandPool
+	if (!renderState.m_commandPool)
 	{
-		renderState.m_commandBufferCount = framebufferCount;
-		renderState.m_commandBuffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer)*renderState.m_commandBufferCount);
-		for (uint32_t i = 0; i < renderState.m_commandBufferCount; i++)
-			renderState.m_commandBuffers[i] = VKTools::Initializers::CreateCommandBuffer(commandPool, core->GetViewDevice(), VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+		VkCommandPoolCreateInfo cmdPoolInfo = {};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		cmdPoolInfo.queueFamilyIndex = core->GetQueueFamiliyIndex(VK_QUEUE_GRAPHICS_BIT);
+		VK_CHECK_RESULT(vkCreateCommandPool(core->GetViewDevice(), &cmdPoolInfo, NULL, &renderState.m_commandPool));
 	}
+	AcquireCommandBuffers(renderState, renderState.m_commandPool, core->GetViewDevice(), framebufferCount);
+	// Create the semaphore
 	if (!renderState.m_semaphores)
 	{
 		renderState.m_semaphoreCount = 1;
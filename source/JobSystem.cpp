@@ -0,0 +1,143 @@
+#include "JobSystem.h"
+
+#include <assert.h>
+
+static thread_local uint32_t t_workerIdx = 0;
+
+JobSystem::JobSystem()
+{
+	m_workerCount = 1;
+	m_queuedJobs = 0;
+	m_running = 0;
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+int32_t JobSystem::Init(uint32_t workerCount)
+{
+	assert(!m_running);
+	if (workerCount == 0)
+		workerCount = std::thread::hardware_concurrency();
+	if (workerCount == 0)
+		workerCount = 1;
+	if (workerCount > JOBSYSTEM_MAX_WORKERS)
+		workerCount = JOBSYSTEM_MAX_WORKERS;
+
+	m_workerCount = workerCount;
+	m_running = 1;
+	t_workerIdx = 0;
+	//worker 0 is the calling thread
+	for (uint32_t i = 1; i < m_workerCount; i++)
+		m_threads[i] = std::thread(WorkerMain, this, i);
+
+	return 0;
+}
+
+void JobSystem::Shutdown()
+{
+	if (!m_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(m_sleepLock);
+		m_running = 0;
+	}
+	m_sleepCondition.notify_all();
+	for (uint32_t i = 1; i < m_workerCount; i++)
+		m_threads[i].join();
+	m_workerCount = 1;
+}
+
+uint32_t JobSystem::GetCurrentWorker()
+{
+	return t_workerIdx;
+}
+
+void JobSystem::Submit(sig_JobFunc func, void* data, std::atomic<uint32_t>* counter)
+{
+	Job job = { func, data, counter };
+	if (counter)
+		(*counter)++;
+
+	//count before pushing, a thief can only decrement after the push
+	{
+		std::lock_guard<std::mutex> guard(m_sleepLock);
+		m_queuedJobs++;
+	}
+	WorkQueue& queue = m_queues[t_workerIdx];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.jobs.push_back(job);
+	}
+	m_sleepCondition.notify_one();
+}
+
+uint32_t JobSystem::Pop(uint32_t workerIdx, Job* outJob)
+{
+	//own queue first, newest job
+	{
+		WorkQueue& queue = m_queues[workerIdx];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.jobs.empty())
+		{
+			*outJob = queue.jobs.back();
+			queue.jobs.pop_back();
+			m_queuedJobs--;
+			return 1;
+		}
+	}
+	//steal the oldest job of another worker
+	for (uint32_t i = 1; i < m_workerCount; i++)
+	{
+		WorkQueue& queue = m_queues[(workerIdx + i) % m_workerCount];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.jobs.empty())
+		{
+			*outJob = queue.jobs.front();
+			queue.jobs.pop_front();
+			m_queuedJobs--;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void JobSystem::Wait(std::atomic<uint32_t>* counter)
+{
+	uint32_t workerIdx = t_workerIdx;
+	while (*counter)
+	{
+		Job job;
+		if (Pop(workerIdx, &job))
+		{
+			job.func(job.data, workerIdx);
+			if (job.counter)
+				(*job.counter)--;
+		}
+		else
+			std::this_thread::yield();		//the remaining jobs are running on other workers
+	}
+}
+
+void JobSystem::WorkerMain(JobSystem* jobSystem, uint32_t workerIdx)
+{
+	t_workerIdx = workerIdx;
+	while (jobSystem->m_running)
+	{
+		Job job;
+		if (jobSystem->Pop(workerIdx, &job))
+		{
+			job.func(job.data, workerIdx);
+			if (job.counter)
+				(*job.counter)--;
+			continue;
+		}
+
+		//sleep until new work is submitted
+		std::unique_lock<std::mutex> lock(jobSystem->m_sleepLock);
+		jobSystem->m_sleepCondition.wait(lock, [jobSystem]() { return jobSystem->m_queuedJobs > 0 || !jobSystem->m_running; });
+	}
+}
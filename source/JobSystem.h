@@ -0,0 +1,57 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define JOBSYSTEM_MAX_WORKERS 16		//including the main thread, worker 0
+
+typedef void(*sig_JobFunc)(void* data, uint32_t workerIdx);
+
+struct Job
+{
+	sig_JobFunc func;
+	void* data;
+	std::atomic<uint32_t>* counter;		//decremented when the job finished, can be NULL
+};
+
+// Work stealing job system. Every worker owns a queue, it pops its own jobs from the back (newest first)
+// and steals from the front of the other queues when it runs dry. The main thread is worker 0 and only
+// executes jobs while it waits on a counter.
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	int32_t Init(uint32_t workerCount);		//0 uses one worker per hardware thread
+	void Shutdown();
+	void Submit(sig_JobFunc func, void* data, std::atomic<uint32_t>* counter);	//pushes on the queue of the calling worker
+	void Wait(std::atomic<uint32_t>* counter);		//executes jobs until the counter reaches 0
+	uint32_t GetWorkerCount() const { return m_workerCount; }
+	static uint32_t GetCurrentWorker();				//index of the calling thread, 0 for the main thread
+
+private:
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<Job> jobs;
+	};
+
+	uint32_t Pop(uint32_t workerIdx, Job* outJob);
+	static void WorkerMain(JobSystem* jobSystem, uint32_t workerIdx);
+
+	WorkQueue m_queues[JOBSYSTEM_MAX_WORKERS];
+	std::thread m_threads[JOBSYSTEM_MAX_WORKERS];
+	uint32_t m_workerCount;
+	std::atomic<uint32_t> m_queuedJobs;
+	std::atomic<uint32_t> m_running;
+	std::mutex m_sleepLock;
+	std::condition_variable m_sleepCondition;
+};
+
+#endif	//JOBSYSTEM_H
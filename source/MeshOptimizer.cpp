@@ -0,0 +1,344 @@
+#include "MeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+
+#include "DataTypes.h"
+#include "Defines.h"
+#include "MurmurHash.h"
+
+// A vertex is in the FIFO cache while fewer than cacheSize vertices were transformed after it.
+// Timestamps start at 0 and the clock at cacheSize + 1, so every vertex starts as a miss
+static inline uint32_t TouchVertex(uint32_t* timestamps, uint32_t* time, uint32_t vertex, uint32_t cacheSize)
+{
+	if (*time - timestamps[vertex] <= cacheSize)
+		return 0;
+	timestamps[vertex] = (*time)++;
+	return 1;
+}
+
+static uint32_t* AllocateZeroed(Memory_Linear_Allocator* tempAlloc, uint64_t count)
+{
+	uint32_t* memory = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, count * sizeof(uint32_t));
+	assert(memory);
+	memset(memory, 0, count * sizeof(uint32_t));
+	return memory;
+}
+
+uint32_t SimulateVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize, Memory_Linear_Allocator* tempAlloc)
+{
+	uint32_t* timestamps = AllocateZeroed(tempAlloc, vertexCount);
+	uint32_t time = cacheSize + 1;
+
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+		misses += TouchVertex(timestamps, &time, indices[i], cacheSize);
+
+	RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, timestamps);
+	return misses;
+}
+
+// Next vertex to fan around: a vertex of the last fan that stays in the cache while its remaining triangles
+// are emitted, the oldest one first. Without one the most recently used vertex with triangles left, then the
+// first vertex in index order with triangles left. Returns -1 when every triangle is emitted
+static int64_t GetNextVertex(const uint32_t* candidates, uint32_t candidateCount, const uint32_t* timestamps, uint32_t time, const uint32_t* liveCount,
+	const uint32_t* deadEnds, uint32_t* deadEndCount, uint32_t* cursor, uint32_t vertexCount, uint32_t cacheSize)
+{
+	int64_t best = -1;
+	int64_t bestPriority = -1;
+	for (uint32_t i = 0; i < candidateCount; i++)
+	{
+		uint32_t v = candidates[i];
+		if (liveCount[v] == 0)
+			continue;
+
+		int64_t priority = 0;
+		if (time - timestamps[v] + 2 * liveCount[v] <= cacheSize)
+			priority = time - timestamps[v];
+		if (priority > bestPriority)
+		{
+			bestPriority = priority;
+			best = v;
+		}
+	}
+	if (best >= 0)
+		return best;
+
+	while (*deadEndCount)
+	{
+		uint32_t v = deadEnds[--(*deadEndCount)];
+		if (liveCount[v])
+			return v;
+	}
+
+	while (*cursor < vertexCount)
+	{
+		if (liveCount[*cursor])
+			return *cursor;
+		(*cursor)++;
+	}
+	return -1;
+}
+
+void OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize, Memory_Linear_Allocator* tempAlloc)
+{
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// triangles of every vertex, liveCount counts the ones not emitted yet
+	uint32_t* liveCount = AllocateZeroed(tempAlloc, vertexCount);
+	uint32_t* adjacencyStart = AllocateZeroed(tempAlloc, vertexCount + 1);
+	uint32_t* adjacency = AllocateZeroed(tempAlloc, indexCount);
+	uint32_t* timestamps = AllocateZeroed(tempAlloc, vertexCount);
+	uint32_t* deadEnds = AllocateZeroed(tempAlloc, indexCount);
+	uint32_t* candidates = AllocateZeroed(tempAlloc, indexCount);
+	uint32_t* emitted = AllocateZeroed(tempAlloc, triangleCount);
+	uint32_t* output = AllocateZeroed(tempAlloc, indexCount);
+
+	for (uint32_t i = 0; i < indexCount; i++)
+		liveCount[indices[i]]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveCount[v];
+	for (uint32_t i = 0; i < indexCount; i++)
+		adjacency[adjacencyStart[indices[i]]++] = i / 3;
+	for (uint32_t v = vertexCount; v > 0; v--)
+		adjacencyStart[v] = adjacencyStart[v - 1];
+	adjacencyStart[0] = 0;
+
+	uint32_t time = cacheSize + 1;
+	uint32_t deadEndCount = 0;
+	uint32_t cursor = 0;
+	uint32_t outputCount = 0;
+
+	int64_t fan = GetNextVertex(NULL, 0, timestamps, time, liveCount, deadEnds, &deadEndCount, &cursor, vertexCount, cacheSize);
+	while (fan >= 0)
+	{
+		// emit every remaining triangle around the fan vertex
+		uint32_t candidateCount = 0;
+		for (uint32_t a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++)
+		{
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = 1;
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t v = indices[triangle * 3 + k];
+				output[outputCount++] = v;
+				deadEnds[deadEndCount++] = v;
+				candidates[candidateCount++] = v;
+				liveCount[v]--;
+				TouchVertex(timestamps, &time, v, cacheSize);
+			}
+		}
+
+		fan = GetNextVertex(candidates, candidateCount, timestamps, time, liveCount, deadEnds, &deadEndCount, &cursor, vertexCount, cacheSize);
+	}
+	assert(outputCount == triangleCount * 3);
+
+	memcpy(indices, output, triangleCount * 3 * sizeof(uint32_t));
+	RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, liveCount);
+}
+
+struct OverdrawCluster
+{
+	uint32_t start, end;	//triangles
+	float sortKey;
+};
+
+void OptimizeOverdraw(uint32_t* indices, uint32_t indexCount, const float* positions, uint32_t positionStride, uint32_t vertexCount, uint32_t cacheSize, float threshold, Memory_Linear_Allocator* tempAlloc)
+{
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	uint32_t* timestamps = AllocateZeroed(tempAlloc, vertexCount);
+	uint32_t* hardStarts = AllocateZeroed(tempAlloc, triangleCount + 1);
+	uint32_t* output = AllocateZeroed(tempAlloc, indexCount);
+	OverdrawCluster* clusters = (OverdrawCluster*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, triangleCount * sizeof(OverdrawCluster));
+	assert(clusters);
+	uint32_t time = cacheSize + 1;
+
+	// hard boundaries, the cache order jumps to a new area where a triangle misses all its vertices
+	uint32_t hardCount = 0;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < 3; k++)
+			misses += TouchVertex(timestamps, &time, indices[t * 3 + k], cacheSize);
+		if (t == 0 || misses == 3)
+			hardStarts[hardCount++] = t;
+	}
+	hardStarts[hardCount] = triangleCount;
+
+	// soft boundaries, a cluster ends as soon as its ACMR is within the threshold of the ACMR of its hard cluster
+	uint32_t clusterCount = 0;
+	for (uint32_t h = 0; h < hardCount; h++)
+	{
+		uint32_t start = hardStarts[h], end = hardStarts[h + 1];
+
+		time += cacheSize + 1;
+		uint32_t hardMisses = 0;
+		for (uint32_t i = start * 3; i < end * 3; i++)
+			hardMisses += TouchVertex(timestamps, &time, indices[i], cacheSize);
+		float clusterThreshold = threshold * hardMisses / (end - start);
+
+		clusters[clusterCount].start = start;
+		time += cacheSize + 1;
+		uint32_t misses = 0, triangles = 0;
+		for (uint32_t t = start; t < end; t++)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+				misses += TouchVertex(timestamps, &time, indices[t * 3 + k], cacheSize);
+			triangles++;
+
+			if (t + 1 < end && (float)misses / triangles <= clusterThreshold)
+			{
+				clusters[clusterCount++].end = t + 1;
+				clusters[clusterCount].start = t + 1;
+				time += cacheSize + 1;
+				misses = 0, triangles = 0;
+			}
+		}
+		clusters[clusterCount++].end = end;
+	}
+	if (clusterCount < 2)
+	{
+		RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, timestamps);
+		return;
+	}
+
+	// clusters far out along their own normal occlude the others from most directions, those are drawn first
+	const uint8_t* positionBytes = (const uint8_t*)positions;
+	glm::vec3 meshCentroid = glm::vec3(0.0f);
+	for (uint32_t i = 0; i < indexCount; i++)
+		meshCentroid += *(const glm::vec3*)(positionBytes + (uint64_t)indices[i] * positionStride);
+	meshCentroid /= (float)indexCount;
+
+	for (uint32_t c = 0; c < clusterCount; c++)
+	{
+		glm::vec3 centroid = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = clusters[c].start; t < clusters[c].end; t++)
+		{
+			glm::vec3 p0 = *(const glm::vec3*)(positionBytes + (uint64_t)indices[t * 3 + 0] * positionStride);
+			glm::vec3 p1 = *(const glm::vec3*)(positionBytes + (uint64_t)indices[t * 3 + 1] * positionStride);
+			glm::vec3 p2 = *(const glm::vec3*)(positionBytes + (uint64_t)indices[t * 3 + 2] * positionStride);
+
+			glm::vec3 scaledNormal = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(scaledNormal);
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += scaledNormal;
+			area += triangleArea;
+		}
+
+		float normalLength = glm::length(normal);
+		float sortKey = 0.0f;
+		if (area > 0.0f && normalLength > 0.0f)
+			sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+		clusters[c].sortKey = isnan(sortKey) ? 0.0f : sortKey;
+	}
+
+	std::sort(clusters, clusters + clusterCount, [](const OverdrawCluster& a, const OverdrawCluster& b)
+	{
+		return a.sortKey > b.sortKey || (a.sortKey == b.sortKey && a.start < b.start);
+	});
+
+	uint32_t outputCount = 0;
+	for (uint32_t c = 0; c < clusterCount; c++)
+	{
+		uint32_t clusterIndexCount = (clusters[c].end - clusters[c].start) * 3;
+		memcpy(output + outputCount, indices + clusters[c].start * 3, clusterIndexCount * sizeof(uint32_t));
+		outputCount += clusterIndexCount;
+	}
+	assert(outputCount == triangleCount * 3);
+
+	memcpy(indices, output, triangleCount * 3 * sizeof(uint32_t));
+	RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, timestamps);
+}
+
+static uint64_t HashVertex(const uint8_t* const* streams, const uint32_t* strides, uint32_t streamCount, uint32_t vertex)
+{
+	uint64_t hash[2] = { 0, 0 };
+	for (uint32_t s = 0; s < streamCount; s++)
+		MurmurHash3_x64_128(streams[s] + (uint64_t)vertex * strides[s], strides[s], (uint32_t)hash[0], hash);
+	return hash[0];
+}
+
+static bool CompareVertices(const uint8_t* const* streams, const uint32_t* strides, uint32_t streamCount, uint32_t a, uint32_t b)
+{
+	for (uint32_t s = 0; s < streamCount; s++)
+	{
+		if (memcmp(streams[s] + (uint64_t)a * strides[s], streams[s] + (uint64_t)b * strides[s], strides[s]) != 0)
+			return false;
+	}
+	return true;
+}
+
+uint32_t WeldVertices(uint32_t* remap, const uint8_t* const* streams, const uint32_t* strides, uint32_t streamCount, uint32_t vertexCount, Memory_Linear_Allocator* tempAlloc)
+{
+	// open addressed table of the distinct vertices, at most half full
+	uint32_t slotCount = 1;
+	while (slotCount < (uint64_t)vertexCount * 2)
+		slotCount <<= 1;
+	uint32_t* table = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, slotCount * sizeof(uint32_t));
+	assert(table);
+	memset(table, 0xFF, slotCount * sizeof(uint32_t));
+
+	uint32_t distinctCount = 0;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		uint32_t slot = (uint32_t)HashVertex(streams, strides, streamCount, v) & (slotCount - 1);
+		while (table[slot] != 0xFFFFFFFF && !CompareVertices(streams, strides, streamCount, table[slot], v))
+			slot = (slot + 1) & (slotCount - 1);
+
+		if (table[slot] == 0xFFFFFFFF)
+		{
+			table[slot] = v;
+			distinctCount++;
+		}
+		remap[v] = table[slot];
+	}
+
+	RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, table);
+	return distinctCount;
+}
+
+uint32_t OptimizeVertexFetch(uint32_t* remap, uint32_t* const* indexLists, const uint32_t* indexCounts, uint32_t listCount, uint32_t vertexCount)
+{
+	memset(remap, 0xFF, vertexCount * sizeof(uint32_t));
+
+	uint32_t nextVertex = 0;
+	for (uint32_t l = 0; l < listCount; l++)
+	{
+		uint32_t* indices = indexLists[l];
+		for (uint32_t i = 0; i < indexCounts[l]; i++)
+		{
+			uint32_t v = indices[i];
+			if (remap[v] == 0xFFFFFFFF)
+				remap[v] = nextVertex++;
+			indices[i] = remap[v];
+		}
+	}
+
+	uint32_t usedCount = nextVertex;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == 0xFFFFFFFF)
+			remap[v] = nextVertex++;
+	}
+	assert(nextVertex == vertexCount);
+	return usedCount;
+}
+
+void RemapVertexBuffer(void* vertices, uint32_t vertexStride, uint32_t vertexCount, const uint32_t* remap, void* scratch)
+{
+	memcpy(scratch, vertices, (uint64_t)vertexCount * vertexStride);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		memcpy((uint8_t*)vertices + (uint64_t)remap[v] * vertexStride, (const uint8_t*)scratch + (uint64_t)v * vertexStride, vertexStride);
+}
@@ -0,0 +1,30 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <stdint.h>
+
+struct Memory_Linear_Allocator;
+
+// Entries of the FIFO post-transform vertex cache the triangle orders are built for and measured with
+#define MESH_VERTEX_CACHE_SIZE 16
+// The overdraw pass may raise the ACMR of a cluster by this factor to split it in smaller clusters
+#define MESH_OVERDRAW_THRESHOLD 1.05f
+
+// Vertices a triangle list transforms, starting with an empty cache. The ACMR is this over the triangle count.
+// Scratch memory of every function comes from the temp allocator and is released before it returns
+uint32_t SimulateVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize, Memory_Linear_Allocator* tempAlloc);
+// Reorders the triangles of a list for the vertex cache (Tipsify, Sander et al. 2007), triangles keep their winding
+void OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize, Memory_Linear_Allocator* tempAlloc);
+// Splits a cache optimized list into clusters and sorts them to draw the outward facing clusters first.
+// Positions are 3 floats, positionStride bytes apart
+void OptimizeOverdraw(uint32_t* indices, uint32_t indexCount, const float* positions, uint32_t positionStride, uint32_t vertexCount, uint32_t cacheSize, float threshold, Memory_Linear_Allocator* tempAlloc);
+// Maps every vertex to the first vertex with the same bytes in every stream, the stream of a vertex is
+// at streams[s] + vertex * strides[s]. Returns the number of distinct vertices
+uint32_t WeldVertices(uint32_t* remap, const uint8_t* const* streams, const uint32_t* strides, uint32_t streamCount, uint32_t vertexCount, Memory_Linear_Allocator* tempAlloc);
+// Numbers the vertices in the order the lists first use them and rewrites the lists, unused vertices go last.
+// remap receives the new index of every vertex, returns the number of used vertices
+uint32_t OptimizeVertexFetch(uint32_t* remap, uint32_t* const* indexLists, const uint32_t* indexCounts, uint32_t listCount, uint32_t vertexCount);
+// Moves every vertex of a buffer to its new index, scratch holds vertexCount * vertexStride bytes
+void RemapVertexBuffer(void* vertices, uint32_t vertexStride, uint32_t vertexCount, const uint32_t* remap, void* scratch);
+
+#endif	//MESHOPTIMIZER_H
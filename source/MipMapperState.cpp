@@ -39,10 +39,7 @@ void BuildCommandBufferMipMapperState(
 	////////////////////////////////////////////////////////////////////////////////
 	// Rebuild the command buffers
 	////////////////////////////////////////////////////////////////////////////////
-	renderState->m_commandBufferCount = avt->m_cascadeCount;;
-	renderState->m_commandBuffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer)*renderState->m_commandBufferCount);
-	for (uint32_t i = 0; i < renderState->m_commandBufferCount; i++)
-		renderState->m_commandBuffers[i] = VKTools::Initializers::CreateCommandBuffer(commandpool, core->GetViewDevice(), VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+	AcquireCommandBuffers(*renderState, commandpool, core->GetViewDevice(), avt->m_cascadeCount);
 
 	////////////////////////////////////////////////////////////////////////////////
 	// Record command buffer
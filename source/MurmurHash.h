@@ -3,14 +3,26 @@
 #define MURMURHASH_H
 
 #include <stdint.h>
+#include <stdlib.h>
 
+#ifdef _MSC_VER
 #define FORCE_INLINE	__forceinline
 #define ROTL64(x,y)	_rotl64(x,y)
 #define BIG_CONSTANT(x) (x)
+#else
+#define FORCE_INLINE	inline __attribute__((always_inline))
+#define ROTL64(x,y)	rotl64(x,y)
+#define BIG_CONSTANT(x) (x##LLU)
 
-void MurmurHash3_x64_128(const void * key, const int len, const uint32_t seed, void * out);
-uint32_t Hash32Shift(uint32_t key);
-uint64_t Hash64Shift(uint64_t key);
+inline uint64_t rotl64(uint64_t x, int8_t r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+#endif
+
+inline void MurmurHash3_x64_128(const void * key, const int len, const uint32_t seed, void * out);
+inline uint32_t Hash32Shift(uint32_t key);
+inline uint64_t Hash64Shift(uint64_t key);
 
 FORCE_INLINE uint64_t GetBlock64(const uint64_t * p, int i)
 {
@@ -29,7 +41,7 @@ FORCE_INLINE uint64_t fmix64(uint64_t k)
 }
 
 // 32-bit Wang integer hash: http://www.concentric.net/~Ttwang/tech/inthash.htm
-uint32_t  Hash32Shift(uint32_t key)
+inline uint32_t Hash32Shift(uint32_t key)
 {
 	key = ~key + (key << 15); // key = (key << 15) - key - 1;
 	key = key ^ (key >> 12);
@@ -41,7 +53,7 @@ uint32_t  Hash32Shift(uint32_t key)
 }
 
 // 64-bit Wang integer hash: http://www.concentric.net/~Ttwang/tech/inthash.htm
-uint64_t Hash64Shift(uint64_t key)
+inline uint64_t Hash64Shift(uint64_t key)
 {
 	key = (~key) + (key << 21); // key = (key << 21) - key - 1;
 	key = key ^ (key >> 24);
@@ -53,7 +65,7 @@ uint64_t Hash64Shift(uint64_t key)
 	return key;
 }
 
-void MurmurHash3_x64_128(const void * key, const int len,
+inline void MurmurHash3_x64_128(const void * key, const int len,
 	const uint32_t seed, void * out)
 {
 	const uint8_t * data = (const uint8_t*)key;
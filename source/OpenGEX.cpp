@@ -42,19 +42,26 @@
 
 #include "OpenGEX.h"
 
-#include <windows.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 
 #include "AssetManager.h"
+#include "CompiledScene.h"
+#include "MeshOptimizer.h"
 #include "MurmurHash.h"
 #include "Defines.h"
 
+#include <glm/gtc/packing.hpp>
+
 using namespace OGEX;
 
 #define DEFAULT_SEED 0xA86F13C7
-
-extern void LoadAssetStaticManager(char* path, uint32_t pathLenght);
+#define OGEX_STRINGTABLE_INITIAL_SLOTS 1024
+#define OGEX_TEXTURETABLE_INITIAL_SLOTS 64
+#define OGEX_TABLE_EMPTY 0xFFFFFFFFFFFFFFFFULL
+//#define OGEX_QUANTIZE_POSITIONS						//store the positions as 16 bit, quantized to the bounds of the scene
 
 enum upVector
 {
@@ -76,13 +83,6 @@ enum
 	FLAG_HAS_NORMAL = (1 << 3),
 };
 
-enum
-{
-	VERTEX_BUFFER_ELEMENT_TYPE_HALF,
-	VERTEX_BUFFER_ELEMENT_TYPE_FLOAT,
-	VERTEX_BUFFER_ELEMENT_TYPE_DOUBLE
-};
-
 struct OgexScanInfo
 {
 	uint32_t modelCount, meshCount, materialCount;
@@ -94,21 +94,19 @@ struct OgexScanInfo
 	uint64_t totalVertexByteCount, totalIndexByteCount;
 	uint32_t flags;
 
+	// Open addressed tables, always a power of two slots and grown before they are half full
 	struct OgexStringTableEntry
 	{
 		uint64_t hash;
-		union
-		{
-			const char* strPtr;
-			uint64_t offset;
-		};
+		const char* strPtr;		// NULL when the slot is unused
+		uint64_t offset;		// offset of the string in the string data of the scene
 	} *stringTable;
-
 	uint32_t stringTableSlots;
+	uint32_t stringCount;
 
 	struct ogesTextureTableEntry
 	{
-		uint64_t pathOffset;
+		uint64_t pathOffset;	// OGEX_TABLE_EMPTY when the slot is unused
 		uint32_t textureIndex;
 	}*textureTable;
 	uint32_t textureTableSlots;
@@ -116,29 +114,70 @@ struct OgexScanInfo
 
 	//////////////////////////
 
+	void InitTables()
+	{
+		stringTableSlots = OGEX_STRINGTABLE_INITIAL_SLOTS;
+		stringTable = (OgexStringTableEntry*)calloc(stringTableSlots, sizeof(OgexStringTableEntry));
+		stringCount = 0;
+
+		textureTableSlots = OGEX_TEXTURETABLE_INITIAL_SLOTS;
+		textureTable = (ogesTextureTableEntry*)malloc(textureTableSlots * sizeof(ogesTextureTableEntry));
+		memset(textureTable, 0xFF, textureTableSlots * sizeof(ogesTextureTableEntry));
+		textureCount = 0;
+	}
+
+	void DestroyTables()
+	{
+		free(stringTable);
+		free(textureTable);
+		stringTable = NULL;
+		textureTable = NULL;
+	}
+
+	//////////////////////////
+
+	void GrowStringTable()
+	{
+		OgexStringTableEntry* oldTable = stringTable;
+		uint32_t oldSlots = stringTableSlots;
+
+		stringTableSlots = oldSlots * 2;
+		stringTable = (OgexStringTableEntry*)calloc(stringTableSlots, sizeof(OgexStringTableEntry));
+		for (uint32_t i = 0; i < oldSlots; i++)
+		{
+			if (oldTable[i].strPtr == NULL)
+				continue;
+
+			uint32_t slot = (uint32_t)oldTable[i].hash & (stringTableSlots - 1);
+			while (stringTable[slot].strPtr != NULL)
+				slot = (slot + 1) & (stringTableSlots - 1);
+			stringTable[slot] = oldTable[i];
+		}
+		free(oldTable);
+	}
+
 	void AddString(const char* string)
 	{
 		uint64_t out[2];
 		MurmurHash3_x64_128(string, (int)strlen(string), DEFAULT_SEED, out);
 
-		uint64_t slot = out[1] % stringTableSlots;
-		for (uint32_t i = 0; i < 32; i++)
+		if ((stringCount + 1) * 2 > stringTableSlots)
+			GrowStringTable();
+
+		uint32_t slot = (uint32_t)out[0] & (stringTableSlots - 1);
+		while (stringTable[slot].strPtr != NULL)
 		{
-			if (stringTable[slot].strPtr == NULL)
-			{
-				stringTable[slot].strPtr = string;
-				stringTable[slot].hash = out[0];
-				return;
-			}
-			else if (stringTable[slot].hash == out[0])
+			if (stringTable[slot].hash == out[0])
 			{
 				assert(strcmp(string, stringTable[slot].strPtr) == 0);	// Make sure this is not a hash collision
 				return;	// Already in the table; Dupe!
 			}
-			out[1] = Hash64Shift(out[1]);
-			slot = out[1] % stringTableSlots;
+			slot = (slot + 1) & (stringTableSlots - 1);
 		}
-		assert(false); // Could not find an empty slot!
+
+		stringTable[slot].hash = out[0];
+		stringTable[slot].strPtr = string;
+		stringCount++;
 	}
 
 	uint64_t FindStringOffset(const char* string)
@@ -146,66 +185,72 @@ struct OgexScanInfo
 		uint64_t out[2];
 		MurmurHash3_x64_128(string, (int)strlen(string), DEFAULT_SEED, out);
 
-		uint64_t slot = out[1] % stringTableSlots;
-		for (uint32_t i = 0; i < 32; i++)
+		uint32_t slot = (uint32_t)out[0] & (stringTableSlots - 1);
+		while (stringTable[slot].strPtr != NULL)
 		{
-			assert(stringTable[slot].offset != 0xFFFFFFFFFFFFFFFFULL);
 			if (stringTable[slot].hash == out[0])
-			{
 				return stringTable[slot].offset;
-			}
-			out[1] = Hash64Shift(out[1]);
-			slot = out[1] % stringTableSlots;
+			slot = (slot + 1) & (stringTableSlots - 1);
 		}
-		assert(false); // Could not find an empty slot!
-		return 0xFFFFFFFFFFFFFFFF;
+		assert(false); // String was never added
+		return OGEX_TABLE_EMPTY;
 	}
 
 	//////////////////////////
 
+	void GrowTextureTable()
+	{
+		ogesTextureTableEntry* oldTable = textureTable;
+		uint32_t oldSlots = textureTableSlots;
+
+		textureTableSlots = oldSlots * 2;
+		textureTable = (ogesTextureTableEntry*)malloc(textureTableSlots * sizeof(ogesTextureTableEntry));
+		memset(textureTable, 0xFF, textureTableSlots * sizeof(ogesTextureTableEntry));
+		for (uint32_t i = 0; i < oldSlots; i++)
+		{
+			if (oldTable[i].pathOffset == OGEX_TABLE_EMPTY)
+				continue;
+
+			uint32_t slot = (uint32_t)Hash64Shift(oldTable[i].pathOffset) & (textureTableSlots - 1);
+			while (textureTable[slot].pathOffset != OGEX_TABLE_EMPTY)
+				slot = (slot + 1) & (textureTableSlots - 1);
+			textureTable[slot] = oldTable[i];
+		}
+		free(oldTable);
+	}
+
 	uint32_t AddTexture(uint64_t pathOffset)
 	{
-		uint64_t hash = pathOffset;
-		uint64_t slot = hash % textureTableSlots;
-		for (uint32_t i = 0; i < 32; i++)
+		if ((textureCount + 1) * 2 > textureTableSlots)
+			GrowTextureTable();
+
+		uint32_t slot = (uint32_t)Hash64Shift(pathOffset) & (textureTableSlots - 1);
+		while (textureTable[slot].pathOffset != OGEX_TABLE_EMPTY)
 		{
-			if (textureTable[slot].pathOffset == 0xFFFFFFFFFFFFFFFF)
-			{
-				textureTable[slot].pathOffset = pathOffset;
-				textureTable[slot].textureIndex = textureCount++;
-				return textureTable[slot].textureIndex;
-			}
-			else if (textureTable[slot].pathOffset == pathOffset)
-			{
+			if (textureTable[slot].pathOffset == pathOffset)
 				return textureTable[slot].textureIndex;	// Already in the table; Dupe!
-			}
-			hash = Hash64Shift(hash);
-			slot = hash % textureTableSlots;
+			slot = (slot + 1) & (textureTableSlots - 1);
 		}
-		assert(false); // Could not find an empty slot!
-		return 0xFFFFFFFF;
+
+		textureTable[slot].pathOffset = pathOffset;
+		textureTable[slot].textureIndex = textureCount++;
+		return textureTable[slot].textureIndex;
 	}
 
 	uint32_t FindTexture(uint64_t pathOffset)
 	{
-		uint64_t hash = pathOffset;
-		uint64_t slot = hash % textureTableSlots;
-		for (uint32_t i = 0; i < 32; i++)
+		uint32_t slot = (uint32_t)Hash64Shift(pathOffset) & (textureTableSlots - 1);
+		while (textureTable[slot].pathOffset != OGEX_TABLE_EMPTY)
 		{
 			if (textureTable[slot].pathOffset == pathOffset)
-			{
 				return textureTable[slot].textureIndex;
-			}
-			hash = Hash64Shift(hash);
-			slot = hash % textureTableSlots;
+			slot = (slot + 1) & (textureTableSlots - 1);
 		}
-		assert(false); // Could not find an empty slot!
+		assert(false); // Texture was never added
 		return 0xFFFFFFFF;
 	}
 };
 
-OgexScanInfo* ScanInfo;
-
 OpenGexStructure::OpenGexStructure(StructureType type) : Structure(type)
 {
 }
@@ -928,6 +973,8 @@ bool NodeStructure::ValidateSubstructure(const DataDescription *dataDescription,
 
 DataResult NodeStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	DataResult result = Structure::ProcessData(dataDescription);
 	if (result != kDataOkay)
 	{
@@ -944,7 +991,7 @@ DataResult NodeStructure::ProcessData(DataDescription *dataDescription)
 
 		nodeName = static_cast<const NameStructure *>(structure)->GetName();
 		//edit
-		ScanInfo->AddString(nodeName);
+		scanInfo->AddString(nodeName);
 	}
 	else
 	{
@@ -1049,6 +1096,8 @@ bool GeometryNodeStructure::ValidateSubstructure(const DataDescription *dataDesc
 
 DataResult GeometryNodeStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	DataResult result = NodeStructure::ProcessData(dataDescription);
 	if (result != kDataOkay)
 	{
@@ -1135,8 +1184,8 @@ DataResult GeometryNodeStructure::ProcessData(DataDescription *dataDescription)
 
 	// Do application-specific node processing here.
 	//edit
-	ScanInfo->modelReferenceCount++;
-	ScanInfo->materialReferenceCount += maxMaterialIndex + 1;
+	scanInfo->modelReferenceCount++;
+	scanInfo->materialReferenceCount += maxMaterialIndex + 1;
 
 	return (kDataOkay);
 }
@@ -1341,6 +1390,8 @@ bool VertexArrayStructure::ValidateSubstructure(const DataDescription *dataDescr
 
 DataResult VertexArrayStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	const Structure *structure = GetFirstCoreSubnode();
 	if (!structure)
 	{
@@ -1354,7 +1405,7 @@ DataResult VertexArrayStructure::ProcessData(DataDescription *dataDescription)
 
 	//edit
 	// Do something with the vertex data here.
-	vertexArrayIndex = ScanInfo->vertexArrayCount++;
+	vertexArrayIndex = scanInfo->vertexArrayCount++;
 
 	const ODDL::Structure* dataStructure = GetFirstSubnode();
 	switch (dataStructure->GetStructureType())
@@ -1401,7 +1452,7 @@ DataResult VertexArrayStructure::ProcessData(DataDescription *dataDescription)
 	default:
 		return (kDataExtraneousSubstructure);
 	}
-	ScanInfo->totalVertexByteCount += totalByteSize;
+	scanInfo->totalVertexByteCount += totalByteSize;
 
 	return (kDataOkay);
 }
@@ -1411,6 +1462,7 @@ IndexArrayStructure::IndexArrayStructure() : OpenGexStructure(kStructureIndexArr
 {
 	materialIndex = 0;
 	restartIndex = 0;
+	totalByteCount = 0;
 	frontFace = "ccw";
 }
 
@@ -1457,6 +1509,8 @@ bool IndexArrayStructure::ValidateSubstructure(const DataDescription *dataDescri
 
 DataResult IndexArrayStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	const Structure *structure = GetFirstCoreSubnode();
 	if (!structure)
 	{
@@ -1476,7 +1530,7 @@ DataResult IndexArrayStructure::ProcessData(DataDescription *dataDescription)
 
 	//edit
 	// Do something with the index array here.
-	indexBufferIndex = ScanInfo->indexArrayCount++;
+	indexBufferIndex = scanInfo->indexArrayCount++;
 	const ODDL::Structure* dataStructure = GetFirstSubnode();
 
 	switch (dataStructure->GetStructureType())
@@ -1505,7 +1559,7 @@ DataResult IndexArrayStructure::ProcessData(DataDescription *dataDescription)
 		return (kDataExtraneousSubstructure);
 	}
 	totalByteCount += indexSize * indexCount;
-	ScanInfo->totalIndexByteCount += totalByteCount;
+	scanInfo->totalIndexByteCount += totalByteCount;
 
 	return (kDataOkay);
 }
@@ -2094,6 +2148,7 @@ MeshStructure::MeshStructure() : OpenGexStructure(kStructureMesh)
 	indexCount = 0;
 	indexArrayCount = 0;
 	indexByteTotal = 0;
+	flags = 0;
 	meshPrimitive = "triangles";
 
 	skinStructure = nullptr;
@@ -2135,6 +2190,8 @@ bool MeshStructure::ValidateSubstructure(const DataDescription *dataDescription,
 
 DataResult MeshStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	DataResult result = Structure::ProcessData(dataDescription);
 	if (result != kDataOkay)
 	{
@@ -2151,7 +2208,7 @@ DataResult MeshStructure::ProcessData(DataDescription *dataDescription)
 
 			// Process vertex array here.
 			//edit
-			ScanInfo->AddString((const char*)vertexArrayStructure->GetArrayAttrib());
+			scanInfo->AddString((const char*)vertexArrayStructure->GetArrayAttrib());
 
 			if (vertexCount == 0)
 				vertexCount = vertexArrayStructure->vertexCount;
@@ -2193,14 +2250,14 @@ DataResult MeshStructure::ProcessData(DataDescription *dataDescription)
 
 	// Do application-specific mesh processing here.
 	//edit
-	meshIndex = ScanInfo->meshCount++;
+	meshIndex = scanInfo->meshCount++;
 	uint32_t canCreateTangents = (flags & (FLAG_HAS_POSITION | FLAG_HAS_TEXCOORD | FLAG_HAS_TANGENT | FLAG_HAS_NORMAL)) == (FLAG_HAS_POSITION | FLAG_HAS_TEXCOORD | FLAG_HAS_NORMAL);
 	if (canCreateTangents)
 	{
-		ScanInfo->AddString("tangent");
-		ScanInfo->AddString("bitangent");
-		ScanInfo->vertexArrayCount += 2;
-		ScanInfo->totalVertexByteCount += 6 * vertexCount * sizeof(float);
+		scanInfo->AddString("tangent");
+		scanInfo->AddString("bitangent");
+		scanInfo->vertexArrayCount += 2;
+		scanInfo->totalVertexByteCount += 6 * vertexCount * sizeof(float);
 		vertexArrayCount += 2;
 	}
 
@@ -2269,6 +2326,8 @@ bool GeometryObjectStructure::ValidateSubstructure(const DataDescription *dataDe
 
 DataResult GeometryObjectStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	DataResult result = Structure::ProcessData(dataDescription);
 	if (result != kDataOkay)
 	{
@@ -2327,7 +2386,7 @@ DataResult GeometryObjectStructure::ProcessData(DataDescription *dataDescription
 	//edit
 	assert(minMeshIdx != 0xFFFFFFFF);
 	assert((maxMeshIdx + 1) - minMeshIdx == meshCount);
-	modelIndex = ScanInfo->modelCount++;
+	modelIndex = scanInfo->modelCount++;
 	this->meshStart = minMeshIdx;
 	this->meshCount = meshCount;
 
@@ -2509,6 +2568,8 @@ bool CameraObjectStructure::ValidateSubstructure(const DataDescription *dataDesc
 
 DataResult CameraObjectStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	DataResult result = Structure::ProcessData(dataDescription);
 	if (result != kDataOkay)
 	{
@@ -2556,7 +2617,7 @@ DataResult CameraObjectStructure::ProcessData(DataDescription *dataDescription)
 			}
 
 			//edit
-			ScanInfo->AddString((const char*)attribString);
+			scanInfo->AddString((const char*)attribString);
 		}
 
 		structure = structure->Next();
@@ -2732,6 +2793,8 @@ bool TextureStructure::ValidateSubstructure(const DataDescription *dataDescripti
 
 DataResult TextureStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	DataResult result = AttribStructure::ProcessData(dataDescription);
 	if (result != kDataOkay)
 	{
@@ -2739,7 +2802,7 @@ DataResult TextureStructure::ProcessData(DataDescription *dataDescription)
 	}
 
 	//edit
-	ScanInfo->AddString((const char*)GetAttribString());
+	scanInfo->AddString((const char*)GetAttribString());
 
 	bool nameFlag = false;
 
@@ -2756,7 +2819,7 @@ DataResult TextureStructure::ProcessData(DataDescription *dataDescription)
 				if (dataStructure->GetDataElementCount() == 1)
 				{
 					textureName = dataStructure->GetDataElement(0);
-					ScanInfo->AddString(textureName);
+					scanInfo->AddString(textureName);
 				}
 				else
 				{
@@ -2968,6 +3031,8 @@ bool MaterialStructure::ValidateSubstructure(const DataDescription *dataDescript
 
 DataResult MaterialStructure::ProcessData(DataDescription *dataDescription)
 {
+	OgexScanInfo *scanInfo = static_cast<OpenGexDataDescription *>(dataDescription)->GetScanInfo();
+
 	DataResult result = Structure::ProcessData(dataDescription);
 	if (result != kDataOkay)
 	{
@@ -2984,7 +3049,7 @@ DataResult MaterialStructure::ProcessData(DataDescription *dataDescription)
 
 		//edit
 		materialName = (const char*)static_cast<const OGEX::NameStructure*>(structure)->GetName();
-		ScanInfo->AddString(materialName);
+		scanInfo->AddString(materialName);
 	}
 
 	// Do application-specific material processing here.
@@ -2996,11 +3061,11 @@ DataResult MaterialStructure::ProcessData(DataDescription *dataDescription)
 		if (structure->GetStructureType() == kStructureTexture)
 		{
 			textureCount++;
-			ScanInfo->textureReferenceCount++;
+			scanInfo->textureReferenceCount++;
 		}
 		structure = structure->Next();
 	}
-	materialIndex = ScanInfo->materialCount++;
+	materialIndex = scanInfo->materialCount++;
 
 	return (kDataOkay);
 }
@@ -3665,6 +3730,7 @@ OpenGexDataDescription::OpenGexDataDescription()
 	angleScale = 1.0F;
 	timeScale = 1.0F;
 	upDirection = 2;
+	scanInfo = nullptr;
 }
 
 OpenGexDataDescription::~OpenGexDataDescription()
@@ -3979,7 +4045,461 @@ void OgexReadNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::Struct
 	}
 }
 
-void OgexReadRootNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::Structure* rootNode, const OGEX::OpenGexDataDescription* desc)
+static inline uint64_t OgexReadIndex(const uint8_t* indices, uint32_t indexByteSize, uint32_t i)
+{
+	uint64_t index = 0;
+	memcpy(&index, indices + (uint64_t)i * indexByteSize, indexByteSize);	//little endian
+	return index;
+}
+
+static inline void OgexWriteIndex(uint8_t* indices, uint32_t indexByteSize, uint32_t i, uint64_t index)
+{
+	memcpy(indices + (uint64_t)i * indexByteSize, &index, indexByteSize);
+}
+
+// Points the index buffers of a mesh at the first of the vertices that are identical in every vertex buffer written so far.
+// Runs before the tangents are generated, the tangents of welded vertices are shared by all their triangles.
+// The duplicates stay in the vertex buffers unused, OgexOptimizeMesh drops them
+static void OgexWeldMesh(scene_s* sceneInfo, const mesh_s* mesh, uint32_t vertexBufferCount, Memory_Linear_Allocator* tempAlloc)
+{
+	if (mesh->vertexCount == 0 || mesh->vertexCount > 0xFFFFFFFF || vertexBufferCount == 0)
+		return;
+	uint32_t vertexCount = (uint32_t)mesh->vertexCount;
+
+	const vertex_buffer_s* vertexBuffers = sceneInfo->vertexBuffers + mesh->vertexBufferStartIndex;
+	for (uint32_t i = 0; i < vertexBufferCount; i++)
+	{
+		if (vertexBuffers[i].vertexCount != vertexCount || vertexBuffers[i].totalSize % vertexCount)
+			return;
+	}
+
+	const index_buffer_s* indexBuffers = sceneInfo->indexBuffers + mesh->indexBufferStartIndex;
+	for (uint32_t i = 0; i < mesh->indexBufferCount; i++)
+	{
+		const index_buffer_s* ib = indexBuffers + i;
+		if (ib->indexByteSize == 0 || ib->indexByteSize > 8)
+			return;
+		for (uint32_t a = 0; a < ib->indexCount; a++)
+		{
+			if (OgexReadIndex(sceneInfo->indexData + ib->indexOffset, ib->indexByteSize, a) >= vertexCount)
+				return;
+		}
+	}
+
+	// pointers first, the temp allocator does not align
+	const uint8_t** streams = (const uint8_t**)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, vertexBufferCount * sizeof(uint8_t*));
+	uint32_t* strides = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, vertexBufferCount * sizeof(uint32_t));
+	uint32_t* remap = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, vertexCount * sizeof(uint32_t));
+	assert(streams && strides && remap);
+	for (uint32_t i = 0; i < vertexBufferCount; i++)
+	{
+		streams[i] = sceneInfo->vertexData + vertexBuffers[i].vertexOffset;
+		strides[i] = (uint32_t)(vertexBuffers[i].totalSize / vertexCount);
+	}
+
+	// welded indices never exceed the original ones, every buffer keeps its index size
+	if (WeldVertices(remap, streams, strides, vertexBufferCount, vertexCount, tempAlloc) < vertexCount)
+	{
+		for (uint32_t i = 0; i < mesh->indexBufferCount; i++)
+		{
+			const index_buffer_s* ib = indexBuffers + i;
+			uint8_t* indices = sceneInfo->indexData + ib->indexOffset;
+			for (uint32_t a = 0; a < ib->indexCount; a++)
+				OgexWriteIndex(indices, ib->indexByteSize, a, remap[OgexReadIndex(indices, ib->indexByteSize, a)]);
+		}
+	}
+
+	RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, streams);
+}
+
+// Totals of the mesh optimization over a scene, for the import report
+struct OgexMeshStats
+{
+	uint64_t triangleCount;
+	uint64_t missesBefore, missesAfter;		//vertices transformed in the post-transform cache model, the ACMR is this over the triangle count
+	uint64_t vertexCountBefore, vertexCountAfter;
+	uint32_t narrowedIndexBufferCount;
+	uint32_t unpackedMeshCount;		//meshes not fitting the vertex format, the scene fails to import
+	uint64_t packedVertexCount;
+	uint64_t vertexBytesBefore, vertexBytesAfter;	//of the packed vertices, over all their attributes
+};
+
+// Reorders the triangles of every index buffer of a mesh for the vertex cache and for overdraw, then the vertices
+// in the order the triangles use them. Unused vertices, the ones welded away among them, are dropped and index buffers
+// whose vertices fit are stored with 16 bit indices. The buffers shrink in place, OgexCompactSceneData closes the gaps.
+// Meshes with indices the renderer can not draw are left as they are
+static void OgexOptimizeMesh(scene_s* sceneInfo, mesh_s* mesh, const char* name, Memory_Linear_Allocator* tempAlloc, OgexMeshStats* stats)
+{
+	if (mesh->primitiveType != MESH_PRIMITIVE_TYPE_TRIANGLE_LIST || mesh->indexBufferCount == 0 || mesh->vertexCount == 0 || mesh->vertexCount > 0xFFFFFFFF)
+		return;
+	uint32_t vertexCount = (uint32_t)mesh->vertexCount;
+
+	index_buffer_s* indexBuffers = sceneInfo->indexBuffers + mesh->indexBufferStartIndex;
+	uint32_t triangleCount = 0;
+	for (uint32_t i = 0; i < mesh->indexBufferCount; i++)
+	{
+		if ((indexBuffers[i].indexByteSize != 2 && indexBuffers[i].indexByteSize != 4 && indexBuffers[i].indexByteSize != 8) || indexBuffers[i].indexCount % 3)
+			return;
+		triangleCount += indexBuffers[i].indexCount / 3;
+	}
+	if (triangleCount == 0)
+		return;
+
+	vertex_buffer_s* vertexBuffers = sceneInfo->vertexBuffers + mesh->vertexBufferStartIndex;
+	const float* positions = NULL;
+	uint64_t largestVertexBuffer = 0;
+	for (uint32_t i = 0; i < mesh->vertexBufferCount; i++)
+	{
+		if (vertexBuffers[i].vertexCount != vertexCount || vertexBuffers[i].totalSize % vertexCount)
+			return;
+		if (vertexBuffers[i].elementType == VERTEX_BUFFER_ELEMENT_TYPE_FLOAT && vertexBuffers[i].elementCount == 3 &&
+			strcmp(sceneInfo->stringData + vertexBuffers[i].attribStringOffset, "position") == 0)
+			positions = (const float*)(sceneInfo->vertexData + vertexBuffers[i].vertexOffset);
+		if (vertexBuffers[i].totalSize > largestVertexBuffer)
+			largestVertexBuffer = vertexBuffers[i].totalSize;
+	}
+
+	// pointers first, the temp allocator does not align
+	uint32_t** indexLists = (uint32_t**)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, mesh->indexBufferCount * sizeof(uint32_t*));
+	uint32_t* indexCounts = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, mesh->indexBufferCount * sizeof(uint32_t));
+	uint32_t* remap = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, vertexCount * sizeof(uint32_t));
+	assert(indexLists && indexCounts && remap);
+
+	// the optimizer works on 32 bit indices, the buffers are written back in the smallest size that fits
+	uint32_t missesBefore = 0, missesAfter = 0;
+	for (uint32_t i = 0; i < mesh->indexBufferCount; i++)
+	{
+		const index_buffer_s* ib = indexBuffers + i;
+		const uint8_t* src = sceneInfo->indexData + ib->indexOffset;
+		uint32_t* indices = (uint32_t*)AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, ib->indexCount * sizeof(uint32_t));
+		assert(indices);
+		for (uint32_t a = 0; a < ib->indexCount; a++)
+		{
+			uint64_t index = OgexReadIndex(src, ib->indexByteSize, a);
+			if (index >= vertexCount)
+			{
+				RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, indexLists);
+				return;
+			}
+			indices[a] = (uint32_t)index;
+		}
+		indexLists[i] = indices;
+		indexCounts[i] = ib->indexCount;
+		missesBefore += SimulateVertexCache(indices, ib->indexCount, vertexCount, MESH_VERTEX_CACHE_SIZE, tempAlloc);
+	}
+
+	for (uint32_t i = 0; i < mesh->indexBufferCount; i++)
+	{
+		OptimizeVertexCache(indexLists[i], indexCounts[i], vertexCount, MESH_VERTEX_CACHE_SIZE, tempAlloc);
+		if (positions)
+			OptimizeOverdraw(indexLists[i], indexCounts[i], positions, 3 * sizeof(float), vertexCount, MESH_VERTEX_CACHE_SIZE, MESH_OVERDRAW_THRESHOLD, tempAlloc);
+		missesAfter += SimulateVertexCache(indexLists[i], indexCounts[i], vertexCount, MESH_VERTEX_CACHE_SIZE, tempAlloc);
+	}
+
+	// the vertex buffers are separate per attribute, all of them follow the same order and keep the used vertices
+	void* scratch = AllocateVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, largestVertexBuffer);
+	assert(scratch);
+	uint32_t usedCount = OptimizeVertexFetch(remap, indexLists, indexCounts, mesh->indexBufferCount, vertexCount);
+	for (uint32_t i = 0; i < mesh->vertexBufferCount; i++)
+	{
+		vertex_buffer_s* vb = vertexBuffers + i;
+		uint32_t stride = (uint32_t)(vb->totalSize / vertexCount);
+		RemapVertexBuffer(sceneInfo->vertexData + vb->vertexOffset, stride, vertexCount, remap, scratch);
+		vb->vertexCount = usedCount;
+		vb->totalSize = (uint64_t)stride * usedCount;
+	}
+	mesh->vertexCount = usedCount;
+
+	uint32_t narrowedCount = 0;
+	for (uint32_t i = 0; i < mesh->indexBufferCount; i++)
+	{
+		index_buffer_s* ib = indexBuffers + i;
+		uint32_t maxIndex = 0;
+		for (uint32_t a = 0; a < indexCounts[i]; a++)
+			maxIndex = indexLists[i][a] > maxIndex ? indexLists[i][a] : maxIndex;
+
+		uint32_t indexByteSize = (maxIndex <= 0xFFFF) ? 2 : 4;
+		narrowedCount += indexByteSize < ib->indexByteSize;
+		ib->indexByteSize = indexByteSize;
+		ib->totalSize = (uint64_t)indexByteSize * ib->indexCount;
+
+		uint8_t* dst = sceneInfo->indexData + ib->indexOffset;
+		for (uint32_t a = 0; a < ib->indexCount; a++)
+			OgexWriteIndex(dst, indexByteSize, a, indexLists[i][a]);
+	}
+
+	printf("Mesh %u of %s: %u triangles, %u -> %u vertices, ACMR %.3f -> %.3f\n", (uint32_t)(mesh - sceneInfo->meshes), name, triangleCount, vertexCount, usedCount,
+		(double)missesBefore / triangleCount, (double)missesAfter / triangleCount);
+	stats->triangleCount += triangleCount;
+	stats->missesBefore += missesBefore;
+	stats->missesAfter += missesAfter;
+	stats->vertexCountBefore += vertexCount;
+	stats->vertexCountAfter += usedCount;
+	stats->narrowedIndexBufferCount += narrowedCount;
+
+	RewindVirtualMemory(ALLOCATOR_IDX_TEMP, tempAlloc, indexLists);
+}
+
+// Element e of vertex v as a float, the source arrays may hold halfs, floats or doubles
+static inline float OgexLoadElement(const vertex_buffer_s* vb, const uint8_t* data, uint32_t v, uint32_t e)
+{
+	uint64_t i = (uint64_t)v * vb->elementCount + e;
+	switch (vb->elementType)
+	{
+	case VERTEX_BUFFER_ELEMENT_TYPE_HALF:
+	{
+		uint16_t h;
+		memcpy(&h, data + i * sizeof(h), sizeof(h));
+		return glm::unpackHalf1x16(h);
+	}
+	case VERTEX_BUFFER_ELEMENT_TYPE_FLOAT:
+	{
+		float f;
+		memcpy(&f, data + i * sizeof(f), sizeof(f));
+		return f;
+	}
+	case VERTEX_BUFFER_ELEMENT_TYPE_DOUBLE:
+	{
+		double d;
+		memcpy(&d, data + i * sizeof(d), sizeof(d));
+		return (float)d;
+	}
+	}
+	return 0.0f;
+}
+
+static inline glm::vec3 OgexLoadVec3(const vertex_buffer_s* vb, const uint8_t* data, uint32_t v)
+{
+	return glm::vec3(OgexLoadElement(vb, data, v, 0), OgexLoadElement(vb, data, v, 1), OgexLoadElement(vb, data, v, 2));
+}
+
+// Octahedral encoding of a direction, both components in [-1, 1]. Zero length directions encode as +z
+static glm::vec2 OgexOctEncode(glm::vec3 n)
+{
+	float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (!(l1 > 0.0f))
+		return glm::vec2(0.0f);
+	glm::vec2 e = glm::vec2(n.x, n.y) / l1;
+	if (n.z < 0.0f)
+		e = glm::vec2((1.0f - fabsf(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f), (1.0f - fabsf(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+	return e;
+}
+
+// Packs the attributes of a mesh for the vertex fetch: normals as octahedral snorm16 pairs, tangents as octahedral snorm16
+// pairs with the sign of the bitangent in the sign of the second one, texcoords as halfs. The shaders rebuild the bitangent,
+// its buffer is dropped and its empty descriptor moves behind the ones the mesh uses.
+// The buffers shrink in place, OgexCompactSceneData closes the gaps. The pipeline has a single vertex format, a mesh missing
+// one of its attributes is left as it is and fails, the scene is not imported then
+static uint32_t OgexPackMesh(scene_s* sceneInfo, mesh_s* mesh, const char* name, OgexMeshStats* stats)
+{
+	uint32_t meshIndex = (uint32_t)(mesh - sceneInfo->meshes);
+	if (mesh->vertexCount > 0xFFFFFFFF)
+	{
+		printf("Mesh %u of %s: too many vertices to pack\n", meshIndex, name);
+		return 1;
+	}
+	uint32_t vertexCount = (uint32_t)mesh->vertexCount;
+
+	vertex_buffer_s* vertexBuffers = sceneInfo->vertexBuffers + mesh->vertexBufferStartIndex;
+	vertex_buffer_s* positionVb = NULL;
+	vertex_buffer_s* normalVb = NULL;
+	vertex_buffer_s* tangentVb = NULL;
+	vertex_buffer_s* bitangentVb = NULL;
+	vertex_buffer_s* texcoordVb = NULL;
+	uint64_t bytesBefore = 0;
+	for (uint32_t i = 0; i < mesh->vertexBufferCount; i++)
+	{
+		vertex_buffer_s* vb = vertexBuffers + i;
+		const char* attrib = sceneInfo->stringData + vb->attribStringOffset;
+		if (vb->vertexCount != vertexCount)
+		{
+			printf("Mesh %u of %s: %s has %llu of %u vertices\n", meshIndex, name, attrib, (unsigned long long)vb->vertexCount, vertexCount);
+			return 1;
+		}
+		bytesBefore += vb->totalSize;
+
+		// only the source types are converted, positions stay floats
+		uint32_t sourceType = vb->elementType <= VERTEX_BUFFER_ELEMENT_TYPE_DOUBLE;
+		if (!positionVb && strcmp(attrib, "position") == 0 && vb->elementType == VERTEX_BUFFER_ELEMENT_TYPE_FLOAT && vb->elementCount == 3)
+			positionVb = vb;
+		else if (!normalVb && strcmp(attrib, "normal") == 0 && sourceType && vb->elementCount == 3)
+			normalVb = vb;
+		else if (!tangentVb && strcmp(attrib, "tangent") == 0 && sourceType && vb->elementCount == 3)
+			tangentVb = vb;
+		else if (!bitangentVb && strcmp(attrib, "bitangent") == 0 && sourceType && vb->elementCount == 3)
+			bitangentVb = vb;
+		else if (!texcoordVb && strcmp(attrib, "texcoord") == 0 && sourceType && vb->elementCount >= 2)
+			texcoordVb = vb;
+		else
+		{
+			printf("Mesh %u of %s: %s with %u elements of type %u has no place in the vertex format\n", meshIndex, name, attrib, vb->elementCount, vb->elementType);
+			return 1;
+		}
+	}
+	if (!positionVb || !normalVb || !tangentVb || !texcoordVb)
+	{
+		printf("Mesh %u of %s: needs float3 positions, normals, tangents and texcoords\n", meshIndex, name);
+		return 1;
+	}
+
+	// every packed vertex is at most as large as the source one, a vertex is read before it is overwritten
+	uint8_t* normals = sceneInfo->vertexData + normalVb->vertexOffset;
+	uint8_t* tangents = sceneInfo->vertexData + tangentVb->vertexOffset;
+	const uint8_t* bitangents = bitangentVb ? sceneInfo->vertexData + bitangentVb->vertexOffset : NULL;
+	uint8_t* texcoords = sceneInfo->vertexData + texcoordVb->vertexOffset;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		glm::vec3 n = OgexLoadVec3(normalVb, normals, v);
+		glm::vec3 t = OgexLoadVec3(tangentVb, tangents, v);
+		glm::vec2 e = OgexOctEncode(t);
+		// the second component moves to (0, 1] to keep its sign, which is the handedness of the frame.
+		// Without a bitangent the frame is right handed
+		float y = glm::max(e.y * 0.5f + 0.5f, 1.0f / 32767.0f);
+		if (bitangents && glm::dot(glm::cross(n, t), OgexLoadVec3(bitangentVb, bitangents, v)) < 0.0f)
+			y = -y;
+		uint32_t packed = glm::packSnorm2x16(glm::vec2(e.x, y));
+		memcpy(tangents + v * sizeof(packed), &packed, sizeof(packed));
+		packed = glm::packSnorm2x16(OgexOctEncode(n));
+		memcpy(normals + v * sizeof(packed), &packed, sizeof(packed));
+		packed = glm::packHalf2x16(glm::vec2(OgexLoadElement(texcoordVb, texcoords, v, 0), OgexLoadElement(texcoordVb, texcoords, v, 1)));
+		memcpy(texcoords + v * sizeof(packed), &packed, sizeof(packed));
+	}
+
+	normalVb->elementType = VERTEX_BUFFER_ELEMENT_TYPE_SNORM16;
+	normalVb->elementCount = 2;
+	normalVb->totalSize = (uint64_t)vertexCount * sizeof(uint32_t);
+	tangentVb->elementType = VERTEX_BUFFER_ELEMENT_TYPE_SNORM16;
+	tangentVb->elementCount = 2;
+	tangentVb->totalSize = (uint64_t)vertexCount * sizeof(uint32_t);
+	texcoordVb->elementType = VERTEX_BUFFER_ELEMENT_TYPE_HALF;
+	texcoordVb->elementCount = 2;
+	texcoordVb->totalSize = (uint64_t)vertexCount * sizeof(uint32_t);
+	if (bitangentVb)
+	{
+		vertex_buffer_s dropped = *bitangentVb;
+		dropped.vertexCount = 0;
+		dropped.totalSize = 0;
+		memmove(bitangentVb, bitangentVb + 1, (vertexBuffers + mesh->vertexBufferCount - (bitangentVb + 1)) * sizeof(vertex_buffer_s));
+		vertexBuffers[mesh->vertexBufferCount - 1] = dropped;
+		mesh->vertexBufferCount--;
+	}
+
+	stats->packedVertexCount += vertexCount;
+	stats->vertexBytesBefore += bytesBefore;
+	for (uint32_t i = 0; i < mesh->vertexBufferCount; i++)
+		stats->vertexBytesAfter += vertexBuffers[i].totalSize;
+	return 0;
+}
+
+#ifdef OGEX_QUANTIZE_POSITIONS
+// Stores the positions of every mesh as 4 unorm16, quantized to the bounds of the scene. One scale and bias for the whole
+// scene keeps a single vertex format and uniform buffer for all draws. Scenes with positions of another type keep them as they are
+static void OgexQuantizePositions(scene_s* scene, OgexMeshStats* stats)
+{
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (uint32_t i = 0; i < scene->vertexBufferCount; i++)
+	{
+		const vertex_buffer_s* vb = scene->vertexBuffers + i;
+		if (vb->vertexCount == 0 || strcmp(scene->stringData + vb->attribStringOffset, "position") != 0)
+			continue;
+		if (vb->elementType != VERTEX_BUFFER_ELEMENT_TYPE_FLOAT || vb->elementCount != 3)
+			return;
+		const glm::vec3* positions = (const glm::vec3*)(scene->vertexData + vb->vertexOffset);
+		for (uint32_t v = 0; v < vb->vertexCount; v++)
+		{
+			boundsMin = glm::min(boundsMin, positions[v]);
+			boundsMax = glm::max(boundsMax, positions[v]);
+		}
+	}
+	if (boundsMin.x > boundsMax.x)
+		return;	// No positions
+
+	glm::vec3 extent = boundsMax - boundsMin;
+	glm::vec3 invExtent = glm::vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	for (uint32_t i = 0; i < scene->vertexBufferCount; i++)
+	{
+		vertex_buffer_s* vb = scene->vertexBuffers + i;
+		if (vb->vertexCount == 0 || strcmp(scene->stringData + vb->attribStringOffset, "position") != 0)
+			continue;
+		// 8 bytes replace 12, in place
+		uint8_t* data = scene->vertexData + vb->vertexOffset;
+		for (uint32_t v = 0; v < vb->vertexCount; v++)
+		{
+			glm::vec3 position;
+			memcpy(&position, data + v * sizeof(glm::vec3), sizeof(position));
+			uint64_t packed = glm::packUnorm4x16(glm::vec4((position - boundsMin) * invExtent, 0.0f));
+			memcpy(data + v * sizeof(packed), &packed, sizeof(packed));
+		}
+		vb->elementType = VERTEX_BUFFER_ELEMENT_TYPE_UNORM16;
+		vb->elementCount = 4;
+		vb->totalSize = (uint64_t)vb->vertexCount * sizeof(uint64_t);
+		stats->vertexBytesAfter -= (uint64_t)vb->vertexCount * (sizeof(glm::vec3) - sizeof(uint64_t));
+	}
+
+	scene->vertexFlags |= SCENE_VERTEX_QUANTIZED_POSITIONS;
+	for (uint32_t k = 0; k < 3; k++)
+	{
+		scene->positionScale[k] = extent[k];
+		scene->positionBias[k] = boundsMin[k];
+	}
+}
+#endif
+
+// Offset a buffer moves to once the buffers in front of it shrank, the cursor aligned for the buffer but never behind where it is
+static inline uint64_t OgexPackedOffset(uint64_t cursor, uint64_t alignment, uint64_t offset)
+{
+	uint64_t aligned = (cursor + alignment - 1) & ~(alignment - 1);
+	return aligned < offset ? aligned : offset;
+}
+
+// Closes the gaps the optimized meshes left in the vertex and index data and moves the index and string data down
+// behind it. The buffers are laid out in the order of their descriptors, every move goes to a lower address.
+// Returns the new size of the scene
+static uint64_t OgexCompactSceneData(scene_s* scene)
+{
+	uint64_t cursor = 0;
+	for (uint32_t i = 0; i < scene->vertexBufferCount; i++)
+	{
+		vertex_buffer_s* vb = scene->vertexBuffers + i;
+		// the descriptors of dropped buffers are empty and behind the ones of their mesh, they must not move the cursor back
+		if (vb->totalSize == 0)
+		{
+			vb->vertexOffset = cursor;
+			continue;
+		}
+		uint64_t offset = OgexPackedOffset(cursor, 4, vb->vertexOffset);
+		memmove(scene->vertexData + offset, scene->vertexData + vb->vertexOffset, (size_t)vb->totalSize);
+		vb->vertexOffset = offset;
+		cursor = offset + vb->totalSize;
+	}
+	// index buffers are bound at an offset of the scene buffer, it has to be a multiple of the index size
+	uint64_t vertexDataSizeInBytes = OgexPackedOffset(cursor, 4, scene->vertexDataSizeInBytes);
+
+	cursor = 0;
+	for (uint32_t i = 0; i < scene->indexBufferCount; i++)
+	{
+		index_buffer_s* ib = scene->indexBuffers + i;
+		uint64_t offset = OgexPackedOffset(cursor, ib->indexByteSize, ib->indexOffset);
+		memmove(scene->indexData + offset, scene->indexData + ib->indexOffset, (size_t)ib->totalSize);
+		ib->indexOffset = offset;
+		cursor = offset + ib->totalSize;
+	}
+	uint64_t indexDataSizeInBytes = cursor;
+
+	uint8_t* indexData = scene->vertexData + vertexDataSizeInBytes;
+	memmove(indexData, scene->indexData, (size_t)indexDataSizeInBytes);
+	char* stringData = (char*)(indexData + indexDataSizeInBytes);
+	memmove(stringData, scene->stringData, (size_t)scene->stringDataSizeInBytes);
+
+	scene->indexData = indexData;
+	scene->stringData = stringData;
+	scene->vertexDataSizeInBytes = vertexDataSizeInBytes;
+	scene->indexDataSizeInBytes = indexDataSizeInBytes;
+
+	return (uint64_t)((const uint8_t*)(stringData + scene->stringDataSizeInBytes) - (const uint8_t*)scene);
+}
+
+void OgexReadRootNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::Structure* rootNode, const OGEX::OpenGexDataDescription* desc, OgexMeshStats* meshStats)
 {
 	glm::mat4 transform = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
 	switch (desc->GetUpDirection())
@@ -4010,8 +4530,6 @@ void OgexReadRootNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::St
 	OgexReadNode(scanInfo, sceneInfo, rootNode, &transform);
 
 	Memory_Linear_Allocator* tempAlloc = CreateVirtualMemoryAllocator(ALLOCATOR_IDX_TEMP, 0xFFFFFFFF);
-	static int a = 0;
-	a++;
 	assert(tempAlloc);
 
 	const ODDL::Structure* subNode = rootNode->GetFirstSubnode();
@@ -4127,6 +4645,8 @@ void OgexReadRootNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::St
 							subStructure = subStructure->Next();
 						}
 
+						OgexWeldMesh(sceneInfo, sceneInfo->meshes + mesh->meshIndex, curVbCount, tempAlloc);
+
 						uint32_t canCreateTangents = (mesh->flags & (FLAG_HAS_POSITION | FLAG_HAS_TEXCOORD | FLAG_HAS_NORMAL | FLAG_HAS_TANGENT)) == (FLAG_HAS_POSITION | FLAG_HAS_TEXCOORD | FLAG_HAS_NORMAL);
 						if (canCreateTangents)
 						{
@@ -4179,16 +4699,19 @@ void OgexReadRootNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::St
 							{
 								index_buffer_s* ib = sceneInfo->indexBuffers + (sceneInfo->meshes[mesh->meshIndex].indexBufferStartIndex + i);
 
-								assert(ib->indexByteSize == 4);
-								uint32_t* indexStart = (uint32_t*)(sceneInfo->indexData + ib->indexOffset);
+								const uint8_t* indexStart = sceneInfo->indexData + ib->indexOffset;
 
 								for (uint32_t a = 0; a < ib->indexCount / 3; a++, triIdx++)
 								{
-									glm::vec3 E21P = { vertex[indexStart[a * 3 + 1]].x - vertex[indexStart[a * 3]].x, vertex[indexStart[a * 3 + 1]].y - vertex[indexStart[a * 3]].y, vertex[indexStart[a * 3 + 1]].z - vertex[indexStart[a * 3]].z };
-									glm::vec3 E31P = { vertex[indexStart[a * 3 + 2]].x - vertex[indexStart[a * 3]].x, vertex[indexStart[a * 3 + 2]].y - vertex[indexStart[a * 3]].y, vertex[indexStart[a * 3 + 2]].z - vertex[indexStart[a * 3]].z };
+									uint32_t triangle[3];
+									for (uint32_t k = 0; k < 3; k++)
+										triangle[k] = (uint32_t)OgexReadIndex(indexStart, ib->indexByteSize, a * 3 + k);
+
+									glm::vec3 E21P = { vertex[triangle[1]].x - vertex[triangle[0]].x, vertex[triangle[1]].y - vertex[triangle[0]].y, vertex[triangle[1]].z - vertex[triangle[0]].z };
+									glm::vec3 E31P = { vertex[triangle[2]].x - vertex[triangle[0]].x, vertex[triangle[2]].y - vertex[triangle[0]].y, vertex[triangle[2]].z - vertex[triangle[0]].z };
 
-									glm::vec2 E21T = { texcoord[indexStart[a * 3 + 1]].x - texcoord[indexStart[a * 3]].x, texcoord[indexStart[a * 3 + 1]].y - texcoord[indexStart[a * 3]].y };
-									glm::vec2 E31T = { texcoord[indexStart[a * 3 + 2]].x - texcoord[indexStart[a * 3]].x, texcoord[indexStart[a * 3 + 2]].y - texcoord[indexStart[a * 3]].y };
+									glm::vec2 E21T = { texcoord[triangle[1]].x - texcoord[triangle[0]].x, texcoord[triangle[1]].y - texcoord[triangle[0]].y };
+									glm::vec2 E31T = { texcoord[triangle[2]].x - texcoord[triangle[0]].x, texcoord[triangle[2]].y - texcoord[triangle[0]].y };
 
 									float div = (E21T.x * E31T.y - E31T.x * E21T.y);
 
@@ -4225,7 +4748,7 @@ void OgexReadRootNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::St
 
 									for (uint32_t j = 0; j < 3; j++)
 									{
-										uint32_t i1 = indexStart[a * 3 + ((j + 2) % 3)], i2 = indexStart[a * 3 + ((j + 1) % 3)], i0 = indexStart[a * 3 + j];
+										uint32_t i1 = triangle[(j + 2) % 3], i2 = triangle[(j + 1) % 3], i0 = triangle[j];
 										glm::vec3* v0 = &vertex[i0];
 										glm::vec3* v1 = &vertex[i1];
 										glm::vec3* v2 = &vertex[i2];
@@ -4291,6 +4814,10 @@ void OgexReadRootNode(OgexScanInfo* scanInfo, scene_s* sceneInfo, const ODDL::St
 						}
 						assert ( curVbCount == mesh->vertexArrayCount );
 
+						OgexOptimizeMesh(sceneInfo, sceneInfo->meshes + mesh->meshIndex, geom->GetStructureName(), tempAlloc, meshStats);
+						if (OgexPackMesh(sceneInfo, sceneInfo->meshes + mesh->meshIndex, geom->GetStructureName(), meshStats) != 0)
+							meshStats->unpackedMeshCount++;
+
 						sceneInfo->vertexBufferCount += mesh->vertexArrayCount;
 						sceneInfo->indexBufferCount  += mesh->indexArrayCount;
 					}
@@ -4358,32 +4885,29 @@ uint32_t ConvertAsset_OpenGEX
 )
 {
 	OgexScanInfo scanInfo = {};
-	scanInfo.stringTableSlots = 2048;
-	scanInfo.stringTable = (OgexScanInfo::OgexStringTableEntry*)_alloca(scanInfo.stringTableSlots * sizeof(scanInfo.stringTable[0]));
-	memset(scanInfo.stringTable, 0, scanInfo.stringTableSlots * sizeof(scanInfo.stringTable[0]));
-
-	ScanInfo = &scanInfo;
+	scanInfo.InitTables();
 
 	OGEX::OpenGexDataDescription desc;
+	desc.SetScanInfo(&scanInfo);
 	ODDL::DataResult res = desc.ProcessText((const char*)data);
 
 	if (res != ODDL::kDataOkay)
+	{
+		scanInfo.DestroyTables();
 		return (uint32_t)res;
+	}
 
+	// Lay out the strings, the offsets are final from here on
 	uint64_t totalStringLength = 0;
 	for (uint32_t i = 0; i < scanInfo.stringTableSlots; i++)
 	{
 		if (scanInfo.stringTable[i].strPtr)
 		{
+			scanInfo.stringTable[i].offset = totalStringLength;
 			totalStringLength += strlen(scanInfo.stringTable[i].strPtr) + 1;
 		}
 	}
 
-	// Todo: fix this properly
-	scanInfo.textureTableSlots = (uint32_t)(scanInfo.textureReferenceCount * 1.5f);
-	scanInfo.textureTable = (OgexScanInfo::ogesTextureTableEntry*)_alloca(scanInfo.textureTableSlots * sizeof(scanInfo.textureTable[0]));
-	memset(scanInfo.textureTable, 0xFF, scanInfo.textureTableSlots * sizeof(scanInfo.textureTable[0]));
-
 	ODDL::Structure* curStructure = desc.GetRootStructure()->GetFirstSubstructure(OGEX::kStructureMaterial);
 	ODDL::Structure* lastStructure = desc.GetRootStructure()->GetLastSubstructure(OGEX::kStructureMaterial);
 	while (curStructure)
@@ -4464,47 +4988,17 @@ uint32_t ConvertAsset_OpenGEX
 	scene->textureCount = scanInfo.textureCount;
 	scene->textureReferenceCount = scanInfo.textureReferenceCount;
 	scene->materialIndexCount = scanInfo.materialReferenceCount;
-
-	totalStringLength = 0;
-
-	for (uint32_t i = 0; i < scanInfo.stringTableSlots; i++)
+	scene->vertexFlags = 0;
+	for (uint32_t k = 0; k < 3; k++)
 	{
-		if (scanInfo.stringTable[i].strPtr)
-		{
-			uint64_t len = strlen(scanInfo.stringTable[i].strPtr);
-			memcpy((void*)(scene->stringData + totalStringLength), scanInfo.stringTable[i].strPtr, len + 1);
-			scanInfo.stringTable[i].offset = totalStringLength;
-			totalStringLength += len + 1;
-		}
-		else
-			scanInfo.stringTable[i].offset = 0xFFFFFFFFFFFFFFFFULL;
+		scene->positionScale[k] = 1.0f;
+		scene->positionBias[k] = 0.0f;
 	}
 
-	scanInfo.textureCount = 0;
-	memset(scanInfo.textureTable, 0xFF, scanInfo.textureTableSlots * sizeof(scanInfo.textureTable[0]));
-	curStructure = desc.GetRootStructure()->GetFirstSubstructure(OGEX::kStructureMaterial);
-	lastStructure = desc.GetRootStructure()->GetLastSubstructure(OGEX::kStructureMaterial);
-	while (curStructure)
+	for (uint32_t i = 0; i < scanInfo.stringTableSlots; i++)
 	{
-		if (curStructure->GetStructureType() == OGEX::kStructureMaterial)
-		{
-			OGEX::MaterialStructure* materialStructure = static_cast<OGEX::MaterialStructure*> (curStructure);
-			ODDL::Structure* subStructure = curStructure->GetFirstSubstructure(OGEX::kStructureTexture);
-			while (subStructure)
-			{
-				if (subStructure->GetStructureType() == OGEX::kStructureTexture)
-				{
-					OGEX::TextureStructure* tex = static_cast<OGEX::TextureStructure*> (subStructure);
-					scanInfo.AddTexture(scanInfo.FindStringOffset((const char*)tex->GetTextureName()));
-				}
-				subStructure = subStructure->Next();
-			}
-		}
-
-		if (curStructure == lastStructure)
-			break;
-		else
-			curStructure = curStructure->Next();
+		if (scanInfo.stringTable[i].strPtr)
+			memcpy((void*)(scene->stringData + scanInfo.stringTable[i].offset), scanInfo.stringTable[i].strPtr, strlen(scanInfo.stringTable[i].strPtr) + 1);
 	}
 
 	for (uint32_t i = 0; i < scanInfo.textureTableSlots; i++)
@@ -4521,23 +5015,45 @@ uint32_t ConvertAsset_OpenGEX
 	tempScene.vertexDataSizeInBytes = 0;
 	tempScene.indexDataSizeInBytes = 0;
 	tempScene.textureReferenceCount = 0;
-	OgexReadRootNode(&scanInfo, &tempScene, desc.GetRootStructure(), &desc);
-
-	char buffer[512];
-	memcpy(buffer, basePath, basePathLength);
+	OgexMeshStats meshStats = {};
+	OgexReadRootNode(&scanInfo, &tempScene, desc.GetRootStructure(), &desc, &meshStats);
+	scanInfo.DestroyTables();
+	if (meshStats.unpackedMeshCount)
+	{
+		printf("Scene: %u meshes do not fit the vertex format of the pipeline\n", meshStats.unpackedMeshCount);
+		RewindVirtualMemory(ALLOCATOR_IDX_ASSET_DATA, allocator, memory);
+		return OGEX::kDataOpenGexVertexFormatUnsupported;
+	}
+#ifdef OGEX_QUANTIZE_POSITIONS
+	OgexQuantizePositions(scene, &meshStats);
+#endif
 
-	for (uint32_t i = 0; i < scene->textureCount; i++)
+	// the welded vertices and narrowed indices are not uploaded, the scene ends behind the compacted data
+	uint64_t sceneSize = OgexCompactSceneData(scene);
+	RewindVirtualMemory(ALLOCATOR_IDX_ASSET_DATA, allocator, memory + sceneSize);
+	outAsset->size = sceneSize;
+	if (meshStats.triangleCount)
 	{
-		const char* texturePath = scene->stringData + scene->textures[i].pathOffset;
-		uint32_t texturePathLength = (uint32_t)strlen(texturePath);
-		uint32_t pathLength = basePathLength + texturePathLength;
+		printf("Scene: %llu triangles, %llu -> %llu vertices, ACMR %.3f -> %.3f, %u index buffers narrowed to 16 bit\n",
+			(unsigned long long)meshStats.triangleCount, (unsigned long long)meshStats.vertexCountBefore, (unsigned long long)meshStats.vertexCountAfter,
+			(double)meshStats.missesBefore / meshStats.triangleCount, (double)meshStats.missesAfter / meshStats.triangleCount, meshStats.narrowedIndexBufferCount);
+		printf("Scene: vertex data %llu -> %llu bytes, index data %llu -> %llu bytes\n",
+			(unsigned long long)scanInfo.totalVertexByteCount, (unsigned long long)scene->vertexDataSizeInBytes,
+			(unsigned long long)scanInfo.totalIndexByteCount, (unsigned long long)scene->indexDataSizeInBytes);
+	}
+	if (meshStats.packedVertexCount)
+	{
+		printf("Scene: vertex attributes packed from %.1f to %.1f bytes per vertex\n",
+			(double)meshStats.vertexBytesBefore / meshStats.packedVertexCount, (double)meshStats.vertexBytesAfter / meshStats.packedVertexCount);
+	}
 
-		assert(pathLength < sizeof(buffer));
-		memcpy(buffer + basePathLength, texturePath, texturePathLength);
-		buffer[pathLength] = '\0';
+	// the text file is only the import format, the application loads the compiled scene
+	char compiledPath[512];
+	if (GetCompiledScenePath(basePath, compiledPath, sizeof(compiledPath)) == 0 ||
+		WriteCompiledScene(compiledPath, scene, sceneSize, data, dataSizeInBytes, GetConvertedFileTimestamp()) != 0)
+		printf("Unable to write the compiled scene of %s\n", basePath);
 
-		LoadAssetStaticManager(buffer, pathLength);
-	}
+	RequestSceneTextures(scene, basePath, basePathLength);
 
 	return 0;
 }
@@ -49,6 +49,8 @@
 
 using namespace ODDL;
 
+struct OgexScanInfo;
+
 namespace OGEX
 {
 	enum
@@ -130,7 +132,8 @@ namespace OGEX
 		kDataOpenGexInvalidKeyKind				= 'ivkk',
 		kDataOpenGexInvalidCurveType			= 'ivct',
 		kDataOpenGexKeyCountMismatch			= 'kycm',
-		kDataOpenGexEmptyKeyStructure			= 'emky'
+		kDataOpenGexEmptyKeyStructure			= 'emky',
+		kDataOpenGexVertexFormatUnsupported		= 'vfus'
 	};
 
 	class MaterialStructure;
@@ -1437,6 +1440,8 @@ namespace OGEX
 			float		timeScale;
 			int32		upDirection;
 
+			OgexScanInfo	*scanInfo;		// Counts and tables gathered by this description, one per imported file
+
 			DataResult ProcessData(void);
 
 		public:
@@ -1484,6 +1489,16 @@ namespace OGEX
 				upDirection = direction;
 			}
 
+			OgexScanInfo *GetScanInfo(void) const
+			{
+				return (scanInfo);
+			}
+
+			void SetScanInfo(OgexScanInfo *info)
+			{
+				scanInfo = info;
+			}
+
 			Structure *CreateStructure(const String& identifier) const;
 			bool ValidateTopLevelStructure(const Structure *structure) const;
 	};
@@ -1,3 +1,4 @@
+#include "PipelineStates.h"
 #include "VulkanCore.h"
 
 void DestroyRenderStates(RenderState& rs, VulkanCore* core, VkCommandPool commandpool)
@@ -53,13 +54,16 @@ void DestroyRenderStates(RenderState& rs, VulkanCore* core, VkCommandPool comman
 	// delete commandbuffers
 	if (rs.m_commandBuffers)
 	{
-		for (uint32_t i = 0; i < rs.m_commandBufferCount; i++)
-		{
-			vkFreeCommandBuffers(device, commandpool, 1, &rs.m_commandBuffers[i]);
-		}
+		vkFreeCommandBuffers(device, rs.m_commandPool ? rs.m_commandPool : commandpool, rs.m_commandBufferCount, rs.m_commandBuffers);
 		free(rs.m_commandBuffers);
 		rs.m_commandBuffers = NULL;
 	}
+	// delete the owned commandpool
+	if (rs.m_commandPool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(device, rs.m_commandPool, NULL);
+		rs.m_commandPool = VK_NULL_HANDLE;
+	}
 	// delete semaphores
 	if (rs.m_semaphores)
 	{
@@ -136,10 +140,7 @@ void DestroyCommandBuffer(RenderState& rs, VulkanCore* core, VkCommandPool comma
 	// delete commandbuffers
 	if (rs.m_commandBuffers)
 	{
-		for (uint32_t i = 0; i < rs.m_commandBufferCount; i++)
-		{
-			vkFreeCommandBuffers(core->GetViewDevice(), commandpool, 1, &rs.m_commandBuffers[i]);
-		}
+		vkFreeCommandBuffers(core->GetViewDevice(), rs.m_commandPool ? rs.m_commandPool : commandpool, rs.m_commandBufferCount, rs.m_commandBuffers);
 		free(rs.m_commandBuffers);
 		rs.m_commandBuffers = NULL;
 	}
@@ -150,6 +151,29 @@ void BuildCommandBuffer(RenderState& rs, VkCommandPool commandpool, VulkanCore*
 {
 	if (rs.m_CreateCommandBufferFunc)
 	{
+		// states with their own pool recycle all their command buffers at once
+		if (rs.m_commandPool)
+		{
+			VK_CHECK_RESULT(vkResetCommandPool(core->GetViewDevice(), rs.m_commandPool, 0));
+			commandpool = rs.m_commandPool;
+		}
 		rs.m_CreateCommandBufferFunc(&rs, commandpool, core, framebufferCount, framebuffers, rs.m_cmdBufferParameters);
 	}
+}
+
+void AcquireCommandBuffers(RenderState& rs, VkCommandPool commandpool, VkDevice device, uint32_t commandBufferCount)
+{
+	// recording resets them, the pools are created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT or reset as a whole
+	if (rs.m_commandBuffers && rs.m_commandBufferCount == commandBufferCount)
+		return;
+
+	if (rs.m_commandBuffers)
+	{
+		vkFreeCommandBuffers(device, commandpool, rs.m_commandBufferCount, rs.m_commandBuffers);
+		free(rs.m_commandBuffers);
+	}
+	rs.m_commandBufferCount = commandBufferCount;
+	rs.m_commandBuffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer)*rs.m_commandBufferCount);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = VKTools::Initializers::CommandBufferAllocateInfo(commandpool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, rs.m_commandBufferCount);
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, rs.m_commandBuffers));
 }
\ No newline at end of file
@@ -135,5 +135,7 @@ extern void CreateShadowMapState(
 extern void DestroyRenderStates(RenderState& rs, VulkanCore* core, VkCommandPool commandpool);
 extern void DestroyCommandBuffer(RenderState& rs, VulkanCore* core, VkCommandPool commandpool);
 extern void BuildCommandBuffer(RenderState& rs, VkCommandPool commandpool, VulkanCore* core, uint32_t framebufferCount, VkFramebuffer* framebuffers);
+// Reuses the command buffers of the state when the count did not change, reallocates them otherwise
+extern void AcquireCommandBuffers(RenderState& rs, VkCommandPool commandpool, VkDevice device, uint32_t commandBufferCount);
 
 #endif //PIPELINESTATES_H
\ No newline at end of file
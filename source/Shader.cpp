@@ -5,35 +5,6 @@
 #include <assert.h>
 #include "DataTypes.h"
 
-//loading shader binary
-uint32_t ConvertAsset_HLSL_Bytecode
-(
-	asset_s* outAsset,
-	const void* data,
-	uint64_t dataSizeInBytes,
-	const char* basePath,
-	uint32_t basePathLength,
-	Memory_Linear_Allocator* allocator,
-	uint32_t allocatorIdx
-)
-{
-	return 0;
-}
-
-uint32_t ConvertAsset_SPIRV
-(
-	asset_s* outAsset,
-	const void* data,
-	uint64_t dataSizeInBytes,
-	const char* basePath,
-	uint32_t basePathLength,
-	Memory_Linear_Allocator* allocator,
-	uint32_t allocatorIdx
-)
-{
-	return 0;
-}
-
 ///////////////////////////////////////////
 ////Shader
 ///////////////////////////////////////////
@@ -0,0 +1,30 @@
+#include "AssetManager.h"
+
+//loading shader binary, kept out of Shader.cpp so the cooker links without Vulkan
+uint32_t ConvertAsset_HLSL_Bytecode
+(
+	asset_s* outAsset,
+	const void* data,
+	uint64_t dataSizeInBytes,
+	const char* basePath,
+	uint32_t basePathLength,
+	Memory_Linear_Allocator* allocator,
+	uint32_t allocatorIdx
+)
+{
+	return 0;
+}
+
+uint32_t ConvertAsset_SPIRV
+(
+	asset_s* outAsset,
+	const void* data,
+	uint64_t dataSizeInBytes,
+	const char* basePath,
+	uint32_t basePathLength,
+	Memory_Linear_Allocator* allocator,
+	uint32_t allocatorIdx
+)
+{
+	return 0;
+}
@@ -11,8 +11,6 @@ struct Vertices;
 struct Indices;
 struct vk_mesh_s;
 
-#define DYNAMIC_DESCRIPTOR_SET_COUNT 8192
-
 ////////////////////////////////////////////////////////////////////////////////
 // Descriptorset Layouts
 ////////////////////////////////////////////////////////////////////////////////
@@ -23,20 +21,8 @@ enum StaticDescriptorLayout
 	STATIC_DESCRIPTOR_IMAGE,
 	STATIC_DESCRIPTOR_COUNT,
 };
-enum ForwardRendererDescriptorLayout
-{
-	FORWARDRENDER_DESCRIPTOR_IMAGE_DIFFUSE,
-	FORWARDRENDER_DESCRIPTOR_IMAGE_NORMAL,
-	FORWARDRENDER_DESCRIPTOR_IMAGE_OPACITY,
-
-	FORWARDRENDER_DESCRIPTOR_COUNT,
-};
 enum VoxelizerDescriptorLayout
 {
-	VOXELIZER_DESCRIPTOR_IMAGE_DIFFUSE = 0,
-	VOXELIZER_DESCRIPTOR_IMAGE_NORMAL,
-	VOXELIZER_DESCRIPTOR_IMAGE_OPACITY,
-	VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT,
 	// Texture 3D
 	VOXELIZER_DESCRIPTOR_IMAGE_VOXELGRID = 0,
 	// Geometry UBO
@@ -44,9 +30,8 @@ enum VoxelizerDescriptorLayout
 	// Fragment UBO
 	VOXELIZER_DESCRIPTOR_BUFFER_FRAG,
 	VOXELIZER_DESCRIPTOR_IMAGE_ALPHAVOXELGRID,
-	VOXELIZER_SINGLE_DESCRIPTOR_COUNT,
 
-	VOXELIZER_DESCRIPTOR_COUNT = VOXELIZER_SINGLE_DESCRIPTOR_COUNT + VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT
+	VOXELIZER_DESCRIPTOR_COUNT
 };
 enum VoxelizerDebugDescriptorLayout
 {
@@ -82,29 +67,14 @@ enum PostVoxelizerDescriptorLayout
 };
 enum ForwardMainRendererDescriptorLayout
 {
-	// Fragment multiple 
-	FORWARD_MAIN_DESCRIPTOR_IMAGE_DIFFUSE = 0,
-	FORWARD_MAIN_DESCRIPTOR_IMAGE_NORMAL,
-	FORWARD_MAIN_DESCRIPTOR_IMAGE_OPACITY,
-	
-	FORWARD_MAIN_DESCRIPTOR_MULTIPLE_COUNT,
-
 	// Fragment single
 	FORWARD_MAIN_DESCRIPTOR_BUFFER_FRAG = 0,
 	FORWARD_MAIN_DESCRIPTOR_VOXELGRID,
 
-	FORWARD_MAIN_DESCRIPTOR_SINGLE_COUNT,
-
-	FORWARD_MAIN_DESCRIPTOR_COUNT = FORWARD_MAIN_DESCRIPTOR_MULTIPLE_COUNT + FORWARD_MAIN_DESCRIPTOR_SINGLE_COUNT
+	FORWARD_MAIN_DESCRIPTOR_COUNT
 };
 enum DeferredMainRendererDescriptorLayout
 {
-	// Fragment multiple: first and third pass
-	DEFERRED_MAIN_DESCRIPTOR_IMAGE_DIFFUSE = 0,
-	DEFERRED_MAIN_DESCRIPTOR_IMAGE_NORMAL,
-	DEFERRED_MAIN_DESCRIPTOR_IMAGE_OPACITY,
-	DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT,
-
 	// Fragment: second pass fourth
 	DEFERRED_MAIN_DESCRIPTOR_BUFFER_FRAG = 0,
 	DEFERRED_MAIN_DESCRIPTOR_VOXELGRID,
@@ -117,7 +87,7 @@ enum DeferredMainRendererDescriptorLayout
 
 	DEFERRED_MAIN_DESCRIPTOR_INPUT  = 0,
 
-	DEFERRED_MAIN_DESCRIPTOR_COUNT = DEFERRED_MAIN_DESCRIPTOR_MULTIPLE_COUNT + DEFERRED_MAIN_DESCRIPTOR_PASS_COUNT + 1
+	DEFERRED_MAIN_DESCRIPTOR_COUNT = DEFERRED_MAIN_DESCRIPTOR_PASS_COUNT + 1
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -129,6 +99,8 @@ struct StaticUBO
 	glm::mat4 modelMatrix;
 	glm::mat4 viewMatrix;
 	glm::mat4 projectionMatrix;
+	glm::vec4 positionScale;	// Stored positions are decoded as position * scale + bias, see SCENE_VERTEX_QUANTIZED_POSITIONS
+	glm::vec4 positionBias;
 };
 // Forward renderer uniform buffer structures
 struct ForwardRenderUBO
@@ -239,6 +211,7 @@ struct RenderState
 	VkPipelineCache			m_pipelineCache;
 	VkCommandBuffer*		m_commandBuffers;
 	uint32_t				m_commandBufferCount;
+	VkCommandPool			m_commandPool;				// owned pool, reset as a whole before every rebuild. NULL uses the pool passed in
 	VkSemaphore*			m_semaphores;
 	uint32_t				m_semaphoreCount;
 	UniformData*			m_uniformData;
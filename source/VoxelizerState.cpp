@@ -1,5 +1,6 @@
 #include "PipelineStates.h"
 
+#include <stddef.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include "VCTPipelineDefines.h"
 #include "SwapChain.h"
@@ -12,6 +13,7 @@
 struct PushConstantFrag
 {
 	uint32_t cascadeNum;		// The current cascade
+	uint32_t textureIndex[TEXTURE_NUM];	// Material textures in the static texture array
 };
 
 struct Parameter
@@ -46,10 +48,7 @@ void BuildCommandBufferVoxelizerState(
 	////////////////////////////////////////////////////////////////////////////////
 	// Rebuild the command buffers
 	////////////////////////////////////////////////////////////////////////////////
-	renderState->m_commandBufferCount = avt->m_cascadeCount;
-	renderState->m_commandBuffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer)*renderState->m_commandBufferCount);
-	for (uint32_t i = 0; i < renderState->m_commandBufferCount; i++)
-		renderState->m_commandBuffers[i] = VKTools::Initializers::CreateCommandBuffer(commandpool, device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+	AcquireCommandBuffers(*renderState, commandpool, device, avt->m_cascadeCount);
 
 	////////////////////////////////////////////////////////////////////////////////
 	// Record command buffer
@@ -70,7 +69,6 @@ void BuildCommandBufferVoxelizerState(
 	renderPassBeginInfo.pClearValues = NULL;
 
 	renderPassBeginInfo.framebuffer = renderState->m_framebuffers[0];
-	uint32_t d = 0;
 	for (uint32_t i = 0; i < renderState->m_commandBufferCount; i++)
 	{
 		VK_CHECK_RESULT(vkBeginCommandBuffer(renderState->m_commandBuffers[i], &cmdBufInfo));
@@ -99,7 +97,7 @@ void BuildCommandBufferVoxelizerState(
 		// Submit push constant
 		PushConstantFrag pc;
 		pc.cascadeNum = i;
-		vkCmdPushConstants(renderState->m_commandBuffers[i], renderState->m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantFrag), &pc);
+		vkCmdPushConstants(renderState->m_commandBuffers[i], renderState->m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc.cascadeNum), &pc);
 
 		// Bind the rendering pipeline (including the shaders)
 		vkCmdBindPipeline(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelines[0]);
@@ -107,7 +105,7 @@ void BuildCommandBufferVoxelizerState(
 		// Bind descriptor sets describing shader binding points
 		uint32_t doffset = 0;
 		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 0, 1, &staticDescriptorSet, 1, &doffset);
-		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 2, 1, &renderState->m_descriptorSets[0], 0, NULL);
+		vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 1, 1, &renderState->m_descriptorSets[0], 0, NULL);
 
 		for (uint32_t m = 0; m < meshCount; m++)
 		{
@@ -117,53 +115,8 @@ void BuildCommandBufferVoxelizerState(
 			vkCmdBindVertexBuffers(renderState->m_commandBuffers[i], 0, mesh->vbvCount, mesh->vertexResources, mesh->vertexOffsets);
 			for (uint32_t j = 0; j < mesh->submeshCount; j++)
 			{
-				//TODO: BIND new descriptorset. This looks wrong. fix...
-				uint32_t setnum = (d++) + 1;
-				VkDescriptorSet descriptorset = renderState->m_descriptorSets[setnum];
-
-				//bind the textures to the correct format
-				//format: stype,pnext,scSet,srcBinding,srcArrayelement,dstSet,dstbinding,dstarrayelement,descriptorcount
-				VkCopyDescriptorSet textureDescriptorSets[TextureIndex::TEXTURE_NUM];
-				//diffuse texture
-				VkCopyDescriptorSet diffuse;
-				diffuse.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				diffuse.pNext = NULL;
-				diffuse.srcSet = staticDescriptorSet;
-				diffuse.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				diffuse.srcArrayElement = mesh->submeshes[j].textureIndex[DIFFUSE_TEXTURE];
-				diffuse.dstSet = descriptorset;
-				diffuse.dstBinding = VOXELIZER_DESCRIPTOR_IMAGE_DIFFUSE;
-				diffuse.dstArrayElement = 0;
-				diffuse.descriptorCount = 1;
-				textureDescriptorSets[DIFFUSE_TEXTURE] = diffuse;
-				//normal texture
-				VkCopyDescriptorSet normal;
-				normal.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				normal.pNext = NULL;
-				normal.srcSet = staticDescriptorSet;
-				normal.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				normal.srcArrayElement = mesh->submeshes[j].textureIndex[NORMAL_TEXTURE];
-				normal.dstSet = descriptorset;
-				normal.dstBinding = VOXELIZER_DESCRIPTOR_IMAGE_NORMAL;
-				normal.dstArrayElement = 0;
-				normal.descriptorCount = 1;
-				textureDescriptorSets[NORMAL_TEXTURE] = normal;
-				//opacity teture
-				VkCopyDescriptorSet opacity;
-				opacity.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-				opacity.pNext = NULL;
-				opacity.srcSet = staticDescriptorSet;
-				opacity.srcBinding = STATIC_DESCRIPTOR_IMAGE;
-				opacity.srcArrayElement = (uint32_t)mesh->submeshes[j].textureIndex[OPACITY_TEXTURE];
-				opacity.dstSet = descriptorset;
-				opacity.dstBinding = VOXELIZER_DESCRIPTOR_IMAGE_OPACITY;
-				opacity.dstArrayElement = 0;
-				opacity.descriptorCount = 1;
-				textureDescriptorSets[OPACITY_TEXTURE] = opacity;
-				//update the descriptors
-				vkUpdateDescriptorSets(device, 0, NULL, (uint32_t)TEXTURE_NUM, textureDescriptorSets);
-				// Bind descriptor sets describing shader binding points
-				vkCmdBindDescriptorSets(renderState->m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, renderState->m_pipelineLayout, 1, 1, &descriptorset, 0, NULL);
+				// Select the material textures of the submesh
+				vkCmdPushConstants(renderState->m_commandBuffers[i], renderState->m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, offsetof(PushConstantFrag, textureIndex), sizeof(pc.textureIndex), mesh->submeshes[j].textureIndex);
 				// Bind triangle indices
 				vkCmdBindIndexBuffer(renderState->m_commandBuffers[i], mesh->submeshes[j].ibv.buffer, mesh->submeshes[j].ibv.offset, mesh->submeshes[j].ibv.format);
 				// Draw indexed triangle
@@ -319,38 +272,25 @@ void CreateVoxelizerState(
 	////////////////////////////////////////////////////////////////////////////////
 	if (!renderState.m_descriptorLayouts)
 	{
-		renderState.m_descriptorLayoutCount = 2;
+		renderState.m_descriptorLayoutCount = 1;
 		renderState.m_descriptorLayouts = (VkDescriptorSetLayout*)malloc(renderState.m_descriptorLayoutCount * sizeof(VkDescriptorSetLayout));
-		// Dynamic descriptorset
-		VkDescriptorSetLayoutBinding layoutbinding0[VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT];
-		VkDescriptorSetLayoutBinding layoutbinding1[VOXELIZER_SINGLE_DESCRIPTOR_COUNT];
-		// Binding 0 : Diffuse texture sampled image
-		layoutbinding0[VOXELIZER_DESCRIPTOR_IMAGE_DIFFUSE] =
-		{ VOXELIZER_DESCRIPTOR_IMAGE_DIFFUSE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 1 : Normal texture sampled image
-		layoutbinding0[VOXELIZER_DESCRIPTOR_IMAGE_NORMAL] =
-		{ VOXELIZER_DESCRIPTOR_IMAGE_NORMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 2: Opacity texture sampled image
-		layoutbinding0[VOXELIZER_DESCRIPTOR_IMAGE_OPACITY] =
-		{ VOXELIZER_DESCRIPTOR_IMAGE_OPACITY, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 3: 3D voxel textures
+		// The textures are indexed in the static descriptorset
+		VkDescriptorSetLayoutBinding layoutbinding1[VOXELIZER_DESCRIPTOR_COUNT];
+		// Binding 0: 3D voxel textures
 		layoutbinding1[VOXELIZER_DESCRIPTOR_IMAGE_VOXELGRID] =
 		{ VOXELIZER_DESCRIPTOR_IMAGE_VOXELGRID, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 4: Geometry uniform buffer
+		// Binding 1: Geometry uniform buffer
 		layoutbinding1[VOXELIZER_DESCRIPTOR_BUFFER_GEOM] =
 		{ VOXELIZER_DESCRIPTOR_BUFFER_GEOM , VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 1, VK_SHADER_STAGE_GEOMETRY_BIT, NULL };
-		// Binding 5: Fragment uniform buffer
+		// Binding 2: Fragment uniform buffer
 		layoutbinding1[VOXELIZER_DESCRIPTOR_BUFFER_FRAG] =
 		{ VOXELIZER_DESCRIPTOR_BUFFER_FRAG , VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Binding 6: 3D voxel textures
+		// Binding 3: 3D voxel textures
 		layoutbinding1[VOXELIZER_DESCRIPTOR_IMAGE_ALPHAVOXELGRID] =
 		{ VOXELIZER_DESCRIPTOR_IMAGE_ALPHAVOXELGRID, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
-		// Create the descriptorlayout0
-		VkDescriptorSetLayoutCreateInfo descriptorLayout0 = VKTools::Initializers::DescriptorSetLayoutCreateInfo(0, VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT, layoutbinding0);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout0, NULL, &renderState.m_descriptorLayouts[0]));
-		// Create the descriptorlayout1
-		VkDescriptorSetLayoutCreateInfo descriptorLayout1 = VKTools::Initializers::DescriptorSetLayoutCreateInfo(0, VOXELIZER_SINGLE_DESCRIPTOR_COUNT, layoutbinding1);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout1, NULL, &renderState.m_descriptorLayouts[1]));
+		// Create the descriptorlayout
+		VkDescriptorSetLayoutCreateInfo descriptorLayout1 = VKTools::Initializers::DescriptorSetLayoutCreateInfo(0, VOXELIZER_DESCRIPTOR_COUNT, layoutbinding1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout1, NULL, &renderState.m_descriptorLayouts[0]));
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -358,9 +298,9 @@ void CreateVoxelizerState(
 	////////////////////////////////////////////////////////////////////////////////
 	if (!renderState.m_pipelineLayout)
 	{
-		VkDescriptorSetLayout dLayouts[] = { staticDescLayout, renderState.m_descriptorLayouts[0],renderState.m_descriptorLayouts[1] };
+		VkDescriptorSetLayout dLayouts[] = { staticDescLayout, renderState.m_descriptorLayouts[0] };
 		VkPushConstantRange pushConstantRange = VKTools::Initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantFrag));
-		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = VKTools::Initializers::PipelineLayoutCreateInfo(0, 3, dLayouts);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = VKTools::Initializers::PipelineLayoutCreateInfo(0, 2, dLayouts);
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &renderState.m_pipelineLayout));
@@ -372,14 +312,11 @@ void CreateVoxelizerState(
 	if (!renderState.m_descriptorPool)
 	{
 		VkDescriptorPoolSize poolSize[VOXELIZER_DESCRIPTOR_COUNT];
-		poolSize[VOXELIZER_DESCRIPTOR_IMAGE_DIFFUSE] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE , avt->m_cascadeCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[VOXELIZER_DESCRIPTOR_IMAGE_NORMAL] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE , avt->m_cascadeCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[VOXELIZER_DESCRIPTOR_IMAGE_OPACITY] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE , avt->m_cascadeCount * DYNAMIC_DESCRIPTOR_SET_COUNT };
-		poolSize[VOXELIZER_DESCRIPTOR_IMAGE_VOXELGRID + VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 };
-		poolSize[VOXELIZER_DESCRIPTOR_BUFFER_GEOM + VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 1 };
-		poolSize[VOXELIZER_DESCRIPTOR_BUFFER_FRAG + VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 1 };
-		poolSize[VOXELIZER_DESCRIPTOR_IMAGE_ALPHAVOXELGRID + VOXELIZER_MULTIPLE_DESCRIPTOR_COUNT] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE , 1 };
-		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = VKTools::Initializers::DescriptorPoolCreateInfo(0, (avt->m_cascadeCount * DYNAMIC_DESCRIPTOR_SET_COUNT) + 1, VOXELIZER_DESCRIPTOR_COUNT, poolSize);
+		poolSize[VOXELIZER_DESCRIPTOR_IMAGE_VOXELGRID] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 };
+		poolSize[VOXELIZER_DESCRIPTOR_BUFFER_GEOM] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 1 };
+		poolSize[VOXELIZER_DESCRIPTOR_BUFFER_FRAG] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 1 };
+		poolSize[VOXELIZER_DESCRIPTOR_IMAGE_ALPHAVOXELGRID] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE , 1 };
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = VKTools::Initializers::DescriptorPoolCreateInfo(0, 1, VOXELIZER_DESCRIPTOR_COUNT, poolSize);
 		//create the descriptorPool
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, NULL, &renderState.m_descriptorPool));
 	}
@@ -390,24 +327,14 @@ void CreateVoxelizerState(
 	if (!renderState.m_descriptorSets)
 	{
 		//allocate the requirered descriptorsets
-		renderState.m_descriptorSetCount = (DYNAMIC_DESCRIPTOR_SET_COUNT * avt->m_cascadeCount) + 1;
+		renderState.m_descriptorSetCount = 1;
 		renderState.m_descriptorSets = (VkDescriptorSet*)malloc(renderState.m_descriptorSetCount * sizeof(VkDescriptorSet));
-		for (uint32_t i = 0; i < avt->m_cascadeCount; i++)
-		{
-			for (uint32_t j = 0; j < DYNAMIC_DESCRIPTOR_SET_COUNT; j++)
-			{
-				VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[0]);
-				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &renderState.m_descriptorSets[(i*DYNAMIC_DESCRIPTOR_SET_COUNT) + j + 1]));
-			}
-		}
-		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[1]);
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = VKTools::Initializers::DescriptorSetAllocateInfo(renderState.m_descriptorPool, 1, &renderState.m_descriptorLayouts[0]);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &renderState.m_descriptorSets[0]));
 
 		///////////////////////////////////////////////////////
 		///// Set/Update the image and uniform buffer descriptorsets
 		/////////////////////////////////////////////////////// 
-		// Descriptorset 1 = multiple
-		// Descriptorset 0 = single
 		VkWriteDescriptorSet writeDescriptorSet = {};
 		// Update GEOM descriptorset
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
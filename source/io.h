@@ -1,9 +1,18 @@
 #ifndef IO_H
 #define IO_H
 
-#include <Windows.h>
 #include <stdint.h>
 
+// How a mapped file is read, the hint of readonly_mapped_file_open
+enum MappedFileAccess
+{
+	MAPPED_FILE_RANDOM = 0,			// Parts are read on demand
+	MAPPED_FILE_SEQUENTIAL = 1,		// Read front to back once, reading ahead starts right away
+};
+
+#ifdef _WIN32
+#include <Windows.h>
+
 struct MappedFile
 {
 	void* file;
@@ -13,13 +22,13 @@ struct MappedFile
 	uint64_t changeTimestamp;
 };
 
-inline uint32_t readonly_mapped_file_open(MappedFile* outFile, const char* filePath)
+inline uint32_t readonly_mapped_file_open(MappedFile* outFile, const char* filePath, uint32_t access)
 {
 	MappedFile temp;
 	LARGE_INTEGER size;
 
 	// Opening the file
-	temp.file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	temp.file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, access == MAPPED_FILE_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, NULL);
 	if (temp.file == INVALID_HANDLE_VALUE)
 		return -2;	// Could not open the file. It is really quite likely that the file just doesn't exist.
 
@@ -66,6 +75,89 @@ inline uint32_t readonly_mapped_file_close(MappedFile* file)
 	return 0;
 }
 
+inline uint32_t replace_file(const char* srcPath, const char* dstPath)
+{
+	if (!MoveFileExA(srcPath, dstPath, MOVEFILE_REPLACE_EXISTING))
+		return (uint32_t)GetLastError();
+	return 0;
+}
+
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+
+struct MappedFile
+{
+	int file;
+	void* dataPtr;
+	uint64_t size;
+	uint64_t changeTimestamp;
+};
+
+inline uint32_t readonly_mapped_file_open(MappedFile* outFile, const char* filePath, uint32_t access)
+{
+	MappedFile temp;
+	struct stat info;
+
+	// Opening the file
+	temp.file = open(filePath, O_RDONLY);
+	if (temp.file < 0)
+		return -2;	// Could not open the file
+
+	// Getting the size and the last change time
+	if (fstat(temp.file, &info) != 0)
+		return close(temp.file),
+		-3;
+
+	temp.size = info.st_size;
+	// Same unit and epoch as the win32 LastWriteTime, 100ns intervals since 1601
+	temp.changeTimestamp = ((uint64_t)info.st_mtim.tv_sec + 11644473600ull) * 10000000ull + info.st_mtim.tv_nsec / 100;
+
+	// Mapping the file, an empty file can't be mapped
+	temp.dataPtr = NULL;
+	if (temp.size)
+	{
+		temp.dataPtr = mmap(NULL, temp.size, PROT_READ, MAP_PRIVATE, temp.file, 0);
+		if (temp.dataPtr == MAP_FAILED)
+			return close(temp.file),
+			-6;
+
+		// Files read front to back start reading ahead right away
+		if (access == MAPPED_FILE_SEQUENTIAL)
+		{
+			madvise(temp.dataPtr, temp.size, MADV_SEQUENTIAL);
+			madvise(temp.dataPtr, temp.size, MADV_WILLNEED);
+		}
+	}
+
+	*outFile = temp;
+
+	//
+	return 0;
+}
+
+inline uint32_t readonly_mapped_file_close(MappedFile* file)
+{
+	if (file->dataPtr)
+		munmap(file->dataPtr, file->size);
+	close(file->file);
+
+	return 0;
+}
+
+inline uint32_t replace_file(const char* srcPath, const char* dstPath)
+{
+	if (rename(srcPath, dstPath) != 0)
+		return (uint32_t)errno;
+	return 0;
+}
+
+#endif
+
 inline uint32_t readonly_mapped_file_get_data(MappedFile* file, void** outData, uint64_t* outSizeInBytes)
 {
 	*outData = (void*)file->dataPtr;